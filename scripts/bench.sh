@@ -0,0 +1,338 @@
+#!/bin/sh
+# Measures the speed of the front end of the compiler. The lex, preprocess, and
+# parse passes (see the -bench option of the compiler) are run over the sample
+# programs, the zcommon library, and a set of generated inputs. The generated
+# inputs that stress the later phases are also compiled in full, and their time
+# reports (see the -time-report-json option) are kept. The results are written
+# as JSON, so they can be compared between versions of the compiler.
+#
+# Usage: bench.sh [-n runs] [-o output-file] [-w work-dir] <compiler>
+#
+# Each pass is run several times on every file, and the fastest run is kept.
+# The generated inputs are placed in the work directory.
+
+set -e
+
+runs=3
+output=
+work_dir=bench
+while getopts n:o:w: option; do
+   case $option in
+   n) runs=$OPTARG ;;
+   o) output=$OPTARG ;;
+   w) work_dir=$OPTARG ;;
+   *) exit 1 ;;
+   esac
+done
+shift $(( OPTIND - 1 ))
+if [ $# -ne 1 ]; then
+   echo "usage: $0 [-n runs] [-o output-file] [-w work-dir] <compiler>" >&2
+   exit 1
+fi
+compiler=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+root=$(cd "$(dirname "$0")/.." && pwd)
+mkdir -p "$work_dir"
+work_dir=$(cd "$work_dir" && pwd)
+
+# Generated inputs
+# ==========================================================================
+
+# Chains of object-like and function-like macros, each macro expanding to the
+# one before it. Every level of a function-like macro rescans the growing
+# argument, so the cost rises with the square of the depth of the chain.
+gen_macros() {
+   awk -v object_depth=64 -v func_depth=16 -v uses=5000 'BEGIN {
+      print "#pragma raw define on"
+      print "#define M0 1"
+      print "#define F0( x ) ( x )"
+      for ( i = 1; i <= object_depth; ++i ) {
+         printf "#define M%d ( M%d + 1 )\n", i, i - 1
+      }
+      for ( i = 1; i <= func_depth; ++i ) {
+         printf "#define F%d( x ) F%d( ( x ) + %d )\n", i, i - 1, i
+      }
+      print "void Macros() {"
+      print "   int value = 0;"
+      for ( i = 0; i < uses; ++i ) {
+         printf "   value = M%d + F%d( value );\n",
+            object_depth - i % 8, func_depth - i % 4
+      }
+      print "}"
+   }'
+}
+
+# A large string table.
+gen_strings() {
+   awk -v count=100000 'BEGIN {
+      print "str Strings[] = {"
+      for ( i = 0; i < count; ++i ) {
+         printf "   \"string %d: the quick brown fox\",\n", i
+      }
+      print "};"
+   }'
+}
+
+# Many namespaces, each with a few declarations.
+gen_namespaces() {
+   awk -v count=5000 'BEGIN {
+      for ( i = 0; i < count; ++i ) {
+         printf "namespace Ns%d {\n", i
+         printf "   enum { A%d, B%d, C%d };\n", i, i, i
+         printf "   struct Point%d { int x; int y; };\n", i
+         printf "   int Value = %d;\n", i
+         printf "   int Get() { return Value + A%d; }\n", i
+         print "}"
+      }
+   }'
+}
+
+# Deep chains of forward references: constants, type aliases, and structures,
+# each declared before the one it refers to.
+gen_forward_refs() {
+   awk -v depth=2000 'BEGIN {
+      for ( i = 0; i < depth; ++i ) {
+         printf "enum { C%d = C%d + 1 };\n", i, i + 1
+      }
+      printf "enum { C%d = 0 };\n", depth
+      for ( i = 0; i <= depth; ++i ) {
+         printf "typedef struct S%d T%d_T;\n", i, i
+      }
+      for ( i = 0; i < depth; ++i ) {
+         printf "struct S%d { T%d_T next; int value; };\n", i, i + 1
+      }
+      printf "struct S%d { int value; };\n", depth
+      print "T0_T Chain;"
+      print "int Get() { return C0 + Chain.value; }"
+   }'
+}
+
+# A library with many functions, each with a body of ordinary statements.
+gen_functions() {
+   awk -v count=2500 'BEGIN {
+      print "#library \"funcs\""
+      print "#nocompact"
+      print "#include \"zcommon.h\""
+      for ( i = 0; i < count; ++i ) {
+         printf "int F%d( int a, int b ) {\n", i
+         print "   int sum = 0;"
+         print "   for ( int i = 0; i < a; ++i ) {"
+         printf "      int t = i * b + %d;\n", i
+         print "      if ( t > 10 ) {"
+         print "         sum += t;"
+         print "      }"
+         print "      else {"
+         printf "         sum -= F%d( t, b );\n", ( i > 0 ? i - 1 : 0 )
+         print "      }"
+         print "      Print( s: \"value \", d: t );"
+         print "   }"
+         print "   switch ( b ) {"
+         print "   case 1: sum += 2; break;"
+         print "   case 2: sum *= 3; break;"
+         print "   }"
+         print "   return sum;"
+         print "}"
+      }
+   }'
+}
+
+# Tables of arithmetic, dense with calls and subscripts.
+gen_math() {
+   awk -v count=400 -v rows=100 'BEGIN {
+      print "#library \"math\""
+      print "#nocompact"
+      print "int Add( int a, int b ) { return a + b; }"
+      print "int Mul( int a, int b ) { return a * b; }"
+      print "int Table[ 1024 ];"
+      for ( i = 0; i < count; ++i ) {
+         printf "int Math%d( int a, int b ) {\n", i
+         print "   int v = 0;"
+         for ( k = 0; k < rows; ++k ) {
+            printf "   v = Add( Mul( a, Table[ %d ] ), Add( Table[ ( b + %d ) " \
+               "%% 1024 ], Mul( v, %d ) ) ) + ( a * %d - b / %d ) %% ( %d + " \
+               "Table[ a & 1023 ] );\n", k, k, k + 1, k, k + 1, k + 7
+         }
+         print "   return v;"
+         print "}"
+      }
+   }'
+}
+
+# Functions that take and pass arrays and structures by reference. Each call
+# and each assignment of a reference compares the reference types.
+gen_refs() {
+   awk -v count=400 -v rows=60 'BEGIN {
+      print "#library \"refs\""
+      print "#nocompact"
+      print "struct Point { int x; int y; };"
+      print "int Sum( int[]& row, struct Point& p, fixed[][]& grid, int n ) {"
+      print "   return row[ n ] + p.x + grid[ 0 ].length();"
+      print "}"
+      print "private int Cells[ 16 ];"
+      print "private fixed Grid[ 4 ][ 4 ];"
+      print "private struct Point Origin;"
+      for ( i = 0; i < count; ++i ) {
+         printf "int Refs%d( int[]& row, struct Point& p, " \
+            "fixed[][]& grid ) {\n", i
+         print "   int v = 0;"
+         print "   int[]& r = row;"
+         print "   struct Point& q = p;"
+         for ( k = 0; k < rows; ++k ) {
+            printf "   v += Sum( r, q, grid, %d ) + Sum( Cells, Origin, " \
+               "Grid, %d ) + Sum( row, p, grid, v & 15 );\n", k % 16,
+               ( k + 3 ) % 16
+            printf "   r = ( v > %d ) ? row : Cells;\n", k
+            print "   q = p;"
+         }
+         print "   return v;"
+         print "}"
+      }
+   }'
+}
+
+# A call to every function of the zcommon library, as listed in the special
+# list of the library. The arguments are dummy values of the types of the
+# required parameters.
+gen_zcommon_calls() {
+   awk '
+      /^special/ {
+         in_list = 1
+         next
+      }
+      in_list && /^}/ {
+         in_list = 0
+      }
+      in_list {
+         sub( /\/\/.*/, "" )
+         list = list " " $0
+      }
+      END {
+         value[ "int" ] = "0"
+         value[ "raw" ] = "0"
+         value[ "fixed" ] = "0.0"
+         value[ "bool" ] = "false"
+         value[ "str" ] = "\"\""
+         print "#include \"zcommon.h\""
+         print "void CallAll() {"
+         pattern = "-?[0-9]+:[A-Za-z_0-9]+\\([^)]*\\)(:[a-z]+)?(:[0-9]+)?"
+         while ( match( list, pattern ) ) {
+            entry = substr( list, RSTART, RLENGTH )
+            list = substr( list, RSTART + RLENGTH )
+            name = entry
+            sub( /^[^:]*:/, "", name )
+            sub( /\(.*/, "", name )
+            # Skip the action specials that cannot be called from a script,
+            # and the marker at the end of the list.
+            if ( entry ~ /:0$/ || name ~ /^__/ ) {
+               continue
+            }
+            params = entry
+            sub( /^[^(]*\(/, "", params )
+            sub( /[;)].*/, "", params )
+            gsub( / /, "", params )
+            count = split( params, types, "," )
+            args = ""
+            for ( i = 1; i <= count; ++i ) {
+               args = args ( i > 1 ? ", " : "" ) value[ types[ i ] ]
+            }
+            printf "   %s(%s);\n", name, ( count > 0 ? " " args " " : "" )
+         }
+         print "}"
+      }' "$root/lib/zcommon/master.bcs"
+}
+
+gen_macros > "$work_dir/macros.bcs"
+gen_strings > "$work_dir/strings.bcs"
+gen_namespaces > "$work_dir/namespaces.bcs"
+gen_forward_refs > "$work_dir/forward_refs.bcs"
+gen_functions > "$work_dir/functions.bcs"
+gen_math > "$work_dir/math.bcs"
+gen_refs > "$work_dir/refs.bcs"
+gen_zcommon_calls > "$work_dir/zcommon_calls.bcs"
+
+# Benchmarks
+# ==========================================================================
+
+# Runs a pass on a file, and prints the report of the fastest run. A file that
+# fails to compile is reported as failed.
+run() {
+   dir=$1
+   file=$2
+   pass=$3
+   best=
+   best_speed=-1
+   i=0
+   while [ $i -lt "$runs" ]; do
+      if ! report=$(cd "$dir" && "$compiler" -i "$root/lib" -bench "$pass" \
+         "$file" 2> /dev/null); then
+         printf '{"file": "%s", "pass": "%s", "failed": true}' "$file" \
+            "$pass"
+         return
+      fi
+      speed=$(echo "$report" | sed 's/.*"mb_per_second": \([0-9.]*\).*/\1/')
+      if awk -v a="$speed" -v b="$best_speed" 'BEGIN { exit !( a > b ) }'
+      then
+         best=$report
+         best_speed=$speed
+      fi
+      i=$(( i + 1 ))
+   done
+   printf '%s' "$best"
+}
+
+# Runs every pass on the files of a directory.
+run_dir() {
+   dir=$1
+   shift
+   for file in "$@"; do
+      for pass in lex preprocess parse; do
+         printf '%s    %s' "$separator" "$(run "$dir" "$file" "$pass")"
+         separator=',
+'
+      done
+   done
+}
+
+# Compiles a file, and prints the time report of the fastest run.
+run_compile() {
+   file=$1
+   best=
+   best_time=-1
+   i=0
+   while [ $i -lt "$runs" ]; do
+      if ! report=$(cd "$work_dir" && "$compiler" -i "$root/lib" \
+         -time-report-json "$file" "$file.o" 2> /dev/null); then
+         printf '{"file": "%s", "failed": true}' "$file"
+         return
+      fi
+      time=$(echo "$report" | sed 's/^{"file": "[^"]*", "wall": \([0-9.]*\).*/\1/')
+      if awk -v a="$time" -v b="$best_time" \
+         'BEGIN { exit !( b < 0 || a < b ) }'
+      then
+         best=$report
+         best_time=$time
+      fi
+      i=$(( i + 1 ))
+   done
+   printf '%s' "$best"
+}
+
+{
+   printf '{\n'
+   printf '  "compiler": "%s",\n' "$("$compiler" -version)"
+   printf '  "runs": %d,\n' "$runs"
+   printf '  "results": [\n'
+   separator=
+   cd "$root"
+   run_dir "$root" test/*.bcs lib/zcommon/*.bcs
+   run_dir "$work_dir" macros.bcs strings.bcs namespaces.bcs forward_refs.bcs \
+      functions.bcs math.bcs refs.bcs zcommon_calls.bcs
+   printf '\n  ],\n'
+   printf '  "compile_results": [\n'
+   printf '    %s,\n' "$(run_compile forward_refs.bcs)"
+   printf '    %s,\n' "$(run_compile functions.bcs)"
+   printf '    %s,\n' "$(run_compile math.bcs)"
+   printf '    %s,\n' "$(run_compile refs.bcs)"
+   printf '    %s' "$(run_compile zcommon_calls.bcs)"
+   printf '\n  ]\n'
+   printf '}\n'
+} > "${output:-/dev/stdout}"
@@ -0,0 +1,121 @@
+#!/bin/sh
+# Measures the allocations made by the compiler. The jm sample program, split
+# into headers, and a generated input with many functions are compiled by each
+# of the given compilers. For every compilation, the number of allocations and
+# the peak memory (see the -mem-stats option of the compiler) are shown, along
+# with the time of the fastest of several runs. Give the compilers built before
+# and after a change to the allocator to compare them.
+#
+# Usage: mem-bench.sh [-n runs] [-w work-dir] <compiler>...
+#
+# A compiler without the -mem-stats option is still timed, but its allocation
+# counts are shown as "-". The generated input is placed in the work directory.
+
+set -e
+
+runs=3
+work_dir=bench
+while getopts n:w: option; do
+   case $option in
+   n) runs=$OPTARG ;;
+   w) work_dir=$OPTARG ;;
+   *) exit 1 ;;
+   esac
+done
+shift $(( OPTIND - 1 ))
+if [ $# -eq 0 ]; then
+   echo "usage: $0 [-n runs] [-w work-dir] <compiler>..." >&2
+   exit 1
+fi
+root=$(cd "$(dirname "$0")/.." && pwd)
+mkdir -p "$work_dir"
+work_dir=$(cd "$work_dir" && pwd)
+
+# A library of many functions. Each function allocates its own scopes and
+# strings, and frees them once it is checked and written out, while every
+# function before it is still allocated.
+gen_alloc_funcs() {
+   awk -v count=4000 'BEGIN {
+      print "#library \"memfuncs\""
+      print "#nocompact"
+      print "#include \"zcommon.h\""
+      for ( i = 0; i < count; ++i ) {
+         printf "int F%d( int a, int b ) {\n", i
+         print "   int sum = 0;"
+         print "   for ( int i = 0; i < a; ++i ) {"
+         printf "      int t = i * b + %d;\n", i
+         print "      if ( t > 10 ) {"
+         print "         sum += t;"
+         print "      }"
+         print "      else {"
+         printf "         sum -= F%d( t, b );\n", ( i > 0 ? i - 1 : 0 )
+         print "      }"
+         printf "      Print( s: \"value %d: \", d: t );\n", i
+         print "   }"
+         print "   return sum;"
+         print "}"
+      }
+   }'
+}
+
+gen_alloc_funcs > "$work_dir/alloc_funcs.bcs"
+
+# Prints the allocations and the peak memory of a compilation, separated by a
+# space, or "- -" when the compiler cannot show them.
+mem_stats() {
+   compiler=$1
+   file=$2
+   if ! report=$("$compiler" -i "$root/lib" -mem-stats "$file" \
+      "$work_dir/mem-bench.o" 2> /dev/null); then
+      printf -- '- -'
+      return
+   fi
+   echo "$report" | awk '
+      / [0-9]+ allocations?,/ {
+         line = $0
+         sub( /^.*: /, "", line )
+         allocs += line
+      }
+      /^  total: / {
+         peak = $0
+         sub( /.*peak of /, "", peak )
+         sub( / bytes.*/, "", peak )
+      }
+      END {
+         printf "%d %d", allocs, peak
+      }'
+}
+
+# Prints the time, in seconds, of the fastest of the runs of a compilation.
+best_time() {
+   compiler=$1
+   file=$2
+   best=-1
+   i=0
+   while [ $i -lt "$runs" ]; do
+      start=$(date +%s.%N)
+      if ! "$compiler" -i "$root/lib" "$file" "$work_dir/mem-bench.o" \
+         > /dev/null 2>&1; then
+         printf 'failed'
+         return
+      fi
+      end=$(date +%s.%N)
+      best=$(awk -v start="$start" -v end="$end" -v best="$best" 'BEGIN {
+         time = end - start
+         printf "%.3f", ( best < 0 || time < best ) ? time : best
+      }')
+      i=$(( i + 1 ))
+   done
+   printf '%s' "$best"
+}
+
+printf '%-24s %-24s %12s %14s %8s\n' compiler file allocations peak-bytes \
+   seconds
+for compiler in "$@"; do
+   for file in "$root/test/jm_header/jm.bcs" "$work_dir/alloc_funcs.bcs"; do
+      stats=$(mem_stats "$compiler" "$file")
+      printf '%-24s %-24s %12s %14s %8s\n' "$(basename "$compiler")" \
+         "$(basename "$(dirname "$file")")/$(basename "$file")" \
+         "${stats% *}" "${stats#* }" "$(best_time "$compiler" "$file")"
+   done
+done
@@ -16,8 +16,11 @@ enum {
    F_DEPENDENCY,
    F_END,
    F_ENTRY,
+   F_HASH,
    F_ID,
    F_PATH,
+   F_TYPE,
+   F_DEFINES,
 };
 
 struct saver {
@@ -57,6 +60,10 @@ static void save_entry( struct saver* saver, struct cache_entry* entry ) {
    WS( saver, F_PATH, entry->path.value );
    WV( saver, F_COMPILETIME, &entry->compile_time );
    WV( saver, F_ID, &entry->id );
+   WV( saver, F_TYPE, &entry->type );
+   if ( entry->type == CACHEENTRY_HEADER ) {
+      WS( saver, F_DEFINES, entry->defines.value );
+   }
    save_dependency_list( saver, entry );
    WF( saver, F_END );
 }
@@ -67,6 +74,7 @@ static void save_dependency_list( struct saver* saver,
    while ( dep ) {
       WF( saver, F_DEPENDENCY );
       WS( saver, F_PATH, dep->path.value );
+      WV( saver, F_HASH, &dep->hash );
       WF( saver, F_END );
       dep = dep->next;
    }
@@ -121,6 +129,10 @@ static void restore_entry( struct restorer* restorer ) {
    str_append( &entry->path, RS( restorer, F_PATH ) );
    RV( restorer, F_COMPILETIME, &entry->compile_time );
    RV( restorer, F_ID, &entry->id );
+   RV( restorer, F_TYPE, &entry->type );
+   if ( entry->type == CACHEENTRY_HEADER ) {
+      str_append( &entry->defines, RS( restorer, F_DEFINES ) );
+   }
    restore_dependency_list( restorer, entry );
    RF( restorer, F_END );
    cache_append_entry( &restorer->cache->entries, entry );
@@ -138,6 +150,7 @@ static void restore_dependency( struct restorer* restorer,
    RF( restorer, F_DEPENDENCY );
    struct cache_dependency* dep = cache_alloc_dependency( restorer->cache,
       RS( restorer, F_PATH ) );
+   RV( restorer, F_HASH, &dep->hash );
    cache_append_dependency( entry, dep );
    RF( restorer, F_END );
 }
@@ -19,9 +19,11 @@ enum {
 struct restore_request {
    struct str* path;
    struct library* lib;
+   struct header_snapshot* header;
    enum {
       RESTORE_ARCHIVE,
       RESTORE_LIB,
+      RESTORE_HEADER,
    } type;
 };
 
@@ -40,9 +42,14 @@ static int generate_id( struct cache* cache );
 static void append_entry_sorted( struct cache_entry_list* entries,
    struct cache_entry* entry );
 static struct cache_entry* find_entry( struct cache* cache, const char* path );
-static bool timestamp_entry( struct cache_entry* entry );
+static struct cache_entry* find_header_entry( struct cache* cache,
+   const char* path, const char* defines );
+static void replace_dependencies( struct cache* cache,
+   struct cache_entry* entry );
+static bool hash_file( const char* path, unsigned int* hash );
 static bool fresh_entry( struct cache_entry* entry );
 static bool restore_lib( struct cache* cache, struct cache_entry* entry );
+static void restore_header( struct cache* cache, struct cache_entry* entry );
 static void append_entry_path( struct cache* cache, struct cache_entry* entry,
    struct str* path );
 static void unlink_entry( struct cache_entry_list* entries,
@@ -51,7 +58,7 @@ static bool lifetime_enabled( struct cache* cache );
 static void remove_outdated_entries( struct cache* cache );
 static time_t lifetime_seconds( struct cache* cache );
 static void save_cache( struct cache* cache );
-static void save_lib( struct cache* cache, struct cache_entry* entry );
+static void save_entry( struct cache* cache, struct cache_entry* entry );
 static void save_header( struct cache* cache, struct field_writer* writer );
 static void save_archive( struct cache* cache );
 static void print_entry( struct cache* cache, struct cache_entry* entry );
@@ -152,6 +159,7 @@ static void init_restore_request( struct restore_request* request, int type,
    struct str* path ) {
    request->path = path;
    request->lib = NULL;
+   request->header = NULL;
    request->type = type;
 }
 
@@ -197,6 +205,9 @@ static void restore_file( struct cache* cache,
    case RESTORE_LIB:
       request->lib = cache_restore_lib( cache, reader );
       break;
+   case RESTORE_HEADER:
+      request->header = cache_restore_header( cache, reader );
+      break;
    default:
       UNREACHABLE();
    }
@@ -212,12 +223,7 @@ void cache_add( struct cache* cache, struct library* lib ) {
       entry->id = generate_id( cache );
       append_entry_sorted( &cache->entries, entry );
    }
-   // Free previous dependencies.
-   if ( entry->dependency ) {
-      entry->dependency_tail->next = cache->free_dependencies;
-      cache->free_dependencies = entry->dependency;
-      entry->dependency = NULL;
-   }
+   replace_dependencies( cache, entry );
    // Update entry.
    struct list_iter i;
    list_iterate( &lib->files, &i );
@@ -225,6 +231,7 @@ void cache_add( struct cache* cache, struct library* lib ) {
       struct file_entry* file = list_data( &i );
       struct cache_dependency* dep = cache_alloc_dependency( cache,
          file->full_path.value );
+      hash_file( dep->path.value, &dep->hash );
       cache_append_dependency( entry, dep );
       list_next( &i );
    }
@@ -243,6 +250,7 @@ void cache_add( struct cache* cache, struct library* lib ) {
       }
       struct cache_dependency* dep = cache_alloc_dependency( cache,
          query.file->full_path.value );
+      hash_file( dep->path.value, &dep->hash );
       cache_append_dependency( entry, dep );
       list_next( &i );
    }
@@ -257,13 +265,26 @@ struct cache_entry* cache_alloc_entry( void ) {
    entry->dependency = NULL;
    entry->dependency_tail = NULL;
    entry->lib = NULL;
+   entry->header = NULL;
    str_init( &entry->path );
+   str_init( &entry->defines );
    entry->compile_time = 0;
    entry->id = 0;
+   entry->type = CACHEENTRY_LIB;
    entry->modified = false;
    return entry;
 }
 
+// Frees the previous dependencies of an entry.
+static void replace_dependencies( struct cache* cache,
+   struct cache_entry* entry ) {
+   if ( entry->dependency ) {
+      entry->dependency_tail->next = cache->free_dependencies;
+      cache->free_dependencies = entry->dependency;
+      entry->dependency = NULL;
+   }
+}
+
 static int generate_id( struct cache* cache ) {
    // Search for an unused ID between entries.
    int id = 0;
@@ -323,7 +344,7 @@ struct cache_dependency* cache_alloc_dependency( struct cache* cache,
    }
    dep->next = NULL;
    str_append( &dep->path, path );
-   dep->mtime = 0;
+   dep->hash = 0;
    return dep;
 }
 
@@ -349,7 +370,7 @@ struct library* cache_get( struct cache* cache, struct file_entry* file ) {
    }
    // Load only once the contents of a cached library.
    if ( ! entry->lib ) {
-      if ( timestamp_entry( entry ) && fresh_entry( entry ) &&
+      if ( fresh_entry( entry ) &&
          restore_lib( cache, entry ) ) {
          entry->lib->file = file;
       }
@@ -360,33 +381,109 @@ struct library* cache_get( struct cache* cache, struct file_entry* file ) {
 static struct cache_entry* find_entry( struct cache* cache,
    const char* path ) {
    struct cache_entry* entry = cache->entries.head;
-   while ( entry && strcmp( entry->path.value, path ) != 0 ) {
+   while ( entry && ! ( entry->type == CACHEENTRY_LIB &&
+      strcmp( entry->path.value, path ) == 0 ) ) {
       entry = entry->next;
    }
    return entry;
 }
 
-static bool timestamp_entry( struct cache_entry* entry ) {
-   struct cache_dependency* dep = entry->dependency;
-   while ( dep ) {
-      struct fs_query query;
-      fs_init_query( &query, dep->path.value );
-      struct fs_timestamp timestamp;
-      if ( ! fs_get_mtime( &query, &timestamp ) ) {
-         return false;
+// Saves the snapshot of a header. A header has a separate snapshot for each
+// set of command-line macros it is read with. The dependencies are the files
+// read for the header.
+void cache_add_header( struct cache* cache, struct file_entry* file,
+   const char* defines, struct header_snapshot* snapshot ) {
+   struct cache_entry* entry = find_header_entry( cache,
+      file->full_path.value, defines );
+   if ( ! entry ) {
+      entry = cache_alloc_entry();
+      str_append( &entry->path, file->full_path.value );
+      str_append( &entry->defines, defines );
+      entry->id = generate_id( cache );
+      entry->type = CACHEENTRY_HEADER;
+      append_entry_sorted( &cache->entries, entry );
+   }
+   replace_dependencies( cache, entry );
+   struct list_iter i;
+   list_iterate( &snapshot->files, &i );
+   while ( ! list_end( &i ) ) {
+      struct header_file* header_file = list_data( &i );
+      if ( header_file->full_path ) {
+         struct cache_dependency* dep = entry->dependency;
+         while ( dep && strcmp( dep->path.value,
+            header_file->full_path ) != 0 ) {
+            dep = dep->next;
+         }
+         if ( ! dep ) {
+            dep = cache_alloc_dependency( cache, header_file->full_path );
+            hash_file( dep->path.value, &dep->hash );
+            cache_append_dependency( entry, dep );
+         }
       }
-      dep->mtime = timestamp.value;
-      dep = dep->next;
+      list_next( &i );
+   }
+   entry->header = snapshot;
+   entry->compile_time = cache->task->compile_time;
+   entry->modified = true;
+}
+
+struct header_snapshot* cache_get_header( struct cache* cache,
+   struct file_entry* file, const char* defines ) {
+   struct cache_entry* entry = find_header_entry( cache,
+      file->full_path.value, defines );
+   if ( ! entry ) {
+      return NULL;
+   }
+   if ( ! entry->header && fresh_entry( entry ) ) {
+      restore_header( cache, entry );
    }
+   return entry->header;
+}
+
+static struct cache_entry* find_header_entry( struct cache* cache,
+   const char* path, const char* defines ) {
+   struct cache_entry* entry = cache->entries.head;
+   while ( entry && ! ( entry->type == CACHEENTRY_HEADER &&
+      strcmp( entry->path.value, path ) == 0 &&
+      strcmp( entry->defines.value, defines ) == 0 ) ) {
+      entry = entry->next;
+   }
+   return entry;
+}
+
+// FNV-1a hash of the contents of a file.
+static bool hash_file( const char* path, unsigned int* hash ) {
+   FILE* fh = fopen( path, "rb" );
+   if ( ! fh ) {
+      return false;
+   }
+   unsigned int value = 2166136261u;
+   unsigned char buffer[ 4096 ];
+   size_t count;
+   while ( ( count = fread( buffer, 1, sizeof( buffer ), fh ) ) > 0 ) {
+      for ( size_t i = 0; i < count; ++i ) {
+         value ^= buffer[ i ];
+         value *= 16777619u;
+      }
+   }
+   fclose( fh );
+   *hash = value;
    return true;
 }
 
+// An entry is fresh when the contents of its dependencies have not changed
+// since the library was cached. The modification time of a file is not used,
+// so touching a file, or checking it out again, keeps the entry.
 static bool fresh_entry( struct cache_entry* entry ) {
    struct cache_dependency* dep = entry->dependency;
-   while ( dep && dep->mtime <= entry->compile_time ) {
+   while ( dep ) {
+      unsigned int hash;
+      if ( ! hash_file( dep->path.value, &hash ) || hash != dep->hash ) {
+         return false;
+      }
       dep = dep->next;
    }
-   return ( dep == NULL );
+   return true;
 }
 
 static bool restore_lib( struct cache* cache, struct cache_entry* entry ) {
@@ -400,11 +497,22 @@ static bool restore_lib( struct cache* cache, struct cache_entry* entry ) {
    return ( entry->lib != NULL );
 }
 
+static void restore_header( struct cache* cache, struct cache_entry* entry ) {
+   struct str path;
+   str_init( &path );
+   append_entry_path( cache, entry, &path );
+   struct restore_request request;
+   init_restore_request( &request, RESTORE_HEADER, &path );
+   restore( cache, &request );
+   entry->header = request.header;
+   str_deinit( &path );
+}
+
 static void append_entry_path( struct cache* cache, struct cache_entry* entry,
    struct str* path ) {
    str_append( path, cache->dir_path.value );
    str_append( path, OS_PATHSEP );
-   str_append( path, "lib" );
+   str_append( path, entry->type == CACHEENTRY_HEADER ? "header" : "lib" );
    char id[ 12 ];
    snprintf( id, sizeof( id ), "%d", entry->id );
    str_append( path, id );
@@ -494,7 +602,7 @@ static void save_cache( struct cache* cache ) {
    entry = cache->entries.head;
    while ( entry ) {
       if ( entry->modified ) {
-         save_lib( cache, entry );
+         save_entry( cache, entry );
          archive_updated = true;
       }
       entry = entry->next;
@@ -505,12 +613,17 @@ static void save_cache( struct cache* cache ) {
    }
 }
 
-static void save_lib( struct cache* cache, struct cache_entry* entry ) {
+static void save_entry( struct cache* cache, struct cache_entry* entry ) {
    struct field_writer writer;
    gbuf_reset( &cache->task->growing_buffer );
    f_init_writer( &writer, &cache->task->growing_buffer );
    save_header( cache, &writer );
-   cache_save_lib( cache->task, &writer, entry->lib );
+   if ( entry->type == CACHEENTRY_HEADER ) {
+      cache_save_header( cache->task, &writer, entry->header );
+   }
+   else {
+      cache_save_lib( cache->task, &writer, entry->lib );
+   }
    struct str path;
    str_init( &path );
    append_entry_path( cache, entry, &path );
@@ -549,12 +662,19 @@ void cache_print( struct cache* cache ) {
       printf( "lifetime=infinite\n" );
    }
    int total = 0;
+   int total_headers = 0;
    struct cache_entry* entry = cache->entries.head;
    while ( entry ) {
-      ++total;
+      if ( entry->type == CACHEENTRY_HEADER ) {
+         ++total_headers;
+      }
+      else {
+         ++total;
+      }
       entry = entry->next;
    }
    printf( "total-libraries=%d\n", total );
+   printf( "total-headers=%d\n", total_headers );
    entry = cache->entries.head;
    while ( entry ) {
       print_entry( cache, entry );
@@ -563,7 +683,13 @@ void cache_print( struct cache* cache ) {
 }
 
 static void print_entry( struct cache* cache, struct cache_entry* entry ) {
-   printf( "library=%s\n", entry->path.value );
+   if ( entry->type == CACHEENTRY_HEADER ) {
+      printf( "header=%s\n", entry->path.value );
+      printf( "  defines=%s\n", entry->defines.value );
+   }
+   else {
+      printf( "library=%s\n", entry->path.value );
+   }
    struct str path;
    str_init( &path );
    append_entry_path( cache, entry, &path );
@@ -10,16 +10,23 @@ struct cache_entry {
    struct cache_dependency* dependency;
    struct cache_dependency* dependency_tail;
    struct library* lib;
+   struct header_snapshot* header;
    struct str path;
+   // The macros defined on the command line when the header was read.
+   struct str defines;
    time_t compile_time;
    int id;
+   enum {
+      CACHEENTRY_LIB,
+      CACHEENTRY_HEADER,
+   } type;
    bool modified;
 };
 
 struct cache_dependency {
    struct cache_dependency* next;
    struct str path;
-   time_t mtime;
+   unsigned int hash;
 };
 
 struct cache_entry_list {
@@ -27,6 +34,54 @@ struct cache_entry_list {
    struct cache_entry* tail;
 };
 
+// A token of a header snapshot. The ID of a position is an internal file, or,
+// starting at INTERNALFILE_TOTAL, a file of the snapshot.
+struct header_token {
+   unsigned int text;
+   int length;
+   int type;
+   struct pos pos;
+   // The token has the shared text of its type, so the text is not saved.
+   bool shared_text;
+};
+
+struct header_token_list {
+   struct header_token* entries;
+   int size;
+   int capacity;
+};
+
+// An include-history entry created while the header was read. The paths are
+// NULL for the entry of a #line directive.
+struct header_file {
+   const char* path;
+   const char* full_path;
+   const char* altern_name;
+   const char* guard;
+   // Index of the parent file, or -1 for the file that #included the header.
+   int parent;
+   int line;
+   int lines;
+};
+
+struct header_macro {
+   const char* name;
+   struct list params;
+   struct header_token_list body;
+   struct pos pos;
+   bool func_like;
+   bool variadic;
+};
+
+// What an #included header leaves behind: the macros defined once it is read,
+// and the tokens it passes to the parser.
+struct header_snapshot {
+   struct list files;
+   struct list macros;
+   struct header_token_list tokens;
+   int included_lines;
+};
+
 struct cache {
    struct task* task;
    struct str dir_path;
@@ -42,6 +97,15 @@ void cache_init( struct cache* cache, struct task* task );
 void cache_load( struct cache* cache );
 void cache_add( struct cache* cache, struct library* lib );
 struct library* cache_get( struct cache* cache, struct file_entry* file );
+void cache_add_header( struct cache* cache, struct file_entry* file,
+   const char* defines, struct header_snapshot* snapshot );
+struct header_snapshot* cache_get_header( struct cache* cache,
+   struct file_entry* file, const char* defines );
+struct header_snapshot* cache_alloc_header_snapshot( void );
+struct header_file* cache_alloc_header_file( void );
+struct header_macro* cache_alloc_header_macro( void );
+struct header_token* cache_append_header_token(
+   struct header_token_list* list );
 void cache_close( struct cache* cache );
 struct cache_entry* cache_alloc_entry( void );
 void cache_append_entry( struct cache_entry_list* entries,
@@ -58,6 +122,10 @@ void cache_save_lib( struct task* task, struct field_writer* writer,
    struct library* lib );
 struct library* cache_restore_lib( struct cache* cache,
    struct field_reader* reader );
+void cache_save_header( struct task* task, struct field_writer* writer,
+   struct header_snapshot* snapshot );
+struct header_snapshot* cache_restore_header( struct cache* cache,
+   struct field_reader* reader );
 void cache_print( struct cache* cache );
 
 #endif
@@ -0,0 +1,312 @@
+#include <string.h>
+
+#include "../task.h"
+#include "cache.h"
+
+static void init_token_list( struct header_token_list* list );
+
+struct header_snapshot* cache_alloc_header_snapshot( void ) {
+   struct header_snapshot* snapshot = mem_alloc( sizeof( *snapshot ) );
+   list_init( &snapshot->files );
+   list_init( &snapshot->macros );
+   init_token_list( &snapshot->tokens );
+   snapshot->included_lines = 0;
+   return snapshot;
+}
+
+static void init_token_list( struct header_token_list* list ) {
+   list->entries = NULL;
+   list->size = 0;
+   list->capacity = 0;
+}
+
+struct header_file* cache_alloc_header_file( void ) {
+   struct header_file* file = mem_alloc( sizeof( *file ) );
+   file->path = NULL;
+   file->full_path = NULL;
+   file->altern_name = NULL;
+   file->guard = NULL;
+   file->parent = -1;
+   file->line = 0;
+   file->lines = 0;
+   return file;
+}
+
+struct header_macro* cache_alloc_header_macro( void ) {
+   struct header_macro* macro = mem_alloc( sizeof( *macro ) );
+   macro->name = NULL;
+   list_init( &macro->params );
+   init_token_list( &macro->body );
+   t_init_pos_id( &macro->pos, INTERNALFILE_COMPILER );
+   macro->func_like = false;
+   macro->variadic = false;
+   return macro;
+}
+
+struct header_token* cache_append_header_token(
+   struct header_token_list* list ) {
+   if ( list->size == list->capacity ) {
+      list->capacity = ( list->capacity > 0 ) ? list->capacity * 2 : 64;
+      list->entries = mem_realloc( list->entries,
+         sizeof( *list->entries ) * list->capacity );
+   }
+   struct header_token* token = &list->entries[ list->size ];
+   ++list->size;
+   return token;
+}
+
+// Save
+// ==========================================================================
+
+#define WF( saver, field ) \
+   f_wf( saver->w, field )
+#define WV( saver, field, value ) \
+   f_wv( saver->w, field, value, sizeof( *( value ) ) )
+#define WS( saver, field, value ) \
+   f_ws( saver->w, field, value )
+
+enum {
+   F_ALTERNNAME,
+   F_COLUMN,
+   F_END,
+   F_FILE,
+   F_FULLPATH,
+   F_FUNCLIKE,
+   F_GUARD,
+   F_ID,
+   F_INCLUDEDLINES,
+   F_LENGTH,
+   // 10
+   F_LINE,
+   F_LINES,
+   F_MACRO,
+   F_NAME,
+   F_PARAM,
+   F_PARENT,
+   F_PATH,
+   F_POS,
+   F_SHAREDTEXT,
+   F_SNAPSHOT,
+   // 20
+   F_TEXT,
+   F_TOKEN,
+   F_TYPE,
+   F_VARIADIC,
+};
+
+struct saver {
+   struct task* task;
+   struct field_writer* w;
+};
+
+static void save_snapshot( struct saver* saver,
+   struct header_snapshot* snapshot );
+static void save_file( struct saver* saver, struct header_file* file );
+static void save_macro( struct saver* saver, struct header_macro* macro );
+static void save_token_list( struct saver* saver,
+   struct header_token_list* list );
+static void save_pos( struct saver* saver, struct pos* pos );
+
+void cache_save_header( struct task* task, struct field_writer* writer,
+   struct header_snapshot* snapshot ) {
+   struct saver saver;
+   saver.task = task;
+   saver.w = writer;
+   save_snapshot( &saver, snapshot );
+}
+
+static void save_snapshot( struct saver* saver,
+   struct header_snapshot* snapshot ) {
+   WF( saver, F_SNAPSHOT );
+   struct list_iter i;
+   list_iterate( &snapshot->files, &i );
+   while ( ! list_end( &i ) ) {
+      save_file( saver, list_data( &i ) );
+      list_next( &i );
+   }
+   list_iterate( &snapshot->macros, &i );
+   while ( ! list_end( &i ) ) {
+      save_macro( saver, list_data( &i ) );
+      list_next( &i );
+   }
+   save_token_list( saver, &snapshot->tokens );
+   WV( saver, F_INCLUDEDLINES, &snapshot->included_lines );
+   WF( saver, F_END );
+}
+
+static void save_file( struct saver* saver, struct header_file* file ) {
+   WF( saver, F_FILE );
+   if ( file->path ) {
+      WS( saver, F_PATH, file->path );
+      WS( saver, F_FULLPATH, file->full_path );
+   }
+   if ( file->altern_name ) {
+      WS( saver, F_ALTERNNAME, file->altern_name );
+   }
+   if ( file->guard ) {
+      WS( saver, F_GUARD, file->guard );
+   }
+   WV( saver, F_PARENT, &file->parent );
+   WV( saver, F_LINE, &file->line );
+   WV( saver, F_LINES, &file->lines );
+   WF( saver, F_END );
+}
+
+static void save_macro( struct saver* saver, struct header_macro* macro ) {
+   WF( saver, F_MACRO );
+   WS( saver, F_NAME, macro->name );
+   save_pos( saver, &macro->pos );
+   WV( saver, F_FUNCLIKE, &macro->func_like );
+   WV( saver, F_VARIADIC, &macro->variadic );
+   struct list_iter i;
+   list_iterate( &macro->params, &i );
+   while ( ! list_end( &i ) ) {
+      WS( saver, F_PARAM, list_data( &i ) );
+      list_next( &i );
+   }
+   save_token_list( saver, &macro->body );
+   WF( saver, F_END );
+}
+
+static void save_token_list( struct saver* saver,
+   struct header_token_list* list ) {
+   for ( int i = 0; i < list->size; ++i ) {
+      struct header_token* token = &list->entries[ i ];
+      WF( saver, F_TOKEN );
+      WV( saver, F_TYPE, &token->type );
+      if ( token->shared_text ) {
+         WF( saver, F_SHAREDTEXT );
+      }
+      else {
+         WS( saver, F_TEXT, t_text( saver->task, token->text ) );
+      }
+      WV( saver, F_LENGTH, &token->length );
+      save_pos( saver, &token->pos );
+   }
+}
+
+static void save_pos( struct saver* saver, struct pos* pos ) {
+   WF( saver, F_POS );
+   WV( saver, F_LINE, &pos->line );
+   WV( saver, F_COLUMN, &pos->column );
+   WV( saver, F_ID, &pos->id );
+   WF( saver, F_END );
+}
+
+// Restore
+// ==========================================================================
+
+#define RF( restorer, field ) \
+   f_rf( restorer->r, field )
+#define RV( restorer, field, value ) \
+   f_rv( restorer->r, field, value, sizeof( *( value ) ) )
+#define RS( restorer, field ) \
+   f_rs( restorer->r, field )
+
+struct restorer {
+   struct task* task;
+   struct field_reader* r;
+   struct header_snapshot* snapshot;
+};
+
+static void restore_snapshot( struct restorer* restorer );
+static void restore_file( struct restorer* restorer );
+static void restore_macro( struct restorer* restorer );
+static void restore_token_list( struct restorer* restorer,
+   struct header_token_list* list );
+static void restore_pos( struct restorer* restorer, struct pos* pos );
+static const char* restore_text( struct restorer* restorer, int field );
+
+struct header_snapshot* cache_restore_header( struct cache* cache,
+   struct field_reader* reader ) {
+   struct restorer restorer;
+   restorer.task = cache->task;
+   restorer.r = reader;
+   restorer.snapshot = cache_alloc_header_snapshot();
+   restore_snapshot( &restorer );
+   return restorer.snapshot;
+}
+
+static void restore_snapshot( struct restorer* restorer ) {
+   RF( restorer, F_SNAPSHOT );
+   while ( f_peek( restorer->r ) == F_FILE ) {
+      restore_file( restorer );
+   }
+   while ( f_peek( restorer->r ) == F_MACRO ) {
+      restore_macro( restorer );
+   }
+   restore_token_list( restorer, &restorer->snapshot->tokens );
+   RV( restorer, F_INCLUDEDLINES, &restorer->snapshot->included_lines );
+   RF( restorer, F_END );
+}
+
+static void restore_file( struct restorer* restorer ) {
+   RF( restorer, F_FILE );
+   struct header_file* file = cache_alloc_header_file();
+   if ( f_peek( restorer->r ) == F_PATH ) {
+      file->path = restore_text( restorer, F_PATH );
+      file->full_path = restore_text( restorer, F_FULLPATH );
+   }
+   if ( f_peek( restorer->r ) == F_ALTERNNAME ) {
+      file->altern_name = restore_text( restorer, F_ALTERNNAME );
+   }
+   if ( f_peek( restorer->r ) == F_GUARD ) {
+      file->guard = restore_text( restorer, F_GUARD );
+   }
+   RV( restorer, F_PARENT, &file->parent );
+   RV( restorer, F_LINE, &file->line );
+   RV( restorer, F_LINES, &file->lines );
+   RF( restorer, F_END );
+   list_append( &restorer->snapshot->files, file );
+}
+
+static void restore_macro( struct restorer* restorer ) {
+   RF( restorer, F_MACRO );
+   struct header_macro* macro = cache_alloc_header_macro();
+   macro->name = restore_text( restorer, F_NAME );
+   restore_pos( restorer, &macro->pos );
+   RV( restorer, F_FUNCLIKE, &macro->func_like );
+   RV( restorer, F_VARIADIC, &macro->variadic );
+   while ( f_peek( restorer->r ) == F_PARAM ) {
+      list_append( &macro->params, ( void* ) restore_text( restorer,
+         F_PARAM ) );
+   }
+   restore_token_list( restorer, &macro->body );
+   RF( restorer, F_END );
+   list_append( &restorer->snapshot->macros, macro );
+}
+
+static void restore_token_list( struct restorer* restorer,
+   struct header_token_list* list ) {
+   while ( f_peek( restorer->r ) == F_TOKEN ) {
+      RF( restorer, F_TOKEN );
+      struct header_token* token = cache_append_header_token( list );
+      RV( restorer, F_TYPE, &token->type );
+      if ( f_peek( restorer->r ) == F_SHAREDTEXT ) {
+         RF( restorer, F_SHAREDTEXT );
+         token->text = 0;
+         token->shared_text = true;
+      }
+      else {
+         const char* value = RS( restorer, F_TEXT );
+         token->text = t_intern_text_offset( restorer->task, value,
+            strlen( value ) );
+         token->shared_text = false;
+      }
+      RV( restorer, F_LENGTH, &token->length );
+      restore_pos( restorer, &token->pos );
+   }
+}
+
+static void restore_pos( struct restorer* restorer, struct pos* pos ) {
+   RF( restorer, F_POS );
+   RV( restorer, F_LINE, &pos->line );
+   RV( restorer, F_COLUMN, &pos->column );
+   RV( restorer, F_ID, &pos->id );
+   RF( restorer, F_END );
+}
+
+static const char* restore_text( struct restorer* restorer, int field ) {
+   const char* value = RS( restorer, field );
+   return t_intern_text( restorer->task, value, strlen( value ) );
+}
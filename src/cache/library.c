@@ -85,6 +85,9 @@ struct saver {
    struct field_writer* w;
    struct library* lib;
    struct str string;
+   // Position in the file map of each file, indexed by file ID.
+   int* file_map;
+   int file_map_size;
 };
 
 static void save_lib( struct saver* saver );
@@ -129,8 +132,13 @@ void cache_save_lib( struct task* task, struct field_writer* writer,
    saver.w = writer;
    saver.lib = lib;
    str_init( &saver.string );
+   saver.file_map = NULL;
+   saver.file_map_size = 0;
    save_lib( &saver );
    str_deinit( &saver.string );
+   if ( saver.file_map ) {
+      mem_free( saver.file_map );
+   }
 }
 
 static void save_lib( struct saver* saver ) {
@@ -148,11 +156,22 @@ static void save_file_map( struct saver* saver ) {
    WF( saver, F_FILEMAP );
    int size = list_size( &saver->lib->files );
    WV( saver, F_SIZE, &size );
+   saver->file_map_size = saver->task->last_id;
+   saver->file_map = mem_alloc( sizeof( *saver->file_map ) *
+      ( saver->file_map_size + 1 ) );
+   for ( int i = 0; i < saver->file_map_size; ++i ) {
+      saver->file_map[ i ] = -1;
+   }
+   int map_id = 0;
    struct list_iter i;
    list_iterate( &saver->lib->files, &i );
    while ( ! list_end( &i ) ) {
       struct file_entry* file = list_data( &i );
       WS( saver, F_FILEPATH, file->full_path.value );
+      if ( saver->file_map[ file->id ] == -1 ) {
+         saver->file_map[ file->id ] = map_id;
+      }
+      ++map_id;
       list_next( &i );
    }
    WF( saver, F_END );
@@ -576,16 +595,9 @@ static void save_pos( struct saver* saver, struct pos* pos ) {
 }
 
 static int map_file( struct saver* saver, int id ) {
-   struct list_iter i;
-   list_iterate( &saver->lib->files, &i );
-   int map_id = 0;
-   while ( ! list_end( &i ) ) {
-      struct file_entry* file = list_data( &i );
-      if ( file->id == id ) {
-         return map_id;
-      }
-      ++map_id;
-      list_next( &i );
+   if ( id >= 0 && id < saver->file_map_size &&
+      saver->file_map[ id ] != -1 ) {
+      return saver->file_map[ id ];
    }
    return 0;
 }
@@ -994,6 +1006,7 @@ static struct ref* restore_ref( struct restorer* restorer ) {
       ref->next = NULL;
       ref->pos = pos;
       ref->type = type;
+      ref->type_node = NULL;
       RV( restorer, F_NULLABLE, &ref->nullable );
       RF( restorer, F_END );
       if ( head ) {
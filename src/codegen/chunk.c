@@ -78,7 +78,9 @@ void c_write_chunk_obj( struct codegen* codegen ) {
    // Reserve header.
    c_add_int( codegen, 0 );
    c_add_int( codegen, 0 );
+   enum timer timer = t_switch_timer( codegen->task, TIMER_WRITE_CODE );
    c_write_user_code( codegen );
+   t_switch_timer( codegen->task, timer );
    int chunk_pos = c_tell( codegen );
    do_sptr( codegen );
    do_svct( codegen );
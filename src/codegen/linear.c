@@ -231,9 +231,11 @@ static void add_fixed( struct codegen* codegen, int code, va_list* args ) {
 // ==========================================================================
 
 void c_flush_pcode( struct codegen* codegen ) {
+   enum timer timer = t_switch_timer( codegen->task, TIMER_FLUSH_PCODE );
    struct c_node* node = codegen->node_head;
    while ( node ) {
       write_node( codegen, node );
+      ++codegen->stats.written_nodes;
       node = node->next;
    }
    // Patch address of jumps and delete nodes.
@@ -264,6 +266,7 @@ void c_flush_pcode( struct codegen* codegen ) {
    codegen->node = NULL;
    codegen->node_head = NULL;
    codegen->node_tail = NULL;
+   t_switch_timer( codegen->task, timer );
 }
 
 static void write_node( struct codegen* codegen, struct c_node* node ) {
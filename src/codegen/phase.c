@@ -66,6 +66,7 @@ void c_init( struct codegen* codegen, struct task* task ) {
    codegen->null_handler = NULL;
    codegen->object_size = 0;
    codegen->dummy_script_offset = 0;
+   codegen->stats.written_nodes = 0;
 }
 
 void c_publish( struct codegen* codegen ) {
@@ -83,7 +84,9 @@ void c_publish( struct codegen* codegen ) {
       list_size( &codegen->task->runtime_asserts ) > 0 ) {
       create_assert_strings( codegen );
    }
+   enum timer timer = t_switch_timer( codegen->task, TIMER_WRITE_CHUNKS );
    c_write_chunk_obj( codegen );
+   t_switch_timer( codegen->task, timer );
 }
 
 static void clarify_vars( struct codegen* codegen ) {
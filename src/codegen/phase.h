@@ -109,6 +109,10 @@ struct codegen {
    struct func* null_handler;
    int object_size;
    int dummy_script_offset;
+   // Reported by the -time-report option.
+   struct {
+      int written_nodes;
+   } stats;
 };
 
 void c_init( struct codegen*, struct task* );
@@ -11,11 +11,27 @@
 // NOTE: The functions below may be violating the strict-aliasing rule.
 // ==========================================================================
 
-// Linked list of current allocations. The head is the most recent allocation.
-// This way, a short-term allocation can be found and removed quicker.
-static struct alloc {
+// Every allocation belongs to an arena. An arena keeps a doubly linked list of
+// its current allocations. The head is the most recent allocation. Each
+// allocation knows its neighbors, so it can be removed from the list without
+// searching for it.
+struct alloc {
    struct alloc* next;
-}* g_alloc = NULL;
+   struct alloc* prev;
+   size_t size;
+   enum mem_arena arena;
+};
+static struct {
+   struct alloc* head;
+   struct mem_arena_stats stats;
+} g_arenas[ MEM_ARENA_TOTAL ];
+// Arena that receives allocations not explicitly placed in an arena.
+static enum mem_arena g_arena = MEM_ARENA_GENERAL;
+static size_t g_total_size = 0;
+static size_t g_total_peak_size = 0;
+// Held by every memory operation while allocations are made from several
+// threads.
+static struct mutex* g_lock = NULL;
 // Allocation sizes for bulk allocation.
 static struct {
    size_t size;
@@ -49,9 +65,22 @@ static struct {
    size_t slots_used;
 } g_bulk;
 
+static void link_alloc( struct alloc* );
 static void unlink_alloc( struct alloc* );
+static void lock_mem( void );
+static void unlock_mem( void );
 
 void mem_init( void ) {
+   for ( int i = 0; i < MEM_ARENA_TOTAL; ++i ) {
+      g_arenas[ i ].head = NULL;
+      g_arenas[ i ].stats.allocs = 0;
+      g_arenas[ i ].stats.size = 0;
+      g_arenas[ i ].stats.peak_size = 0;
+   }
+   g_arena = MEM_ARENA_GENERAL;
+   g_total_size = 0;
+   g_total_peak_size = 0;
+   g_lock = NULL;
    g_bulk.slots_used = 0;
    size_t i = 0;
    while ( i < ARRAY_SIZE( g_bulk_sizes ) ) {
@@ -81,53 +110,95 @@ void mem_init( void ) {
 }
 
 void* mem_alloc( size_t size ) {
-   return mem_realloc( NULL, size );
+   return mem_arena_alloc( g_arena, size );
 }
 
-void* mem_realloc( void* block, size_t size ) {
-   struct alloc* alloc = NULL;
-   if ( block ) {
-      alloc = ( struct alloc* ) block - 1;
-      unlink_alloc( alloc );
-   }
-   alloc = realloc( alloc, sizeof( *alloc ) + size );
+void* mem_arena_alloc( enum mem_arena arena, size_t size ) {
+   struct alloc* alloc = malloc( sizeof( *alloc ) + size );
    if ( ! alloc ) {
       mem_free_all();
       printf( "error: failed to allocate memory block of %zu bytes\n", size );
       exit( EXIT_FAILURE );
    }
-   alloc->next = g_alloc;
-   g_alloc = alloc;
+   alloc->size = size;
+   alloc->arena = arena;
+   lock_mem();
+   link_alloc( alloc );
+   ++g_arenas[ arena ].stats.allocs;
+   unlock_mem();
    return alloc + 1;
 }
 
-static void unlink_alloc( struct alloc* alloc ) {
-   struct alloc* curr = g_alloc;
-   struct alloc* prev = NULL;
-   while ( curr != alloc ) {
-      prev = curr;
-      curr = curr->next;
+// A reallocated block stays in the arena it was originally allocated in.
+void* mem_realloc( void* block, size_t size ) {
+   if ( ! block ) {
+      return mem_alloc( size );
+   }
+   struct alloc* alloc = ( struct alloc* ) block - 1;
+   lock_mem();
+   unlink_alloc( alloc );
+   unlock_mem();
+   struct alloc* new_alloc = realloc( alloc, sizeof( *alloc ) + size );
+   if ( ! new_alloc ) {
+      free( alloc );
+      mem_free_all();
+      printf( "error: failed to allocate memory block of %zu bytes\n", size );
+      exit( EXIT_FAILURE );
+   }
+   new_alloc->size = size;
+   lock_mem();
+   link_alloc( new_alloc );
+   unlock_mem();
+   return new_alloc + 1;
+}
+
+static void link_alloc( struct alloc* alloc ) {
+   struct alloc** head = &g_arenas[ alloc->arena ].head;
+   alloc->next = *head;
+   alloc->prev = NULL;
+   if ( *head ) {
+      ( *head )->prev = alloc;
    }
-   if ( prev ) {
-      prev->next = alloc->next;
+   *head = alloc;
+   struct mem_arena_stats* stats = &g_arenas[ alloc->arena ].stats;
+   stats->size += alloc->size;
+   if ( stats->size > stats->peak_size ) {
+      stats->peak_size = stats->size;
+   }
+   g_total_size += alloc->size;
+   if ( g_total_size > g_total_peak_size ) {
+      g_total_peak_size = g_total_size;
+   }
+}
+
+static void unlink_alloc( struct alloc* alloc ) {
+   if ( alloc->prev ) {
+      alloc->prev->next = alloc->next;
    }
    else {
-      g_alloc = alloc->next;
+      g_arenas[ alloc->arena ].head = alloc->next;
+   }
+   if ( alloc->next ) {
+      alloc->next->prev = alloc->prev;
    }
+   g_arenas[ alloc->arena ].stats.size -= alloc->size;
+   g_total_size -= alloc->size;
 }
 
 void* mem_slot_alloc( size_t size ) {
    size_t i = 0;
    while ( i < g_bulk.slots_used ) {
       if ( g_bulk.slots[ i ].size == size ) {
+         lock_mem();
          // Reuse a previously allocated block.
          if ( g_bulk.slots[ i ].free_block ) {
             struct free_block* free_block = g_bulk.slots[ i ].free_block;
             g_bulk.slots[ i ].free_block = free_block->next;
+            unlock_mem();
             return free_block;
          }
          // When no more blocks are left, allocate a series of blocks in a
-         // single allocation.
+         // single allocation. The series is allocated in the current arena.
          if ( ! g_bulk.slots[ i ].left ) {
             g_bulk.slots[ i ].left = g_bulk.slots[ i ].quantity;
             g_bulk.slots[ i ].block = mem_alloc( g_bulk.slots[ i ].size *
@@ -136,6 +207,7 @@ void* mem_slot_alloc( size_t size ) {
          char* block = g_bulk.slots[ i ].block;
          g_bulk.slots[ i ].block += g_bulk.slots[ i ].size;
          --g_bulk.slots[ i ].left;
+         unlock_mem();
          return block;
       }
       ++i;
@@ -145,7 +217,9 @@ void* mem_slot_alloc( size_t size ) {
 
 void mem_free( void* block ) {
    struct alloc* alloc = ( struct alloc* ) block - 1;
+   lock_mem();
    unlink_alloc( alloc );
+   unlock_mem();
    free( alloc );
 }
 
@@ -154,8 +228,10 @@ void mem_slot_free( void* block, size_t size ) {
    while ( i < g_bulk.slots_used ) {
       if ( g_bulk.slots[ i ].size == size ) {
          struct free_block* free_block = block;
+         lock_mem();
          free_block->next = g_bulk.slots[ i ].free_block;
          g_bulk.slots[ i ].free_block = free_block;
+         unlock_mem();
          return;
       }
       ++i;
@@ -164,10 +240,56 @@ void mem_slot_free( void* block, size_t size ) {
 }
 
 void mem_free_all( void ) {
-   while ( g_alloc ) {
-      struct alloc* next = g_alloc->next;
-      free( g_alloc );
-      g_alloc = next;
+   for ( int i = 0; i < MEM_ARENA_TOTAL; ++i ) {
+      mem_free_arena( i );
+   }
+}
+
+// Selects the arena that receives subsequent allocations. Returns the arena
+// that was previously selected.
+enum mem_arena mem_select_arena( enum mem_arena arena ) {
+   enum mem_arena prev_arena = g_arena;
+   g_arena = arena;
+   return prev_arena;
+}
+
+// Frees every allocation made in the specified arena. Bulk allocations are
+// never made in the transient arena, so the slots are unaffected by releasing
+// it.
+void mem_free_arena( enum mem_arena arena ) {
+   struct alloc* alloc = g_arenas[ arena ].head;
+   while ( alloc ) {
+      struct alloc* next = alloc->next;
+      g_total_size -= alloc->size;
+      free( alloc );
+      alloc = next;
+   }
+   g_arenas[ arena ].head = NULL;
+   g_arenas[ arena ].stats.size = 0;
+}
+
+void mem_get_arena_stats( enum mem_arena arena,
+   struct mem_arena_stats* stats ) {
+   *stats = g_arenas[ arena ].stats;
+}
+
+size_t mem_get_peak_size( void ) {
+   return g_total_peak_size;
+}
+
+void mem_set_lock( struct mutex* mutex ) {
+   g_lock = mutex;
+}
+
+static void lock_mem( void ) {
+   if ( g_lock ) {
+      c_lock( g_lock );
+   }
+}
+
+static void unlock_mem( void ) {
+   if ( g_lock ) {
+      c_unlock( g_lock );
    }
 }
 
@@ -224,7 +346,7 @@ void str_append( struct str* str, const char* value ) {
 }
 
 void str_append_sub( struct str* str, const char* cstr, int length ) {
-   adjust_buffer( str, str->buffer_length + length );
+   adjust_buffer( str, str->length + length );
    memcpy( str->value + str->length, cstr, length );
    str->length += length;
    str->value[ str->length ] = '\0';
@@ -466,6 +588,11 @@ bool c_same_fileid( struct fileid* a, struct fileid* b ) {
    return ( a->id_high == b->id_high && a->id_low == b->id_low );
 }
 
+unsigned int c_hash_fileid( struct fileid* fileid ) {
+   return ( ( unsigned int ) fileid->id_low * 2654435761u ) ^
+      ( unsigned int ) fileid->id_high;
+}
+
 #else
 
 #include <sys/stat.h>
@@ -484,11 +611,182 @@ bool c_same_fileid( struct fileid* a, struct fileid* b ) {
    return ( a->device == b->device && a->number == b->number );
 }
 
+unsigned int c_hash_fileid( struct fileid* fileid ) {
+   return ( ( unsigned int ) fileid->number * 2654435761u ) ^
+      ( unsigned int ) fileid->device;
+}
+
+#endif
+
+// Time
+// ==========================================================================
+
+#if OS_WINDOWS
+
+// Returns the time, in seconds, since an unspecified point in the past. The
+// time only moves forward.
+double c_get_wall_time( void ) {
+   LARGE_INTEGER count;
+   LARGE_INTEGER frequency;
+   QueryPerformanceCounter( &count );
+   QueryPerformanceFrequency( &frequency );
+   return ( double ) count.QuadPart / frequency.QuadPart;
+}
+
+#else
+
+#include <time.h>
+
+double c_get_wall_time( void ) {
+   struct timespec time;
+   clock_gettime( CLOCK_MONOTONIC, &time );
+   return time.tv_sec + time.tv_nsec / 1e9;
+}
+
+#endif
+
+// Threads
+// ==========================================================================
+
+#if OS_WINDOWS
+
+static DWORD WINAPI run_thread( LPVOID data );
+
+void c_init_mutex( struct mutex* mutex ) {
+   InitializeCriticalSection( &mutex->section );
+}
+
+void c_deinit_mutex( struct mutex* mutex ) {
+   DeleteCriticalSection( &mutex->section );
+}
+
+void c_lock( struct mutex* mutex ) {
+   EnterCriticalSection( &mutex->section );
+}
+
+void c_unlock( struct mutex* mutex ) {
+   LeaveCriticalSection( &mutex->section );
+}
+
+void c_init_cond( struct cond_var* cond ) {
+   InitializeConditionVariable( &cond->var );
+}
+
+void c_deinit_cond( struct cond_var* cond ) {}
+
+void c_wait( struct cond_var* cond, struct mutex* mutex ) {
+   SleepConditionVariableCS( &cond->var, &mutex->section, INFINITE );
+}
+
+void c_wake_all( struct cond_var* cond ) {
+   WakeAllConditionVariable( &cond->var );
+}
+
+bool c_start_thread( struct thread* thread, void ( *func )( void* ),
+   void* data ) {
+   thread->func = func;
+   thread->data = data;
+   thread->handle = CreateThread( NULL, 0, run_thread, thread, 0, NULL );
+   return ( thread->handle != NULL );
+}
+
+static DWORD WINAPI run_thread( LPVOID data ) {
+   struct thread* thread = data;
+   thread->func( thread->data );
+   return 0;
+}
+
+void c_join_thread( struct thread* thread ) {
+   WaitForSingleObject( thread->handle, INFINITE );
+   CloseHandle( thread->handle );
+}
+
+#else
+
+static void* run_thread( void* data );
+
+void c_init_mutex( struct mutex* mutex ) {
+   pthread_mutexattr_t attr;
+   pthread_mutexattr_init( &attr );
+   pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+   pthread_mutex_init( &mutex->mutex, &attr );
+   pthread_mutexattr_destroy( &attr );
+}
+
+void c_deinit_mutex( struct mutex* mutex ) {
+   pthread_mutex_destroy( &mutex->mutex );
+}
+
+void c_lock( struct mutex* mutex ) {
+   pthread_mutex_lock( &mutex->mutex );
+}
+
+void c_unlock( struct mutex* mutex ) {
+   pthread_mutex_unlock( &mutex->mutex );
+}
+
+void c_init_cond( struct cond_var* cond ) {
+   pthread_cond_init( &cond->cond, NULL );
+}
+
+void c_deinit_cond( struct cond_var* cond ) {
+   pthread_cond_destroy( &cond->cond );
+}
+
+// The mutex must be held only once by the calling thread.
+void c_wait( struct cond_var* cond, struct mutex* mutex ) {
+   pthread_cond_wait( &cond->cond, &mutex->mutex );
+}
+
+void c_wake_all( struct cond_var* cond ) {
+   pthread_cond_broadcast( &cond->cond );
+}
+
+bool c_start_thread( struct thread* thread, void ( *func )( void* ),
+   void* data ) {
+   thread->func = func;
+   thread->data = data;
+   return ( pthread_create( &thread->thread, NULL, run_thread,
+      thread ) == 0 );
+}
+
+static void* run_thread( void* data ) {
+   struct thread* thread = data;
+   thread->func( thread->data );
+   return NULL;
+}
+
+void c_join_thread( struct thread* thread ) {
+   pthread_join( thread->thread, NULL );
+}
+
 #endif
 
 // Miscellaneous
 // ==========================================================================
 
+// Writes a string to the standard output as a JSON string literal.
+void c_print_json_string( const char* value ) {
+   printf( "\"" );
+   for ( const char* ch = value; *ch; ++ch ) {
+      switch ( *ch ) {
+      case '"':
+      case '\\':
+         printf( "\\%c", *ch );
+         break;
+      default:
+         if ( ( unsigned char ) *ch < ' ' ) {
+            printf( "\\u%04x", *ch );
+         }
+         else {
+            putchar( *ch );
+         }
+         break;
+      }
+   }
+   printf( "\"" );
+}
+
 int alignpad( int size, int align_size ) {
    int i = size % align_size;
    if ( i ) {
@@ -738,6 +1036,29 @@ void fs_get_file_contents( const char* path, struct file_contents* contents ) {
    contents->err = 0;
 }
 
+// FNV-1a hash of a null-terminated string.
+unsigned int c_hash_str( const char* value ) {
+   unsigned int hash = 2166136261u;
+   while ( *value ) {
+      hash ^= ( unsigned char ) *value;
+      hash *= 16777619u;
+      ++value;
+   }
+   return hash;
+}
+
+// Same as c_hash_str(), but letters are hashed as lowercase, so strings that
+// differ only in case have the same hash.
+unsigned int c_hash_str_nocase( const char* value ) {
+   unsigned int hash = 2166136261u;
+   while ( *value ) {
+      hash ^= ( unsigned char ) tolower( *value );
+      hash *= 16777619u;
+      ++value;
+   }
+   return hash;
+}
+
 // stricmp/strcasecmp
 int bcc_stricmp (const char *s1, const char *s2)
 {
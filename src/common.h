@@ -14,12 +14,39 @@
 
 extern const char* c_version;
 
+// Allocations are grouped into arenas, one for each phase of the compiler.
+// The transient arena holds memory needed only while the source files are being
+// read, like tokens and macros, and is released once parsing is done.
+enum mem_arena {
+   MEM_ARENA_GENERAL,
+   MEM_ARENA_PARSE,
+   MEM_ARENA_SEMANTIC,
+   MEM_ARENA_CODEGEN,
+   MEM_ARENA_TRANSIENT,
+   MEM_ARENA_TOTAL
+};
+
+struct mem_arena_stats {
+   size_t allocs;
+   size_t size;
+   size_t peak_size;
+};
+
 void mem_init( void );
 void* mem_alloc( size_t );
+void* mem_arena_alloc( enum mem_arena arena, size_t );
 void* mem_realloc( void*, size_t );
 void* mem_slot_alloc( size_t );
 void mem_free( void* );
 void mem_free_all( void );
+enum mem_arena mem_select_arena( enum mem_arena arena );
+void mem_free_arena( enum mem_arena arena );
+void mem_get_arena_stats( enum mem_arena arena,
+   struct mem_arena_stats* stats );
+size_t mem_get_peak_size( void );
+// While a mutex is set, allocations can be made from several threads.
+struct mutex;
+void mem_set_lock( struct mutex* mutex );
 
 #define ARRAY_SIZE( a ) ( sizeof( a ) / sizeof( a[ 0 ] ) )
 #define STATIC_ASSERT( ... ) \
@@ -107,21 +134,41 @@ void list_deinit( struct list* list );
 
 // --------------------------------------------------------------------------
 
+enum bench_pass {
+   BENCH_NONE,
+   BENCH_LEX,
+   BENCH_PREPROCESS,
+   BENCH_PARSE
+};
+
+enum time_report {
+   TIME_REPORT_NONE,
+   TIME_REPORT_TEXT,
+   TIME_REPORT_JSON
+};
+
 struct options {
    struct list includes;
    struct list defines;
    struct list library_links;
    const char* source_file;
    const char* object_file;
+   const char* output_file;
    int tab_size;
+   int jobs;
    bool acc_err;
    bool acc_stats;
+   bool mem_stats;
+   bool file_stats;
    bool one_column;
    bool help;
    bool preprocess;
+   bool line_markers;
    bool write_asserts;
    bool show_version;
    bool slade_mode;
+   enum bench_pass bench;
+   enum time_report time_report;
    struct {
       const char* dir_path;
       int lifetime;
@@ -132,6 +179,8 @@ struct options {
 };
 
 int bcc_stricmp (const char *s1, const char *s2);
+unsigned int c_hash_str( const char* value );
+unsigned int c_hash_str_nocase( const char* value );
 
 #if OS_WINDOWS
 
@@ -158,10 +207,25 @@ struct fs_timestamp {
    time_t value;
 };
 
+struct mutex {
+   CRITICAL_SECTION section;
+};
+
+struct cond_var {
+   CONDITION_VARIABLE var;
+};
+
+struct thread {
+   HANDLE handle;
+   void ( *func )( void* );
+   void* data;
+};
+
 #else
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 struct fileid {
    dev_t device;
@@ -182,6 +246,20 @@ struct fs_timestamp {
    time_t value;
 };
 
+struct mutex {
+   pthread_mutex_t mutex;
+};
+
+struct cond_var {
+   pthread_cond_t cond;
+};
+
+struct thread {
+   pthread_t thread;
+   void ( *func )( void* );
+   void* data;
+};
+
 #endif
 
 struct file_contents {
@@ -196,6 +274,9 @@ struct fs_result {
 
 bool c_read_fileid( struct fileid*, const char* path );
 bool c_same_fileid( struct fileid*, struct fileid* );
+unsigned int c_hash_fileid( struct fileid* );
+double c_get_wall_time( void );
+void c_print_json_string( const char* value );
 bool c_read_full_path( const char* path, struct str* );
 void c_extract_dirname( struct str* );
 const char* c_get_file_ext( const char* path );
@@ -213,4 +294,17 @@ void fs_strip_trailing_pathsep( struct str* path );
 bool fs_delete_file( const char* path );
 bool c_is_absolute_path( const char* path );
 
+// A mutex can be locked again by the thread that holds it.
+void c_init_mutex( struct mutex* mutex );
+void c_deinit_mutex( struct mutex* mutex );
+void c_lock( struct mutex* mutex );
+void c_unlock( struct mutex* mutex );
+void c_init_cond( struct cond_var* cond );
+void c_deinit_cond( struct cond_var* cond );
+void c_wait( struct cond_var* cond, struct mutex* mutex );
+void c_wake_all( struct cond_var* cond );
+bool c_start_thread( struct thread* thread, void ( *func )( void* ),
+   void* data );
+void c_join_thread( struct thread* thread );
+
 #endif
@@ -10,6 +10,8 @@
 
 #define TAB_SIZE_MIN 1
 #define TAB_SIZE_MAX 100
+#define JOBS_MIN 1
+#define JOBS_MAX 64
 
 static void init_options( struct options* );
 static bool read_options( struct options*, char** );
@@ -27,6 +29,10 @@ static void preprocess( struct task* task );
 static void compile_mainlib( struct task* task, struct cache* cache );
 static void print_acc_stats( struct task* task, struct parse* parse,
    struct codegen* codegen );
+static void print_mem_stats( struct task* task );
+static void print_file_stats( struct task* task );
+static void print_time_report( struct task* task, struct parse* parse,
+   struct semantic* semantic, struct codegen* codegen );
 static const char* get_script_type_label( int type );
 
 int main( int argc, char* argv[] ) {
@@ -66,10 +72,12 @@ int main( int argc, char* argv[] ) {
    }
    // When no object file is explicitly specified, create the object file in
    // the directory of the source file, giving it the name that of the source
-   // file, but with ".o" extension.
+   // file, but with ".o" extension. When preprocessing, the output is written
+   // to the standard output instead. Benchmarks write no output file.
    struct str object_file;
    str_init( &object_file );
-   if ( ! options.object_file ) {
+   if ( ! options.object_file && ! options.preprocess &&
+      options.bench == BENCH_NONE ) {
       str_append( &object_file, options.source_file );
       int i = 0;
       int length = object_file.length;
@@ -84,7 +92,7 @@ int main( int argc, char* argv[] ) {
       options.object_file = object_file.value;
    }
    // Don't overwrite the source file.
-   if ( source_object_files_same( &options ) ) {
+   if ( options.object_file && source_object_files_same( &options ) ) {
       printf( "error: trying to overwrite source file\n" );
       printf( "source file: %s\n", options.source_file );
       printf( "object file: %s\n", options.object_file );
@@ -110,14 +118,21 @@ static void init_options( struct options* options ) {
    list_init( &options->library_links );
    options->source_file = NULL;
    options->object_file = NULL;
+   options->output_file = NULL;
    // Default tab size for now is 4, since it's a common indentation size.
    options->tab_size = 4;
+   options->jobs = 1;
    options->acc_err = false;
    options->acc_stats = false;
+   options->mem_stats = false;
+   options->file_stats = false;
    options->help = false;
    options->preprocess = false;
+   options->line_markers = false;
    options->write_asserts = true;
    options->show_version = false;
+   options->bench = BENCH_NONE;
+   options->time_report = TIME_REPORT_NONE;
    options->cache.dir_path = NULL;
    options->cache.lifetime = -1;
    options->cache.enable = false;
@@ -189,6 +204,24 @@ static bool read_options( struct options* options, char** argv ) {
             return false;
          }
       }
+      else if ( strcmp( option, "j" ) == 0 ) {
+         if ( *args ) {
+            int jobs = atoi( *args );
+            if ( jobs >= JOBS_MIN && jobs <= JOBS_MAX ) {
+               options->jobs = jobs;
+               ++args;
+            }
+            else {
+               printf( "error: number of jobs not between %d and %d\n",
+                  JOBS_MIN, JOBS_MAX );
+               return false;
+            }
+         }
+         else {
+            printf( "error: missing number of jobs\n" );
+            return false;
+         }
+      }
       else if ( strcmp( option, "one-column" ) == 0 ) {
          options->one_column = true;
       }
@@ -200,6 +233,18 @@ static bool read_options( struct options* options, char** argv ) {
       else if ( strcmp( option, "acc-stats" ) == 0 ) {
          options->acc_stats = true;
       }
+      else if ( strcmp( option, "mem-stats" ) == 0 ) {
+         options->mem_stats = true;
+      }
+      else if ( strcmp( option, "file-stats" ) == 0 ) {
+         options->file_stats = true;
+      }
+      else if ( strcmp( option, "time-report" ) == 0 ) {
+         options->time_report = TIME_REPORT_TEXT;
+      }
+      else if ( strcmp( option, "time-report-json" ) == 0 ) {
+         options->time_report = TIME_REPORT_JSON;
+      }
       else if ( strcmp( option, "cache" ) == 0 ) {
          options->cache.enable = true;
       }
@@ -234,6 +279,47 @@ static bool read_options( struct options* options, char** argv ) {
       else if ( strcmp( option, "E" ) == 0 ) {
          options->preprocess = true;
       }
+      else if ( strcmp( option, "line-markers" ) == 0 ) {
+         options->line_markers = true;
+      }
+      else if ( strcmp( option, "o" ) == 0 ) {
+         if ( *args ) {
+            options->output_file = *args;
+            ++args;
+         }
+         else {
+            printf( "error: missing file argument for %s option\n",
+               option );
+            return false;
+         }
+      }
+      else if ( strcmp( option, "bench" ) == 0 ) {
+         if ( *args ) {
+            if ( strcmp( *args, "lex" ) == 0 ) {
+               options->bench = BENCH_LEX;
+            }
+            else if ( strcmp( *args, "preprocess" ) == 0 ) {
+               options->bench = BENCH_PREPROCESS;
+            }
+            else if ( strcmp( *args, "parse" ) == 0 ) {
+               options->bench = BENCH_PARSE;
+            }
+            else {
+               printf( "error: unknown pass for %s option: %s\n", option,
+                  *args );
+               return false;
+            }
+            ++args;
+         }
+         else {
+            printf( "error: missing pass argument for %s option\n",
+               option );
+            return false;
+         }
+      }
+      else if ( strcmp( option, "bench-lexer" ) == 0 ) {
+         options->bench = BENCH_LEX;
+      }
       else if ( strcmp( option, "strip-asserts" ) == 0 ) {
          options->write_asserts = false;
       }
@@ -276,6 +362,14 @@ static bool read_options( struct options* options, char** argv ) {
    if ( *args ) {
       options->object_file = *args;
    }
+   // The -o option overrides the object file. With -E, the output is written
+   // to the standard output unless the -o option is given.
+   if ( options->output_file ) {
+      options->object_file = options->output_file;
+   }
+   else if ( options->preprocess ) {
+      options->object_file = NULL;
+   }
    return true;
 }
 
@@ -306,20 +400,44 @@ static void print_usage( char* path ) {
       "                       created by the acc compiler\n"
       "  -acc-stats           Show compilation statistics like those shown\n"
       "                       by the acc compiler\n"
+      "  -mem-stats           Show the memory used by each compilation\n"
+      "                       phase\n"
+      "  -file-stats          Show the number of file searches, and the\n"
+      "                       file-system queries made and saved\n"
+      "  -time-report         Show the time spent in each compilation phase\n"
+      "                       and its parts, and counts of the work done\n"
+      "  -time-report-json    Same as -time-report, but in JSON\n"
       "  -h                   Show this help information\n"
       "  -i <directory>       Add a directory to search in for files\n"
       "  -I <directory>       Same as -i\n"
       "  -one-column          Start column position at 1. Default is 0\n"
       "  -tab-size <size>     Specify the width of the tab character\n"
+      "  -j <jobs>            Test the function and script bodies on the\n"
+      "                       specified number of threads. Default is 1\n"
       "  -strip-asserts       Do not include asserts in object file\n"
       "                       (asserts will not be executed at run-time)\n"
       "  -E                   Do preprocessing only\n"
+      "  -line-markers        With -E, write #line directives that give the\n"
+      "                       position of the output lines in the source\n"
+      "                       files\n"
+      "  -o <file>            Write the output to the specified file. Same\n"
+      "                       as specifying the object file. With -E, the\n"
+      "                       output is written to the standard output\n"
+      "                       unless this option is given\n"
+      "  -bench <pass>        Only run the specified pass over the source\n"
+      "                       file, and show its speed and memory usage, in\n"
+      "                       JSON. The pass must be one of the following:\n"
+      "                       lex (read the tokens of the source file),\n"
+      "                       preprocess (the -E pass, without the output),\n"
+      "                       parse (parse the source file and its imports)\n"
+      "  -bench-lexer         Same as -bench lex\n"
       "  -D <name>            Create a macro with the specified name. The\n"
       "                       macro will have a value of 1\n"
       "  -l <library>         Creates a link to the specified library\n"
       "  -version             Show version of the compiler\n"
       "Cache options:\n"
-      "  -cache               Enable caching of library files\n"
+      "  -cache               Enable caching of library files, and of the\n"
+      "                       header files #included by the main file\n"
       "  -cache-dir           Store cache-related files in the specified\n"
       "    <directory>        directory\n"
       "                       (If one is not specified, a system-default\n"
@@ -355,7 +473,9 @@ static void perform_task( struct task* task ) {
    if ( task->options->cache.enable ) {
       struct cache cache;
       cache_init( &cache, task );
+      enum timer timer = t_switch_timer( task, TIMER_CACHE );
       cache_load( &cache );
+      t_switch_timer( task, timer );
       perform_selected_task( task, &cache );
       cache_close( &cache );
    }
@@ -371,7 +491,8 @@ static void perform_selected_task( struct task* task, struct cache* cache ) {
    else if ( task->options->cache.clear ) {
       clear_cache( task, cache );
    }
-   else if ( task->options->preprocess ) {
+   else if ( task->options->preprocess ||
+      task->options->bench != BENCH_NONE ) {
       preprocess( task );
    }
    else {
@@ -405,21 +526,43 @@ static void preprocess( struct task* task ) {
    struct parse parse;
    p_init( &parse, task, NULL );
    p_run( &parse );
+   if ( task->options->file_stats ) {
+      print_file_stats( task );
+   }
 }
 
 static void compile_mainlib( struct task* task, struct cache* cache ) {
    struct parse parse;
+   t_switch_timer( task, TIMER_PARSE );
+   mem_select_arena( MEM_ARENA_PARSE );
    p_init( &parse, task, cache );
    p_run( &parse );
+   // The tokens, macros, and source buffers are no longer needed.
+   mem_free_arena( MEM_ARENA_TRANSIENT );
    struct semantic semantic;
+   t_switch_timer( task, TIMER_SEMANTIC );
+   mem_select_arena( MEM_ARENA_SEMANTIC );
    s_init( &semantic, task );
    s_test( &semantic );
    struct codegen codegen;
+   t_switch_timer( task, TIMER_CODEGEN );
+   mem_select_arena( MEM_ARENA_CODEGEN );
    c_init( &codegen, task );
    c_publish( &codegen );
+   t_switch_timer( task, TIMER_NONE );
+   mem_select_arena( MEM_ARENA_GENERAL );
    if ( task->options->acc_stats ) {
       print_acc_stats( task, &parse, &codegen );
    }
+   if ( task->options->mem_stats ) {
+      print_mem_stats( task );
+   }
+   if ( task->options->file_stats ) {
+      print_file_stats( task );
+   }
+   if ( task->options->time_report != TIME_REPORT_NONE ) {
+      print_time_report( task, &parse, &semantic, &codegen );
+   }
 }
 
 static void print_acc_stats( struct task* task, struct parse* parse,
@@ -523,6 +666,182 @@ static void print_acc_stats( struct task* task, struct parse* parse,
       codegen->object_size );
 }
 
+static void print_mem_stats( struct task* task ) {
+   static const struct {
+      const char* name;
+      enum mem_arena arena;
+   } table[] = {
+      { "general", MEM_ARENA_GENERAL },
+      { "parse", MEM_ARENA_PARSE },
+      { "parse (transient)", MEM_ARENA_TRANSIENT },
+      { "semantic", MEM_ARENA_SEMANTIC },
+      { "codegen", MEM_ARENA_CODEGEN },
+   };
+   STATIC_ASSERT( ARRAY_SIZE( table ) == MEM_ARENA_TOTAL );
+   t_diag( task, DIAG_NONE, "memory usage:" );
+   for ( int i = 0; i < ARRAY_SIZE( table ); ++i ) {
+      struct mem_arena_stats stats;
+      mem_get_arena_stats( table[ i ].arena, &stats );
+      t_diag( task, DIAG_NONE,
+         "  %s: %zu allocation%s, peak of %zu bytes",
+         table[ i ].name,
+         stats.allocs,
+         stats.allocs == 1 ? "" : "s",
+         stats.peak_size );
+   }
+   t_diag( task, DIAG_NONE, "  total: peak of %zu bytes",
+      mem_get_peak_size() );
+}
+
+static void print_file_stats( struct task* task ) {
+   t_diag( task, DIAG_NONE,
+      "file searches: %d (%d repeated)\n"
+      "file-system queries: %d (%d saved by reusing search results)",
+      task->file_stats.searches,
+      task->file_stats.cached_searches,
+      task->file_stats.queries,
+      task->file_stats.saved_queries );
+}
+
+// Each phase is followed by its parts. The time of a phase is the sum of the
+// times of its parts, and the time spent in the phase outside of its parts is
+// shown as the last part.
+static void print_time_report( struct task* task, struct parse* parse,
+   struct semantic* semantic, struct codegen* codegen ) {
+   static const struct {
+      const char* name;
+      enum timer timer;
+      bool phase;
+   } table[] = {
+      { "parse", TIMER_PARSE, true },
+      { "lexing", TIMER_LEX, false },
+      { "preprocessing", TIMER_PREPROCESS, false },
+      { "import loading", TIMER_IMPORT, false },
+      { "cache restore", TIMER_CACHE, false },
+      { "semantic", TIMER_SEMANTIC, true },
+      { "name binding", TIMER_BIND_NAMES, false },
+      { "object testing", TIMER_TEST_OBJECTS, false },
+      { "body testing", TIMER_TEST_BODIES, false },
+      { "codegen", TIMER_CODEGEN, true },
+      { "code generation", TIMER_WRITE_CODE, false },
+      { "pcode flush", TIMER_FLUSH_PCODE, false },
+      { "chunk writing", TIMER_WRITE_CHUNKS, false },
+   };
+   STATIC_ASSERT( ARRAY_SIZE( table ) == TIMER_TOTAL - 1 );
+   bool json = ( task->options->time_report == TIME_REPORT_JSON );
+   double total_wall = 0.0;
+   double total_cpu = 0.0;
+   for ( int i = 0; i < ARRAY_SIZE( table ); ++i ) {
+      total_wall += task->timers.wall[ table[ i ].timer ];
+      total_cpu += task->timers.cpu[ table[ i ].timer ];
+   }
+   if ( json ) {
+      printf( "{\"file\": " );
+      c_print_json_string( task->options->source_file );
+      printf( ", \"wall\": %.6f, \"cpu\": %.6f, \"phases\": [", total_wall,
+         total_cpu );
+   }
+   else {
+      t_diag( task, DIAG_NONE, "%-30s%10s%10s", "time report:", "wall (s)",
+         "cpu (s)" );
+   }
+   for ( int i = 0; i < ARRAY_SIZE( table ); ++i ) {
+      if ( ! table[ i ].phase ) {
+         continue;
+      }
+      int end = i + 1;
+      while ( end < ARRAY_SIZE( table ) && ! table[ end ].phase ) {
+         ++end;
+      }
+      double wall = 0.0;
+      double cpu = 0.0;
+      for ( int k = i; k < end; ++k ) {
+         wall += task->timers.wall[ table[ k ].timer ];
+         cpu += task->timers.cpu[ table[ k ].timer ];
+      }
+      if ( json ) {
+         printf( "%s{\"name\": \"%s\", \"wall\": %.6f, \"cpu\": %.6f, "
+            "\"parts\": [", i > 0 ? ", " : "", table[ i ].name, wall, cpu );
+      }
+      else {
+         t_diag( task, DIAG_NONE, "  %-28s%10.4f%10.4f", table[ i ].name,
+            wall, cpu );
+      }
+      for ( int k = i + 1; k <= end; ++k ) {
+         const char* name = ( k < end ) ? table[ k ].name : "other";
+         enum timer timer = ( k < end ) ? table[ k ].timer : table[ i ].timer;
+         wall = task->timers.wall[ timer ];
+         cpu = task->timers.cpu[ timer ];
+         // The CPU time of lexing and preprocessing is not measured.
+         bool cpu_measured = ( timer != TIMER_LEX &&
+            timer != TIMER_PREPROCESS );
+         if ( json ) {
+            printf( "%s{\"name\": \"%s\", \"wall\": %.6f", k > i + 1 ?
+               ", " : "", name, wall );
+            if ( cpu_measured ) {
+               printf( ", \"cpu\": %.6f", cpu );
+            }
+            printf( "}" );
+         }
+         else if ( cpu_measured ) {
+            t_diag( task, DIAG_NONE, "    %-26s%10.4f%10.4f", name, wall,
+               cpu );
+         }
+         else {
+            t_diag( task, DIAG_NONE, "    %-26s%10.4f%10s", name, wall,
+               "-" );
+         }
+      }
+      if ( json ) {
+         printf( "]}" );
+      }
+   }
+   if ( json ) {
+      printf( "], \"counters\": {" );
+      printf( "\"tokens\": %lld", parse->stats.tokens );
+      printf( ", \"macro_expansions\": %d", parse->stats.macro_expansions );
+      printf( ", \"interned_strings\": %d", task->str_table.size );
+      printf( ", \"object_tests\": %d", semantic->stats.object_tests );
+      printf( ", \"object_test_iterations\": %d",
+         semantic->stats.test_iterations );
+      printf( ", \"name_lookups\": %d", semantic->stats.name_lookups );
+      printf( ", \"name_cache_hits\": %d",
+         semantic->stats.name_cache_hits );
+      printf( ", \"name_cache_misses\": %d",
+         semantic->stats.name_cache_misses );
+      printf( ", \"type_nodes\": %d", semantic->type_table->size );
+      printf( ", \"pcode_nodes_written\": %d",
+         codegen->stats.written_nodes );
+      printf( "}}\n" );
+   }
+   else {
+      t_diag( task, DIAG_NONE,
+         "  %-28s%10.4f%10.4f\n"
+         "  (the CPU time of lexing and preprocessing is counted in the part\n"
+         "  that reads the tokens)\n"
+         "counters:\n"
+         "  tokens: %lld\n"
+         "  macro expansions: %d\n"
+         "  interned strings: %d\n"
+         "  objects tested: %d (in %d iteration%s)\n"
+         "  name lookups: %d (%d found in the name cache, %d not)\n"
+         "  type nodes: %d\n"
+         "  pcode nodes written: %d",
+         "total", total_wall, total_cpu,
+         parse->stats.tokens,
+         parse->stats.macro_expansions,
+         task->str_table.size,
+         semantic->stats.object_tests,
+         semantic->stats.test_iterations,
+         semantic->stats.test_iterations == 1 ? "" : "s",
+         semantic->stats.name_lookups,
+         semantic->stats.name_cache_hits,
+         semantic->stats.name_cache_misses,
+         semantic->type_table->size,
+         codegen->stats.written_nodes );
+   }
+}
+
 static const char* get_script_type_label( int type ) {
    STATIC_ASSERT( SCRIPT_TYPE_NEXTFREENUMBER == SCRIPT_TYPE_REOPEN + 1 );
    switch ( type ) {
@@ -934,6 +934,7 @@ static void init_ref( struct ref* ref, int type, struct pos* pos ) {
    ref->next = NULL;
    ref->type = type;
    ref->pos = *pos;
+   ref->type_node = NULL;
    ref->nullable = false;
    ref->implicit = false;
 }
@@ -0,0 +1,421 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "phase.h"
+#include "../cache/cache.h"
+
+// A header #included by the main file is read the same way each time it is
+// #included with the same set of macros defined on the command line. So the
+// first time the header is read, the tokens the header passes to the parser and
+// the macros it leaves defined are recorded and saved in the cache. The next
+// time the header is #included, the macros are defined again and the tokens are
+// given to the parser, and the header is not lexed or preprocessed.
+//
+// The positions of the tokens refer to the include-history entries created
+// while the header was read. When the header is restored, these entries are
+// created again, so the diagnostics point to the same places.
+struct header_recording {
+   struct source_entry* entry;
+   // The include-history entry of the file that #included the header.
+   struct include_history_entry* includer;
+   struct ifdirc* ifdirc;
+   struct header_token_list tokens;
+   int first_entry_id;
+   int included_lines;
+   bool raw_define;
+   bool raw_include;
+   bool spoiled;
+};
+
+static void append_defines( struct parse* parse, struct str* defines );
+static int compare_names( const void* lside, const void* rside );
+static bool find_files( struct parse* parse, struct header_snapshot* snapshot,
+   struct file_entry* header_file, struct file_entry** files );
+static struct file_entry* find_file( struct parse* parse,
+   struct header_file* file );
+static void restore_files( struct parse* parse,
+   struct header_snapshot* snapshot, struct file_entry** files, int line,
+   struct include_history_entry** entries );
+static void restore_macros( struct parse* parse,
+   struct header_snapshot* snapshot, struct include_history_entry** entries );
+static void restore_token( struct parse* parse, struct header_token* entry,
+   struct include_history_entry** entries, struct token* token );
+static struct header_snapshot* create_snapshot( struct parse* parse,
+   struct header_recording* recording );
+static bool record_files( struct parse* parse,
+   struct header_recording* recording, struct header_snapshot* snapshot );
+static bool record_macros( struct parse* parse,
+   struct header_recording* recording, struct header_snapshot* snapshot );
+static bool record_token( struct parse* parse,
+   struct header_recording* recording, struct token* token,
+   struct header_token* entry );
+static bool record_pos( struct header_recording* recording,
+   struct pos* pos );
+
+// Only a header #included by the main file, outside of the #if directives, is
+// snapshotted, and only when the macros defined so far are those of the
+// command line. The tokens of a nested header are part of the snapshot of the
+// outer header.
+bool p_can_snapshot_header( struct parse* parse ) {
+   return ( parse->cache && ! parse->header_recording &&
+      parse->source_entry->main && ! parse->lib->imported &&
+      ! parse->ifdirc && ! parse->macro_expan &&
+      ! parse->preproc_pragmas.raw_define &&
+      ! parse->preproc_pragmas.raw_include &&
+      parse->parser_tkque.size == 0 && p_only_cmdline_macros( parse ) );
+}
+
+// The macros defined on the command line, sorted, and without duplicates.
+static void append_defines( struct parse* parse, struct str* defines ) {
+   str_copy( defines, "", 0 );
+   struct list* list = &parse->task->options->defines;
+   int count = list_size( list );
+   if ( count == 0 ) {
+      return;
+   }
+   const char** names = mem_alloc( sizeof( *names ) * count );
+   struct list_iter i;
+   list_iterate( list, &i );
+   for ( int k = 0; k < count; ++k ) {
+      names[ k ] = list_data( &i );
+      list_next( &i );
+   }
+   qsort( names, count, sizeof( *names ), compare_names );
+   for ( int k = 0; k < count; ++k ) {
+      if ( k == 0 || strcmp( names[ k ], names[ k - 1 ] ) != 0 ) {
+         if ( defines->length > 0 ) {
+            str_append( defines, " " );
+         }
+         str_append( defines, names[ k ] );
+      }
+   }
+   mem_free( names );
+}
+
+static int compare_names( const void* lside, const void* rside ) {
+   return strcmp( *( const char* const* ) lside,
+      *( const char* const* ) rside );
+}
+
+bool p_restore_header( struct parse* parse, struct file_entry* file,
+   int line ) {
+   struct str defines;
+   str_init( &defines );
+   append_defines( parse, &defines );
+   enum timer timer = t_switch_timer( parse->task, TIMER_CACHE );
+   struct header_snapshot* snapshot = cache_get_header( parse->cache, file,
+      defines.value );
+   t_switch_timer( parse->task, timer );
+   str_deinit( &defines );
+   if ( ! snapshot ) {
+      return false;
+   }
+   int count = list_size( &snapshot->files );
+   struct file_entry** files = mem_alloc( sizeof( *files ) * count );
+   struct include_history_entry** entries =
+      mem_alloc( sizeof( *entries ) * count );
+   bool restored = find_files( parse, snapshot, file, files );
+   if ( restored ) {
+      restore_files( parse, snapshot, files, line, entries );
+      restore_macros( parse, snapshot, entries );
+      for ( int i = 0; i < snapshot->tokens.size; ++i ) {
+         restore_token( parse, &snapshot->tokens.entries[ i ], entries,
+            p_push_token( parse, &parse->parser_tkque ) );
+      }
+      parse->included_lines += snapshot->included_lines;
+   }
+   mem_free( entries );
+   mem_free( files );
+   return restored;
+}
+
+static bool find_files( struct parse* parse, struct header_snapshot* snapshot,
+   struct file_entry* header_file, struct file_entry** files ) {
+   int index = 0;
+   struct list_iter i;
+   list_iterate( &snapshot->files, &i );
+   while ( ! list_end( &i ) ) {
+      struct header_file* file = list_data( &i );
+      files[ index ] = NULL;
+      if ( index == 0 ) {
+         files[ index ] = header_file;
+      }
+      else if ( file->path ) {
+         files[ index ] = find_file( parse, file );
+         if ( ! files[ index ] ) {
+            return false;
+         }
+      }
+      ++index;
+      list_next( &i );
+   }
+   return true;
+}
+
+// The file is looked for at the path it was found at, so the diagnostics show
+// the same path. When the current directory is not the same, that path can
+// lead to another file, and the full path is used instead.
+static struct file_entry* find_file( struct parse* parse,
+   struct header_file* file ) {
+   struct file_query query;
+   t_init_file_query( &query, NULL, file->path );
+   t_find_file( parse->task, &query );
+   if ( query.success &&
+      strcmp( query.file->full_path.value, file->full_path ) == 0 ) {
+      return query.file;
+   }
+   t_init_file_query( &query, NULL, file->full_path );
+   t_find_file( parse->task, &query );
+   return query.success ? query.file : NULL;
+}
+
+static void restore_files( struct parse* parse,
+   struct header_snapshot* snapshot, struct file_entry** files, int line,
+   struct include_history_entry** entries ) {
+   int index = 0;
+   struct list_iter i;
+   list_iterate( &snapshot->files, &i );
+   while ( ! list_end( &i ) ) {
+      struct header_file* file = list_data( &i );
+      struct include_history_entry* entry =
+         t_alloc_include_history_entry( parse->task );
+      if ( file->parent >= 0 ) {
+         entry->parent = entries[ file->parent ];
+         entry->line = file->line;
+      }
+      else {
+         entry->parent = parse->include_history_entry;
+         entry->line = line;
+      }
+      entry->altern_name = file->altern_name;
+      if ( files[ index ] ) {
+         entry->file_entry_id = files[ index ]->id;
+         if ( file->guard ) {
+            files[ index ]->guard = file->guard;
+            files[ index ]->lines = file->lines;
+         }
+         p_append_file( parse->lib, files[ index ] );
+      }
+      entries[ index ] = entry;
+      ++index;
+      list_next( &i );
+   }
+}
+
+static void restore_macros( struct parse* parse,
+   struct header_snapshot* snapshot, struct include_history_entry** entries ) {
+   p_remove_user_macros( parse );
+   struct list_iter i;
+   list_iterate( &snapshot->macros, &i );
+   while ( ! list_end( &i ) ) {
+      struct header_macro* header_macro = list_data( &i );
+      struct macro* macro = p_define_macro( parse, header_macro->name );
+      macro->pos = header_macro->pos;
+      if ( macro->pos.id >= INTERNALFILE_TOTAL ) {
+         macro->pos.id = entries[ macro->pos.id - INTERNALFILE_TOTAL ]->id;
+      }
+      macro->func_like = header_macro->func_like;
+      macro->variadic = header_macro->variadic;
+      struct list_iter k;
+      list_iterate( &header_macro->params, &k );
+      while ( ! list_end( &k ) ) {
+         p_append_macro_param( parse, macro, list_data( &k ) );
+         list_next( &k );
+      }
+      for ( int k = 0; k < header_macro->body.size; ++k ) {
+         struct token* token = p_alloc_token( parse );
+         restore_token( parse, &header_macro->body.entries[ k ], entries,
+            token );
+         p_append_macro_token( macro, token );
+      }
+      list_next( &i );
+   }
+}
+
+static void restore_token( struct parse* parse, struct header_token* entry,
+   struct include_history_entry** entries, struct token* token ) {
+   struct pos pos = entry->pos;
+   if ( pos.id >= INTERNALFILE_TOTAL ) {
+      pos.id = entries[ pos.id - INTERNALFILE_TOTAL ]->id;
+   }
+   token->next = NULL;
+   token->text = entry->shared_text ?
+      parse->token_texts[ entry->type ] : entry->text;
+   token->length = entry->length;
+   token->pos = p_pack_pos( &pos );
+   token->type = entry->type;
+}
+
+// Called once the include-history entry of the header is created.
+void p_record_header( struct parse* parse ) {
+   struct header_recording* recording = mem_alloc( sizeof( *recording ) );
+   recording->entry = parse->source_entry;
+   recording->includer = parse->include_history_entry->parent;
+   recording->ifdirc = parse->ifdirc;
+   recording->tokens.entries = NULL;
+   recording->tokens.size = 0;
+   recording->tokens.capacity = 0;
+   recording->first_entry_id = parse->include_history_entry->id;
+   recording->included_lines = parse->included_lines;
+   recording->raw_define = parse->preproc_pragmas.raw_define;
+   recording->raw_include = parse->preproc_pragmas.raw_include;
+   recording->spoiled = false;
+   parse->header_recording = recording;
+}
+
+void p_record_header_token( struct parse* parse, struct token* token ) {
+   struct header_recording* recording = parse->header_recording;
+   if ( ! recording->spoiled && ! record_token( parse, recording, token,
+      cache_append_header_token( &recording->tokens ) ) ) {
+      recording->spoiled = true;
+   }
+}
+
+// The header cannot be snapshotted when reading it has an effect that
+// replaying its tokens does not have.
+void p_spoil_header( struct parse* parse ) {
+   if ( parse->header_recording ) {
+      parse->header_recording->spoiled = true;
+   }
+}
+
+// Called when a source is popped. Once the header itself is popped, its
+// snapshot is added to the cache.
+void p_finish_header( struct parse* parse, struct source_entry* entry ) {
+   struct header_recording* recording = parse->header_recording;
+   if ( entry != recording->entry ) {
+      return;
+   }
+   if ( ! recording->spoiled && parse->ifdirc == recording->ifdirc &&
+      parse->preproc_pragmas.raw_define == recording->raw_define &&
+      parse->preproc_pragmas.raw_include == recording->raw_include ) {
+      struct header_snapshot* snapshot = create_snapshot( parse, recording );
+      if ( snapshot ) {
+         struct str defines;
+         str_init( &defines );
+         append_defines( parse, &defines );
+         struct file_entry* file = t_decode_file_entry( parse->task,
+            t_decode_include_history_entry( parse->task,
+               recording->first_entry_id )->file_entry_id );
+         enum timer timer = t_switch_timer( parse->task, TIMER_CACHE );
+         cache_add_header( parse->cache, file, defines.value, snapshot );
+         t_switch_timer( parse->task, timer );
+         str_deinit( &defines );
+      }
+   }
+   if ( recording->tokens.entries && recording->spoiled ) {
+      mem_free( recording->tokens.entries );
+   }
+   mem_free( recording );
+   parse->header_recording = NULL;
+}
+
+static struct header_snapshot* create_snapshot( struct parse* parse,
+   struct header_recording* recording ) {
+   struct header_snapshot* snapshot = cache_alloc_header_snapshot();
+   if ( ! ( record_files( parse, recording, snapshot ) &&
+      record_macros( parse, recording, snapshot ) ) ) {
+      recording->spoiled = true;
+      return NULL;
+   }
+   snapshot->tokens = recording->tokens;
+   snapshot->included_lines = parse->included_lines -
+      recording->included_lines;
+   return snapshot;
+}
+
+static bool record_files( struct parse* parse,
+   struct header_recording* recording, struct header_snapshot* snapshot ) {
+   int count = list_size( &parse->task->include_history );
+   for ( int id = recording->first_entry_id; id < count; ++id ) {
+      struct include_history_entry* entry =
+         t_decode_include_history_entry( parse->task, id );
+      struct header_file* file = cache_alloc_header_file();
+      if ( entry->parent == recording->includer ) {
+         file->parent = -1;
+      }
+      else if ( entry->parent &&
+         entry->parent->id >= recording->first_entry_id ) {
+         file->parent = entry->parent->id - recording->first_entry_id;
+      }
+      else {
+         return false;
+      }
+      file->line = entry->line;
+      file->altern_name = entry->altern_name;
+      if ( ! entry->altern_name ) {
+         struct file_entry* file_entry = t_decode_file_entry( parse->task,
+            entry->file_entry_id );
+         if ( ! file_entry ) {
+            return false;
+         }
+         file->path = file_entry->path.value;
+         file->full_path = file_entry->full_path.value;
+         file->guard = file_entry->guard;
+         file->lines = file_entry->lines;
+      }
+      list_append( &snapshot->files, file );
+   }
+   return true;
+}
+
+static bool record_macros( struct parse* parse,
+   struct header_recording* recording, struct header_snapshot* snapshot ) {
+   struct macro_table* table = &parse->macro_table;
+   for ( int i = 0; i < table->capacity; ++i ) {
+      struct macro* macro = table->buckets[ i ];
+      while ( macro ) {
+         if ( macro->predef == PREDEFMACRO_NONE ) {
+            struct header_macro* header_macro = cache_alloc_header_macro();
+            header_macro->name = macro->name;
+            header_macro->pos = macro->pos;
+            header_macro->func_like = macro->func_like;
+            header_macro->variadic = macro->variadic;
+            if ( ! record_pos( recording, &header_macro->pos ) ) {
+               return false;
+            }
+            struct macro_param* param = macro->param_head;
+            while ( param ) {
+               list_append( &header_macro->params, ( void* ) param->name );
+               param = param->next;
+            }
+            struct token* token = macro->body;
+            while ( token ) {
+               if ( ! record_token( parse, recording, token,
+                  cache_append_header_token( &header_macro->body ) ) ) {
+                  return false;
+               }
+               token = token->next;
+            }
+            list_append( &snapshot->macros, header_macro );
+         }
+         macro = macro->next;
+      }
+   }
+   return true;
+}
+
+static bool record_token( struct parse* parse,
+   struct header_recording* recording, struct token* token,
+   struct header_token* entry ) {
+   entry->type = token->type;
+   entry->length = token->length;
+   entry->shared_text = ( token->type < TK_TOTAL &&
+      token->text == parse->token_texts[ token->type ] );
+   entry->text = entry->shared_text ? 0 : token->text;
+   entry->pos = p_unpack_pos( token->pos );
+   return record_pos( recording, &entry->pos );
+}
+
+// The ID of a position is kept when it is an internal file. Otherwise, it must
+// be an include-history entry created while the header was read.
+static bool record_pos( struct header_recording* recording,
+   struct pos* pos ) {
+   if ( pos->id >= INTERNALFILE_TOTAL ) {
+      if ( pos->id < recording->first_entry_id ) {
+         return false;
+      }
+      pos->id = pos->id - recording->first_entry_id + INTERNALFILE_TOTAL;
+   }
+   return true;
+}
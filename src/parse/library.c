@@ -622,6 +622,9 @@ static void read_include( struct parse* parse ) {
    }
    else {
       p_test_tk( parse, TK_LIT_STRING );
+      // The header being recorded would #include the file a second time when
+      // its tokens are replayed.
+      p_spoil_header( parse );
       p_load_included_source( parse, parse->tk_text, &parse->tk_pos );
       p_read_tk( parse );
    }
@@ -900,8 +903,10 @@ static void load_imported_lib_from_storage( struct parse* parse,
    // Try loading the library from the cache.
    bool cached = false;
    if ( parse->cache ) {
+      enum timer timer = t_switch_timer( parse->task, TIMER_CACHE );
       lib = cache_get( parse->cache, request->file );
       cached = ( lib != NULL );
+      t_switch_timer( parse->task, timer );
    }
    if ( ! cached ) {
       lib = t_add_library( parse->task );
@@ -911,10 +916,12 @@ static void load_imported_lib_from_storage( struct parse* parse,
    list_append( &parse->task->libraries, lib );
    // Read library from source file.
    if ( ! cached ) {
+      enum timer timer = t_switch_timer( parse->task, TIMER_IMPORT );
       read_imported_lib( parse, request, lib );
       if ( parse->cache ) {
          cache_add( parse->cache, lib );
       }
+      t_switch_timer( parse->task, timer );
    }
    request->lib = lib;
 }
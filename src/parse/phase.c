@@ -1,9 +1,13 @@
 #include <string.h>
+#include <time.h>
 
 #include "phase.h"
 #include "../cache/cache.h"
 
 static void run_phase( struct parse* parse );
+static void run_bench( struct parse* parse );
+static void print_bench_report( struct parse* parse, int passes,
+   double seconds );
 
 void p_init( struct parse* parse, struct task* task, struct cache* cache ) {
    parse->task = task;
@@ -18,7 +22,9 @@ void p_init( struct parse* parse, struct task* task, struct cache* cache ) {
    str_init( &parse->token_presentation );
    parse->read_flags = READF_CONCATSTRINGS | READF_ESCAPESEQ;
    parse->concat_strings = false;
-   parse->macro_head = NULL;
+   parse->macro_table.buckets = NULL;
+   parse->macro_table.capacity = 0;
+   parse->macro_table.size = 0;
    parse->macro_free = NULL;
    parse->macro_param_free = NULL;
    parse->macro_expan = NULL;
@@ -33,7 +39,9 @@ void p_init( struct parse* parse, struct task* task, struct cache* cache ) {
    parse->line = 0;
    parse->column = 0;
    parse->cache = cache;
+   parse->header_recording = NULL;
    parse->create_nltk = false;
+   p_intern_token_texts( parse );
    p_init_stream( parse );
    parse->ns = NULL;
    parse->ns_fragment = NULL;
@@ -49,6 +57,9 @@ void p_init( struct parse* parse, struct task* task, struct cache* cache ) {
    t_init_pos_id( &parse->wadauthor.pos, INTERNALFILE_COMPILER );
    parse->wadauthor.specified = false;
    parse->wadauthor.enabled = false;
+   parse->stats.tokens = 0;
+   parse->stats.bytes = 0;
+   parse->stats.macro_expansions = 0;
 }
 
 void p_run( struct parse* parse ) {
@@ -82,13 +93,77 @@ static void run_phase( struct parse* parse ) {
    if ( parse->task->options->preprocess ) {
       p_preprocess( parse );
    }
+   else if ( parse->task->options->bench != BENCH_NONE ) {
+      run_bench( parse );
+   }
    else {
       p_read_tk( parse );
       p_read_target_lib( parse );
    }
 }
 
+// Runs a single pass over the source, measuring its speed. The time spent
+// loading the main source file is not included.
+static void run_bench( struct parse* parse ) {
+   int passes = 1;
+   clock_t start = clock();
+   switch ( parse->task->options->bench ) {
+   case BENCH_LEX:
+      passes = p_bench_lexer( parse );
+      break;
+   case BENCH_PREPROCESS:
+      // Same as the -E pass, except that no output is written.
+      parse->read_flags = READF_NL | READF_SPACETAB;
+      do {
+         p_read_eoptiontk( parse );
+      } while ( parse->token->type != TK_END );
+      p_confirm_ifdircs_closed( parse );
+      break;
+   default:
+      p_read_tk( parse );
+      p_read_target_lib( parse );
+      break;
+   }
+   double seconds = ( double ) ( clock() - start ) / CLOCKS_PER_SEC;
+   print_bench_report( parse, passes, seconds );
+}
+
+// The report is a single JSON object, written on one line, so the reports of
+// many runs can be collected and compared by a script.
+static void print_bench_report( struct parse* parse, int passes,
+   double seconds ) {
+   static const char* names[] = { "", "lex", "preprocess", "parse" };
+   STATIC_ASSERT( ARRAY_SIZE( names ) == BENCH_PARSE + 1 );
+   size_t allocs = 0;
+   for ( int i = 0; i < MEM_ARENA_TOTAL; ++i ) {
+      struct mem_arena_stats stats;
+      mem_get_arena_stats( i, &stats );
+      allocs += stats.allocs;
+   }
+   double tokens = ( double ) parse->stats.tokens;
+   double bytes = ( double ) parse->stats.bytes;
+   printf( "{\"file\": " );
+   c_print_json_string( parse->task->options->source_file );
+   printf( ", \"pass\": \"%s\"", names[ parse->task->options->bench ] );
+   printf( ", \"passes\": %d", passes );
+   printf( ", \"tokens\": %lld", parse->stats.tokens );
+   printf( ", \"bytes\": %lld", parse->stats.bytes );
+   printf( ", \"seconds\": %.6f", seconds );
+   printf( ", \"tokens_per_second\": %.0f", ( seconds > 0 ) ?
+      tokens / seconds : 0.0 );
+   printf( ", \"mb_per_second\": %.3f", ( seconds > 0 ) ?
+      bytes / seconds / ( 1024 * 1024 ) : 0.0 );
+   printf( ", \"allocations\": %zu", allocs );
+   printf( ", \"peak_memory\": %zu", mem_get_peak_size() );
+   printf( "}\n" );
+}
+
 void p_diag( struct parse* parse, int flags, ... ) {
+   // A warning would not be shown again when the header being recorded is
+   // restored.
+   if ( flags & DIAG_WARN ) {
+      p_spoil_header( parse );
+   }
    va_list args;
    va_start( args, flags );
    t_diag_args( parse->task, flags, &args );
@@ -1,9 +1,12 @@
 #ifndef SRC_PARSE_PHASE_H
 #define SRC_PARSE_PHASE_H
 
+#include <stdint.h>
+
 #include "../task.h"
 
 struct cache;
+struct header_recording;
 
 // Token types.
 enum tk {
@@ -191,17 +194,28 @@ enum tk {
    TK_MACRONAME,
 };
 
+// A token is kept small, so more of the tokens in the lookahead share a cache
+// line: the text is the offset of the interned text (see p_token_text()), the
+// position is packed (see p_pack_pos()), and the type takes a byte.
 struct token {
    struct token* next;
    // The text contains the character content of the token. The text and the
    // length of the text are applicable only to a token that is an identifier,
-   // a string, a character literal, or any of the numbers. For the rest, the
-   // text will be NULL and the length will be zero.
-   char* modifiable_text;
-   const char* text;
-   struct pos pos;
-   enum tk type;
+   // a string, a character literal, or any of the numbers. For the other
+   // tokens, the text is the shared text of the token type, or empty.
+   unsigned int text;
    int length;
+   uint64_t pos;
+   unsigned char type;
+};
+
+// The ID of the include-history entry takes the upper 24 bits of a packed
+// position, the line the next 24 bits, and the column the lower 16 bits. A
+// value too large for its bits is clamped.
+enum {
+   POS_ID_BITS = 24,
+   POS_LINE_BITS = 24,
+   POS_COLUMN_BITS = 16
 };
 
 enum {
@@ -229,8 +243,13 @@ struct macro {
    struct macro_param* param_tail;
    struct token* body;
    struct token* body_tail;
+   // The expansion of an object-like macro. It is created when the macro is
+   // first used, and then shared by the later uses of the macro.
+   struct token* expansion;
+   struct token* expansion_tail;
    struct pos pos;
    int param_count;
+   unsigned int hash;
    enum {
       PREDEFMACRO_NONE,
       PREDEFMACRO_LINE,
@@ -242,6 +261,16 @@ struct macro {
    } predef;
    bool func_like;
    bool variadic;
+   bool expanded;
+};
+
+// Macros are stored in a hash table, with the colliding macros chained
+// together through the `next` member. The table is kept at most half full, so
+// looking up an identifier that is not a macro usually finds an empty bucket.
+struct macro_table {
+   struct macro** buckets;
+   int capacity;
+   int size;
 };
 
 struct macro_param {
@@ -249,31 +278,33 @@ struct macro_param {
    struct macro_param* next;
 };
 
-struct queue_entry {
-   struct queue_entry* next;
-   struct token* token;
-   bool token_allocated;
-};
+enum { TOKEN_SLAB_SIZE = 256 };
 
+// The tokens of the queue are kept in a ring buffer, whose capacity is a power
+// of two. The token last shifted out of the queue is freed on the next shift.
 struct token_queue {
-   struct queue_entry* head;
-   struct queue_entry* tail;
-   struct queue_entry* prev_entry;
+   struct token** tokens;
+   struct token* prev_token;
+   int capacity;
+   int head;
    int size;
    bool stream;
 };
 
 struct parsertk_iter {
-   struct queue_entry* entry;
    struct token* token;
+   int index;
 };
 
 struct streamtk_iter {
-   struct queue_entry* entry;
    struct token* token;
+   int index;
 };
 
-enum { SOURCE_BUFFER_SIZE = 16384 };
+enum {
+   SOURCE_BUFFER_SIZE = 16384,
+   SOURCE_LOOKAHEAD = 3
+};
 
 struct source {
    struct file_entry* file;
@@ -282,11 +313,19 @@ struct source {
    int file_entry_id;
    int line;
    int column;
+   // Number of tokens read, not counting whitespace.
+   int tokens;
    bool load_once;
    char ch;
+   // When the whole file is read into memory, `contents` holds the file and
+   // `end` points to the null character at the end of the file. Otherwise, the
+   // file is read in chunks into `buffer`, and `end` marks the position where
+   // the buffer needs to be refilled.
+   char* contents;
+   char* pos;
+   char* end;
    // Plus one for the null character.
    char buffer[ SOURCE_BUFFER_SIZE + 2 ];
-   int buffer_pos;
 };
 
 struct source_entry {
@@ -294,6 +333,19 @@ struct source_entry {
    struct source* source;
    struct macro_expan* macro_expan;
    struct token_queue peeked;
+   // Detection of the include guard idiom: the file starts with an #ifndef
+   // directive, and the matching #endif directive ends the file.
+   struct {
+      const char* name;
+      struct pos pos;
+      int tokens;
+      enum {
+         GUARD_UNKNOWN,
+         GUARD_OPEN,
+         GUARD_CLOSED,
+         GUARD_NONE
+      } state;
+   } guard;
    enum tk prev_tk;
    bool main;
    bool imported;
@@ -388,9 +440,16 @@ struct parse {
    struct task* task;
    struct token* token;
    struct token* token_free;
+   // Tokens are allocated from slabs.
+   struct token* token_slab;
+   int token_slab_left;
    struct token token_source;
    struct token token_peeked;
    struct token token_expan;
+   // The shared texts of the token types, interned.
+   unsigned int token_texts[ TK_TOTAL ];
+   unsigned int space_text;
+   unsigned int one_text;
    enum tk tk;
    struct pos tk_pos;
    const char* tk_text;
@@ -410,7 +469,7 @@ struct parse {
       READF_SPACETAB = 0x8,
    } read_flags;
    bool concat_strings;
-   struct macro* macro_head;
+   struct macro_table macro_table;
    struct macro* macro_free;
    struct macro_param* macro_param_free;
    struct macro_expan* macro_expan;
@@ -428,9 +487,10 @@ struct parse {
    int line;
    int column;
    struct cache* cache;
+   // The #included header whose tokens are being recorded for the cache.
+   struct header_recording* header_recording;
 
    struct token* source_token;
-   struct queue_entry* tkque_free_entry;
    struct token_queue* tkque;
    struct token_queue parser_tkque;
    bool create_nltk;
@@ -453,8 +513,42 @@ struct parse {
       bool specified;
       bool enabled;
    } wadauthor;
+   // Reported by the -bench and -time-report options. Whitespace and newline
+   // tokens are not counted.
+   struct {
+      long long tokens;
+      long long bytes;
+      int macro_expansions;
+   } stats;
 };
 
+inline static const char* p_token_text( struct parse* parse,
+   const struct token* token ) {
+   return t_text( parse->task, token->text );
+}
+
+inline static uint64_t p_pack_pos( const struct pos* pos ) {
+   enum {
+      MAX_ID = ( 1 << POS_ID_BITS ) - 1,
+      MAX_LINE = ( 1 << POS_LINE_BITS ) - 1,
+      MAX_COLUMN = ( 1 << POS_COLUMN_BITS ) - 1
+   };
+   uint64_t id = pos->id < MAX_ID ? pos->id : MAX_ID;
+   uint64_t line = pos->line < MAX_LINE ? pos->line : MAX_LINE;
+   uint64_t column = pos->column < MAX_COLUMN ? pos->column : MAX_COLUMN;
+   return ( id << ( POS_LINE_BITS + POS_COLUMN_BITS ) ) |
+      ( line << POS_COLUMN_BITS ) | column;
+}
+
+inline static struct pos p_unpack_pos( uint64_t packed_pos ) {
+   struct pos pos;
+   pos.id = ( int ) ( packed_pos >> ( POS_LINE_BITS + POS_COLUMN_BITS ) );
+   pos.line = ( int ) ( ( packed_pos >> POS_COLUMN_BITS ) &
+      ( ( 1 << POS_LINE_BITS ) - 1 ) );
+   pos.column = ( int ) ( packed_pos & ( ( 1 << POS_COLUMN_BITS ) - 1 ) );
+   return pos;
+}
+
 void p_init( struct parse* parse, struct task* task, struct cache* cache );
 void p_init_stream( struct parse* parse );
 void p_run( struct parse* parse );
@@ -515,12 +609,15 @@ void p_unexpect_last_name( struct parse* parse, struct pos* pos,
 void p_load_library( struct parse* parent );
 void p_deinit_tk( struct parse* parse );
 void p_read_source( struct parse* parse, struct token* token );
+int p_bench_lexer( struct parse* parse );
+void p_skip_section_text( struct parse* parse );
 bool p_read_dirc( struct parse* parse );
 void p_confirm_ifdircs_closed( struct parse* parse );
 struct macro* p_find_macro( struct parse* parse, const char* name );
 bool p_read_dirc( struct parse* parse );
 int p_eval_prep_expr( struct parse* parse );
 const struct token_info* p_get_token_info( enum tk tk );
+void p_intern_token_texts( struct parse* parse );
 struct token* p_alloc_token( struct parse* parse );
 void p_free_token( struct parse* parse, struct token* token );
 void p_init_parsertk_iter( struct parse* parse, struct parsertk_iter* iter );
@@ -529,9 +626,10 @@ void p_init_streamtk_iter( struct parse* parse, struct streamtk_iter* iter );
 void p_next_stream( struct parse* parse, struct streamtk_iter* iter );
 bool p_expand_macro( struct parse* parse );
 void p_init_token_queue( struct token_queue* queue, bool stream );
-struct queue_entry* p_push_entry( struct parse* parse,
-   struct token_queue* queue );
-struct token* p_shift_entry( struct parse* parse, struct token_queue* queue );
+void p_deinit_token_queue( struct token_queue* queue );
+struct token* p_push_token( struct parse* parse, struct token_queue* queue );
+struct token* p_shift_token( struct parse* parse, struct token_queue* queue );
+struct token* p_get_queued_token( struct token_queue* queue, int index );
 void p_fill_queue( struct parse* parse, struct token_queue* queue,
    int required_size );
 void p_read_asm( struct parse* parse, struct stmt_reading* reading );
@@ -547,10 +645,24 @@ void p_define_imported_macro( struct parse* parse );
 void p_define_included_macro( struct parse* parse );
 void p_define_cmdline_macros( struct parse* parse );
 void p_undefine_included_macro( struct parse* parse );
+bool p_only_cmdline_macros( struct parse* parse );
+void p_remove_user_macros( struct parse* parse );
+struct macro* p_define_macro( struct parse* parse, const char* name );
+void p_append_macro_param( struct parse* parse, struct macro* macro,
+   const char* name );
+void p_append_macro_token( struct macro* macro, struct token* token );
 void p_read_func_body( struct parse* parse, struct func* func );
 bool p_is_macro_defined( struct parse* parse, const char* name );
 void p_init_token( struct token* token );
 void p_pop_source( struct parse* parse );
+void p_append_file( struct library* lib, struct file_entry* file );
+bool p_can_snapshot_header( struct parse* parse );
+bool p_restore_header( struct parse* parse, struct file_entry* file,
+   int line );
+void p_record_header( struct parse* parse );
+void p_record_header_token( struct parse* parse, struct token* token );
+void p_finish_header( struct parse* parse, struct source_entry* entry );
+void p_spoil_header( struct parse* parse );
 void p_create_cmdline_library_links( struct parse* parse );
 void p_read_local_using( struct parse* parse, struct list* output );
 bool p_read_let( struct parse* parse );
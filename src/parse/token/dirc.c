@@ -68,9 +68,11 @@ static void read_body_item( struct parse* parse,
 static bool valid_macro_param( struct parse* parse, struct macro* macro );
 static void append_token( struct macro* macro, struct token* token );
 static void finish_macro( struct parse* parse, struct macro_reading* reading );
-static bool same_macro( struct macro* a, struct macro* b );
+static bool same_macro( struct parse* parse, struct macro* a,
+   struct macro* b );
 static void free_macro( struct parse* parse, struct macro* macro );
 static void append_macro( struct parse* parse, struct macro* macro );
+static void grow_macro_table( struct macro_table* table );
 static void read_include( struct parse* parse );
 static void read_error( struct parse* parse, struct pos* pos );
 static void read_line( struct parse* parse );
@@ -94,16 +96,19 @@ static void read_else( struct parse* parse, struct endif_search* search,
 static void read_endif( struct parse* parse, struct endif_search* search,
    struct pos* pos );
 static void read_pragma( struct parse* parse );
+static void close_guard( struct parse* parse, bool endif );
 static void skip_section( struct parse* parse, struct pos* pos );
 static void read_region( struct parse* parse );
 
 bool p_read_dirc( struct parse* parse ) {
    enum dirc dirc = identify_dirc( parse );
    if ( dirc != DIRC_NONE ) {
-      struct pos pos = parse->token->pos;
+      enum timer timer = t_switch_timer( parse->task, TIMER_PREPROCESS );
+      struct pos pos = p_unpack_pos( parse->token->pos );
       p_test_preptk( parse, TK_HASH );
       p_read_preptk( parse );
       read_identified_dirc( parse, &pos, dirc );
+      t_switch_timer( parse->task, timer );
       return true;
    }
    return false;
@@ -118,7 +123,7 @@ static enum dirc identify_dirc( struct parse* parse ) {
    }
    enum dirc dirc = DIRC_NONE;
    if ( iter.token->type == TK_ID ) {
-      dirc = identify_named_dirc( iter.token->text );
+      dirc = identify_named_dirc( p_token_text( parse, iter.token ) );
       // To stay compatible with ACS, only execute the following directives
       // when inside the #if family of directives.
       // zt-bcc: Added pragma "raw define" to enable/disable preprocessor macros
@@ -231,14 +236,15 @@ static void read_define( struct parse* parse ) {
 static void read_macro_name( struct parse* parse,
    struct macro_reading* reading ) {
    p_test_preptk( parse, TK_ID );
-   if ( ! valid_macro_name( parse->token->text ) ) {
-      p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+   if ( ! valid_macro_name( p_token_text( parse, parse->token ) ) ) {
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR, &pos,
          "invalid macro name" );
       p_bail( parse );
    }
    struct macro* macro = alloc_macro( parse );
-   macro->name = parse->token->text;
-   macro->pos = parse->token->pos;
+   macro->name = p_token_text( parse, parse->token );
+   macro->pos = p_unpack_pos( parse->token->pos );
    reading->macro = macro;
    p_read_stream( parse );
 }
@@ -255,7 +261,7 @@ static struct macro* alloc_macro( struct parse* parse ) {
       parse->macro_free = macro->next;
    }
    else {
-      macro = mem_alloc( sizeof( *macro ) );
+      macro = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *macro ) );
    }
    macro->name = NULL;
    macro->next = NULL;
@@ -263,11 +269,14 @@ static struct macro* alloc_macro( struct parse* parse ) {
    macro->param_tail = NULL;
    macro->body = NULL;
    macro->body_tail = NULL;
+   macro->expansion = NULL;
+   macro->expansion_tail = NULL;
    t_init_pos_id( &macro->pos, INTERNALFILE_COMPILER );
    macro->param_count = 0;
    macro->predef = PREDEFMACRO_NONE;
    macro->func_like = false;
    macro->variadic = false;
+   macro->expanded = false;
    return macro;
 }
 
@@ -287,15 +296,17 @@ static void read_param_list( struct parse* parse,
    while ( parse->token->type == TK_ID ) {
       struct macro_param* param = reading->macro->param_head;
       while ( param ) {
-         if ( strcmp( param->name, parse->token->text ) == 0 ) {
-            p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+         if ( strcmp( param->name,
+            p_token_text( parse, parse->token ) ) == 0 ) {
+            struct pos pos = p_unpack_pos( parse->token->pos );
+            p_diag( parse, DIAG_POS_ERR, &pos,
                "duplicate macro parameter" );
             p_bail( parse );
          }
          param = param->next;
       }
       param = alloc_param( parse );
-      param->name = parse->token->text;
+      param->name = p_token_text( parse, parse->token );
       append_param( reading->macro, param );
       p_read_preptk( parse );
       comma = ( parse->token->type == TK_COMMA );
@@ -332,7 +343,7 @@ static struct macro_param* alloc_param( struct parse* parse ) {
       parse->macro_param_free = param->next;
    }
    else {
-      param = mem_alloc( sizeof( *param ) );
+      param = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *param ) );
    }
    param->name = NULL;
    param->next = NULL;
@@ -365,7 +376,8 @@ static void read_body( struct parse* parse, struct macro_reading* reading ) {
       // For an object-like macro, there needs to be whitespace between the
       // name and the body of the macro.
       if ( ! reading->macro->func_like ) {
-         p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+         struct pos pos = p_unpack_pos( parse->token->pos );
+         p_diag( parse, DIAG_POS_ERR, &pos,
             "missing whitespace between macro name and macro body" );
          p_bail( parse );
       }
@@ -375,7 +387,8 @@ static void read_body( struct parse* parse, struct macro_reading* reading ) {
    }
    if ( reading->macro->body_tail &&
       reading->macro->body_tail->type == TK_HASHHASH ) {
-      p_diag( parse, DIAG_POS_ERR, &reading->macro->body_tail->pos,
+      struct pos pos = p_unpack_pos( reading->macro->body_tail->pos );
+      p_diag( parse, DIAG_POS_ERR, &pos,
          "`##` operator at end of macro body" );
       p_bail( parse );
    }
@@ -389,9 +402,10 @@ static void read_body_item( struct parse* parse,
          p_read_preptk( parse );
          p_test_preptk( parse, TK_ID );
          if ( ! valid_macro_param( parse, reading->macro ) ) {
-            p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+            struct pos pos = p_unpack_pos( parse->token->pos );
+            p_diag( parse, DIAG_POS_ERR, &pos,
                "`%s` not a parameter of `%s` macro",
-               parse->token->text, reading->macro->name );
+               p_token_text( parse, parse->token ), reading->macro->name );
             p_bail( parse );
          }
          parse->token->type = TK_STRINGIZE;
@@ -403,7 +417,8 @@ static void read_body_item( struct parse* parse,
    // `##` operator.
    else if ( parse->token->type == TK_HASHHASH ) {
       if ( ! reading->macro->body ) {
-         p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+         struct pos pos = p_unpack_pos( parse->token->pos );
+         p_diag( parse, DIAG_POS_ERR, &pos,
             "`##` operator at beginning of macro body" );
          p_bail( parse );
       }
@@ -427,9 +442,10 @@ static void read_body_item( struct parse* parse,
       token->length = 1;
    }
    append_token( reading->macro, token );
-   if ( strcmp( token->text, reading->macro->name ) == 0 ) {
+   if ( strcmp( p_token_text( parse, token ), reading->macro->name ) == 0 ) {
       struct macro_param* param = reading->macro->param_head;
-      while ( param && strcmp( param->name, token->text ) != 0 ) {
+      while ( param &&
+         strcmp( param->name, p_token_text( parse, token ) ) != 0 ) {
          param = param->next;
       }
       if ( ! param ) {
@@ -442,7 +458,7 @@ static void read_body_item( struct parse* parse,
 static bool valid_macro_param( struct parse* parse, struct macro* macro ) {
    struct macro_param* param = macro->param_head;
    while ( param && param->name ) {
-      if ( strcmp( parse->token->text, param->name ) == 0 ) {
+      if ( strcmp( p_token_text( parse, parse->token ), param->name ) == 0 ) {
          return true;
       }
       param = param->next;
@@ -469,7 +485,7 @@ static void finish_macro( struct parse* parse,
             "redefining predefined macro" );
          p_bail( parse );
       }
-      if ( same_macro( prev_macro, reading->macro ) ) {
+      if ( same_macro( parse, prev_macro, reading->macro ) ) {
          prev_macro->pos = reading->macro->pos;
          free_macro( parse, reading->macro );
       }
@@ -488,22 +504,21 @@ static void finish_macro( struct parse* parse,
 }
 
 struct macro* p_find_macro( struct parse* parse, const char* name ) {
-   struct macro* macro = parse->macro_head;
-   while ( macro ) {
-      int result = strcmp( macro->name, name );
-      if ( result == 0 ) {
-         break;
-      }
-      if ( result > 0 ) {
-         macro = NULL;
-         break;
-      }
+   struct macro_table* table = &parse->macro_table;
+   if ( table->size == 0 ) {
+      return NULL;
+   }
+   unsigned int hash = c_hash_str( name );
+   struct macro* macro = table->buckets[ hash & ( table->capacity - 1 ) ];
+   while ( macro && ! ( macro->hash == hash &&
+      strcmp( macro->name, name ) == 0 ) ) {
       macro = macro->next;
    }
    return macro;
 }
 
-static bool same_macro( struct macro* a, struct macro* b ) {
+static bool same_macro( struct parse* parse, struct macro* a,
+   struct macro* b ) {
    // Macros need to be of the same kind.
    if ( a->func_like != b->func_like ) {
       return false;
@@ -532,10 +547,10 @@ static bool same_macro( struct macro* a, struct macro* b ) {
          return false;
       }
       // Tokens that can have different values need to have the same value.
-      if ( token_a->text ) {
-         if ( strcmp( token_a->text, token_b->text ) != 0 ) {
-            return false;
-         }
+      if ( token_a->text != token_b->text && strcmp(
+         p_token_text( parse, token_a ),
+         p_token_text( parse, token_b ) ) != 0 ) {
+         return false;
       }
       token_a = token_a->next;
       token_b = token_b->next;
@@ -558,43 +573,72 @@ static void free_macro( struct parse* parse, struct macro* macro ) {
       macro->body_tail->next = parse->token_free;
       parse->token_free = macro->body;
    }
+   if ( macro->expansion ) {
+      macro->expansion_tail->next = parse->token_free;
+      parse->token_free = macro->expansion;
+   }
    // Reuse macro.
    macro->next = parse->macro_free;
    parse->macro_free = macro;
 }
 
 static void append_macro( struct parse* parse, struct macro* macro ) {
-   struct macro* prev = NULL;
-   struct macro* curr = parse->macro_head;
-   while ( curr && strcmp( curr->name, macro->name ) < 0 ) {
-      prev = curr;
-      curr = curr->next;
+   struct macro_table* table = &parse->macro_table;
+   if ( table->size >= table->capacity / 2 ) {
+      grow_macro_table( table );
+   }
+   macro->hash = c_hash_str( macro->name );
+   struct macro** bucket =
+      &table->buckets[ macro->hash & ( table->capacity - 1 ) ];
+   macro->next = *bucket;
+   *bucket = macro;
+   ++table->size;
+}
+
+static void grow_macro_table( struct macro_table* table ) {
+   enum { INITIAL_CAPACITY = 256 };
+   int capacity = ( table->capacity > 0 ) ?
+      table->capacity * 2 : INITIAL_CAPACITY;
+   struct macro** buckets = mem_arena_alloc( MEM_ARENA_TRANSIENT,
+      sizeof( buckets[ 0 ] ) * capacity );
+   memset( buckets, 0, sizeof( buckets[ 0 ] ) * capacity );
+   for ( int i = 0; i < table->capacity; ++i ) {
+      struct macro* macro = table->buckets[ i ];
+      while ( macro ) {
+         struct macro* next = macro->next;
+         struct macro** bucket = &buckets[ macro->hash & ( capacity - 1 ) ];
+         macro->next = *bucket;
+         *bucket = macro;
+         macro = next;
+      }
    }
-   if ( prev ) {
-      macro->next = prev->next;
-      prev->next = macro;
-   }
-   else {
-      macro->next = parse->macro_head;
-      parse->macro_head = macro;
+   if ( table->buckets ) {
+      mem_free( table->buckets );
    }
+   table->buckets = buckets;
+   table->capacity = capacity;
 }
 
 void p_clear_macros( struct parse* parse ) {
-   struct macro* macro = parse->macro_head;
-   while ( macro ) {
-      parse->macro_head = macro->next;
-      free_macro( parse, macro );
-      macro = parse->macro_head;
+   struct macro_table* table = &parse->macro_table;
+   for ( int i = 0; i < table->capacity; ++i ) {
+      struct macro* macro = table->buckets[ i ];
+      while ( macro ) {
+         struct macro* next = macro->next;
+         free_macro( parse, macro );
+         macro = next;
+      }
+      table->buckets[ i ] = NULL;
    }
+   table->size = 0;
 }
 
 static void read_include( struct parse* parse ) {
    p_test_preptk( parse, TK_ID );
    p_read_expanpreptk( parse );
    p_test_preptk( parse, TK_LIT_STRING );
-   const char* path = parse->token->text;
-   struct pos pos = parse->token->pos;
+   const char* path = p_token_text( parse, parse->token );
+   struct pos pos = p_unpack_pos( parse->token->pos );
    p_read_expanpreptk( parse );
    p_test_preptk( parse, TK_NL );
    p_load_included_source( parse, path, &pos );
@@ -607,7 +651,7 @@ static void read_error( struct parse* parse, struct pos* pos ) {
    str_init( &message );
    str_append( &message, "#error " );
    while ( parse->token->type != TK_NL ) {
-      str_append( &message, parse->token->text );
+      str_append( &message, p_token_text( parse, parse->token ) );
       p_read_stream( parse );
    }
    p_diag( parse, DIAG_POS_ERR, pos, message.value );
@@ -618,16 +662,17 @@ static void read_line( struct parse* parse ) {
    p_test_preptk( parse, TK_ID );
    p_read_preptk( parse );
    p_test_preptk( parse, TK_LIT_DECIMAL );
-   int line = strtol( parse->token->text, NULL, 10 );
+   int line = strtol( p_token_text( parse, parse->token ), NULL, 10 );
    if ( line == 0 ) {
-      p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR, &pos,
          "invalid line-number argument" );
       p_bail( parse );
    }
    p_read_preptk( parse );
    const char* filename = NULL;
    if ( parse->token->type == TK_LIT_STRING ) {
-      filename = parse->token->text;
+      filename = p_token_text( parse, parse->token );
       p_read_preptk( parse );
    }
    p_test_preptk( parse, TK_NL );
@@ -638,15 +683,18 @@ static void read_undef( struct parse* parse ) {
    p_test_preptk( parse, TK_ID );
    p_read_preptk( parse );
    p_test_preptk( parse, TK_ID );
-   if ( ! valid_macro_name( parse->token->text ) ) {
-      p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
-         "invalid macro name", parse->token->text );
+   if ( ! valid_macro_name( p_token_text( parse, parse->token ) ) ) {
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR, &pos,
+         "invalid macro name", p_token_text( parse, parse->token ) );
       p_bail( parse );
    }
-   struct macro* macro = remove_macro( parse, parse->token->text );
+   struct macro* macro = remove_macro( parse,
+      p_token_text( parse, parse->token ) );
    if ( macro ) {
       if ( ! ( macro->predef == PREDEFMACRO_NONE ) ) {
-         p_diag( parse, DIAG_POS_ERR, &parse->token->pos,
+         struct pos pos = p_unpack_pos( parse->token->pos );
+         p_diag( parse, DIAG_POS_ERR, &pos,
             "undefining a predefined macro" );
          p_bail( parse );
       }
@@ -657,36 +705,27 @@ static void read_undef( struct parse* parse ) {
 }
 
 static struct macro* remove_macro( struct parse* parse, const char* name ) {
-   struct macro* macro_prev = NULL;
-   struct macro* macro = parse->macro_head;
-   while ( macro ) {
-      int result = strcmp( macro->name, name );
-      if ( result == 0 ) {
-         break;
-      }
-      else if ( result > 0 ) {
-         macro = NULL;
-         break;
-      }
-      else {
-         macro_prev = macro;
-         macro = macro->next;
-      }
+   struct macro_table* table = &parse->macro_table;
+   if ( table->size == 0 ) {
+      return NULL;
+   }
+   unsigned int hash = c_hash_str( name );
+   struct macro** link = &table->buckets[ hash & ( table->capacity - 1 ) ];
+   while ( *link && ! ( ( *link )->hash == hash &&
+      strcmp( ( *link )->name, name ) == 0 ) ) {
+      link = &( *link )->next;
    }
+   struct macro* macro = *link;
    if ( macro ) {
-      if ( macro_prev ) {
-         macro_prev->next = macro->next;
-      }
-      else {
-         parse->macro_head = macro->next;
-      }
+      *link = macro->next;
+      --table->size;
    }
    return macro;
 }
 
 static void read_if( struct parse* parse, struct pos* pos ) {
    p_test_preptk( parse, TK_ID );
-   push_ifdirc( parse, parse->token->text, pos );
+   push_ifdirc( parse, p_token_text( parse, parse->token ), pos );
    int value = p_eval_prep_expr( parse );
    p_test_preptk( parse, TK_NL );
    if ( ! value ) {
@@ -702,7 +741,7 @@ static void push_ifdirc( struct parse* parse, const char* name,
       parse->ifdirc_free = entry->prev;
    }
    else {
-      entry = mem_alloc( sizeof( *entry ) );
+      entry = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *entry ) );
    }
    entry->prev = parse->ifdirc;
    entry->name = name;
@@ -727,10 +766,25 @@ static bool pop_ifdirc( struct parse* parse ) {
 // Handles #ifdef/#ifndef.
 static void read_ifdef( struct parse* parse, struct pos* pos ) {
    p_test_preptk( parse, TK_ID );
-   push_ifdirc( parse, parse->token->text, pos );
+   push_ifdirc( parse, p_token_text( parse, parse->token ), pos );
+   // An include guard must be the first thing in the file, so only the `#`
+   // and the directive name have been read so far.
+   bool guard = ( parse->source_entry->guard.state == GUARD_UNKNOWN &&
+      parse->ifdirc->name[ 2 ] == 'n' && parse->source->tokens == 2 );
    p_read_preptk( parse );
    p_test_preptk( parse, TK_ID );
-   bool defined = p_is_macro_defined( parse, parse->token->text );
+   if ( parse->source_entry->guard.state == GUARD_UNKNOWN ) {
+      if ( guard ) {
+         parse->source_entry->guard.name = p_token_text( parse, parse->token );
+         parse->source_entry->guard.pos = *pos;
+         parse->source_entry->guard.state = GUARD_OPEN;
+      }
+      else {
+         parse->source_entry->guard.state = GUARD_NONE;
+      }
+   }
+   bool defined = p_is_macro_defined( parse,
+      p_token_text( parse, parse->token ) );
    p_read_preptk( parse );
    p_test_preptk( parse, TK_NL );
    if ( ! (
@@ -760,9 +814,15 @@ static void init_endif_search( struct endif_search* search,
 static void find_endif( struct parse* parse, struct endif_search* search ) {
    while ( ! search->done ) {
       if ( parse->token->type == TK_NL ) {
+         // When the newline character was just read from the source file,
+         // look for the next directive without tokenizing the lines in
+         // between.
+         if ( parse->tkque->size == 0 && ! parse->macro_expan ) {
+            p_skip_section_text( parse );
+         }
          p_read_preptk( parse );
          if ( parse->token->type == TK_HASH ) {
-            struct pos pos = parse->token->pos;
+            struct pos pos = p_unpack_pos( parse->token->pos );
             p_read_preptk( parse );
             if ( parse->token->type == TK_ID ) {
                read_search_dirc( parse, search, &pos );
@@ -781,7 +841,7 @@ static void find_endif( struct parse* parse, struct endif_search* search ) {
 static bool read_pragma_onoff (struct parse* parse)
 {
    p_read_preptk( parse );
-   const char* text = parse->token->text;
+   const char* text = p_token_text( parse, parse->token );
 	
    if( bcc_stricmp("on", text) == 0 ) {
       return true;
@@ -790,9 +850,10 @@ static bool read_pragma_onoff (struct parse* parse)
       return false;
    }
    else {
-      p_diag( parse, DIAG_POS_ERR | DIAG_SYNTAX, &parse->token->pos,
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR | DIAG_SYNTAX, &pos,
             "unexpected %s", p_present_token_temp( parse, parse->token->type ) );
-      p_diag( parse, DIAG_POS, &parse->token->pos,
+      p_diag( parse, DIAG_POS, &pos,
             "expecting on or off here");
       p_bail( parse );
    }
@@ -803,11 +864,11 @@ static bool read_pragma_onoff (struct parse* parse)
 static void read_pragma( struct parse* parse ) {
    p_test_preptk( parse, TK_ID );
    p_read_preptk( parse );
-   const char* name = parse->token->text;
+   const char* name = p_token_text( parse, parse->token );
 
    if( bcc_stricmp( "raw", name ) == 0 ) {
       p_read_preptk( parse );
-	  const char* text = parse->token->text;
+	  const char* text = p_token_text( parse, parse->token );
 	  
 	  if( bcc_stricmp( "define", text ) == 0 )
 	  {
@@ -819,36 +880,38 @@ static void read_pragma( struct parse* parse ) {
 	  }
 	  else
 	  {
-	     p_diag( parse, DIAG_POS_ERR, &parse->token->pos, "unexpected pragma %s, expected include or define", text );
+	     struct pos pos = p_unpack_pos( parse->token->pos );
+	     p_diag( parse, DIAG_POS_ERR, &pos, "unexpected pragma %s, expected include or define", text );
          p_bail( parse );
 	  }
    }
    else
    {
-      p_diag( parse, DIAG_POS_ERR, &parse->token->pos, "unknown pragma %s", name);
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR, &pos, "unknown pragma %s", name);
       p_bail( parse );
    }
 }
 
 static void read_search_dirc( struct parse* parse, struct endif_search* search,
    struct pos* pos ) {
-   if ( strcmp( parse->token->text, "ifdef" ) == 0 ||
-      strcmp( parse->token->text, "ifndef" ) == 0 ||
-      strcmp( parse->token->text, "if" ) == 0 ) {
-      push_ifdirc( parse, parse->token->text, pos );
+   if ( strcmp( p_token_text( parse, parse->token ), "ifdef" ) == 0 ||
+      strcmp( p_token_text( parse, parse->token ), "ifndef" ) == 0 ||
+      strcmp( p_token_text( parse, parse->token ), "if" ) == 0 ) {
+      push_ifdirc( parse, p_token_text( parse, parse->token ), pos );
       ++search->depth;
    }
-   else if ( strcmp( parse->token->text, "elif" ) == 0 ) {
+   else if ( strcmp( p_token_text( parse, parse->token ), "elif" ) == 0 ) {
       if ( search->depth == 1 ) {
          read_elif( parse, search, pos );
       }
    }
-   else if ( strcmp( parse->token->text, "else" ) == 0 ) {
+   else if ( strcmp( p_token_text( parse, parse->token ), "else" ) == 0 ) {
       if ( search->depth == 1 ) {
          read_else( parse, search, pos );
       }
    }
-   else if ( strcmp( parse->token->text, "endif" ) == 0 ) {
+   else if ( strcmp( p_token_text( parse, parse->token ), "endif" ) == 0 ) {
       read_endif( parse, search, pos );
    }
 }
@@ -863,6 +926,7 @@ static void read_elif( struct parse* parse, struct endif_search* search,
          "#elif outside an if-directive" );
       p_bail( parse );
    }
+   close_guard( parse, false );
    if ( parse->ifdirc->else_found ) {
       p_diag( parse, DIAG_POS_ERR, pos,
          "#elif found after #else" );
@@ -885,6 +949,7 @@ static void read_else( struct parse* parse, struct endif_search* search,
          "#else used with no open if-directive" );
       p_bail( parse );
    }
+   close_guard( parse, false );
    if ( parse->ifdirc->else_found ) {
       p_diag( parse, DIAG_POS_ERR, pos,
          "duplicate #else" );
@@ -904,6 +969,7 @@ static void read_endif( struct parse* parse, struct endif_search* search,
    p_test_preptk( parse, TK_ID );
    p_read_preptk( parse );
    p_test_preptk( parse, TK_NL );
+   close_guard( parse, true );
    if ( ! pop_ifdirc( parse ) ) {
       p_diag( parse, DIAG_POS_ERR, pos,
          "#endif used with no open if-directive" );
@@ -915,6 +981,22 @@ static void read_endif( struct parse* parse, struct endif_search* search,
    }
 }
 
+// Called when the current if-directive is being ended or given another
+// section. The include guard is invalid if it has an #else or an #elif.
+static void close_guard( struct parse* parse, bool endif ) {
+   struct source_entry* entry = parse->source_entry;
+   if ( entry->guard.state == GUARD_OPEN && parse->ifdirc &&
+      t_same_pos( &parse->ifdirc->pos, &entry->guard.pos ) ) {
+      if ( endif ) {
+         entry->guard.tokens = parse->source->tokens;
+         entry->guard.state = GUARD_CLOSED;
+      }
+      else {
+         entry->guard.state = GUARD_NONE;
+      }
+   }
+}
+
 static void skip_section( struct parse* parse, struct pos* pos ) {
    struct endif_search search;
    init_endif_search( &search, false );
@@ -993,8 +1075,9 @@ void p_define_cmdline_macros( struct parse* parse ) {
          struct token* token = p_alloc_token( parse );
          p_init_token( token );
          token->type = TK_LIT_DECIMAL;
-         token->text = CMDLINEMACRO_TEXT,
          token->length = strlen( CMDLINEMACRO_TEXT );
+         token->text = t_intern_text_offset( parse->task, CMDLINEMACRO_TEXT,
+            token->length );
          macro = alloc_macro( parse );
          macro->name = name;
          macro->pos.id = INTERNALFILE_COMMANDLINE;
@@ -1005,6 +1088,61 @@ void p_define_cmdline_macros( struct parse* parse ) {
    }
 }
 
+// Whether every macro is either predefined or defined on the command line.
+bool p_only_cmdline_macros( struct parse* parse ) {
+   struct macro_table* table = &parse->macro_table;
+   for ( int i = 0; i < table->capacity; ++i ) {
+      struct macro* macro = table->buckets[ i ];
+      while ( macro ) {
+         if ( macro->predef == PREDEFMACRO_NONE &&
+            macro->pos.id != INTERNALFILE_COMMANDLINE ) {
+            return false;
+         }
+         macro = macro->next;
+      }
+   }
+   return true;
+}
+
+// Removes every macro that is not predefined.
+void p_remove_user_macros( struct parse* parse ) {
+   struct macro_table* table = &parse->macro_table;
+   for ( int i = 0; i < table->capacity; ++i ) {
+      struct macro** link = &table->buckets[ i ];
+      while ( *link ) {
+         struct macro* macro = *link;
+         if ( macro->predef == PREDEFMACRO_NONE ) {
+            *link = macro->next;
+            --table->size;
+            free_macro( parse, macro );
+         }
+         else {
+            link = &macro->next;
+         }
+      }
+   }
+}
+
+// Defines a macro with an empty body. The caller then adds the parameters and
+// the body of the macro.
+struct macro* p_define_macro( struct parse* parse, const char* name ) {
+   struct macro* macro = alloc_macro( parse );
+   macro->name = name;
+   append_macro( parse, macro );
+   return macro;
+}
+
+void p_append_macro_param( struct parse* parse, struct macro* macro,
+   const char* name ) {
+   struct macro_param* param = alloc_param( parse );
+   param->name = name;
+   append_param( macro, param );
+}
+
+void p_append_macro_token( struct macro* macro, struct token* token ) {
+   append_token( macro, token );
+}
+
 // Reads #region/#endregion. These directives have no effect.
 static void read_region( struct parse* parse ) {
    p_test_preptk( parse, TK_ID );
@@ -26,7 +26,7 @@ static int eval_paren( struct parse* parse, struct calc* calc );
 int p_eval_prep_expr( struct parse* parse ) {
    parse->read_flags = READF_ESCAPESEQ;
    p_read_expanpreptk( parse );
-   struct pos pos = parse->token->pos;
+   struct pos pos = p_unpack_pos( parse->token->pos );
    if ( parse->token->type == TK_NL ) {
       p_diag( parse, DIAG_POS_ERR, &pos,
          "missing expression" );
@@ -80,7 +80,7 @@ static int eval_binary( struct parse* parse, struct calc* calc ) {
    case TK_SLASH:
    case TK_MOD:
       mul = parse->token->type;
-      pos = parse->token->pos;
+      pos = p_unpack_pos( parse->token->pos );
       p_read_expanpreptk( parse );
       break;
    default:
@@ -314,13 +314,13 @@ static int eval_primary( struct parse* parse, struct calc* calc ) {
 }
 
 static int eval_ch( struct parse* parse ) {
-   int value = parse->token->text[ 0 ];
+   int value = p_token_text( parse, parse->token )[ 0 ];
    p_read_expanpreptk( parse );
    return value;
 }
 
 static int eval_id( struct parse* parse ) {
-   if ( strcmp( parse->token->text, "defined" ) == 0 ) {
+   if ( strcmp( p_token_text( parse, parse->token ), "defined" ) == 0 ) {
       return eval_defined( parse );
    }
    else {
@@ -338,7 +338,8 @@ static int eval_defined( struct parse* parse ) {
       paren = true;
    }
    p_test_preptk( parse, TK_ID );
-   bool defined = p_is_macro_defined( parse, parse->token->text );
+   bool defined = p_is_macro_defined( parse,
+      p_token_text( parse, parse->token ) );
    if ( paren ) {
       p_read_preptk( parse );
       p_test_preptk( parse, TK_PAREN_R );
@@ -351,13 +352,13 @@ static int eval_number( struct parse* parse ) {
    int value = 0;
    switch ( parse->token->type ) {
    case TK_LIT_DECIMAL:
-      value = strtol( parse->token->text, NULL, 10 );
+      value = strtol( p_token_text( parse, parse->token ), NULL, 10 );
       break;
    case TK_LIT_OCTAL:
-      value = strtol( parse->token->text, NULL, 8 );
+      value = strtol( p_token_text( parse, parse->token ), NULL, 8 );
       break;
    case TK_LIT_HEX:
-      value = strtol( parse->token->text, NULL, 16 );
+      value = strtol( p_token_text( parse, parse->token ), NULL, 16 );
       break;
    default:
       break;
@@ -179,6 +179,20 @@ static struct token_info g_table[] = {
 };
 #undef ENTRY
 
+// The shared texts of the tokens are interned, so the tokens can refer to them
+// by offset.
+void p_intern_token_texts( struct parse* parse ) {
+   STATIC_ASSERT( TK_TOTAL == 154 );
+   // The type of a token is stored in a byte.
+   STATIC_ASSERT( TK_MACRONAME < 256 );
+   for ( int i = 0; i < TK_TOTAL; ++i ) {
+      parse->token_texts[ i ] = t_intern_text_offset( parse->task,
+         g_table[ i ].shared_text, g_table[ i ].length );
+   }
+   parse->space_text = t_intern_text_offset( parse->task, " ", 1 );
+   parse->one_text = t_intern_text_offset( parse->task, "1", 1 );
+}
+
 const struct token_info* p_get_token_info( enum tk tk ) {
    STATIC_ASSERT( TK_TOTAL == 154 );
    return &g_table[ tk ];
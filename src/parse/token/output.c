@@ -1,24 +1,85 @@
+#include <string.h>
+#include <errno.h>
+
 #include "../phase.h"
 
-static void output_source( struct parse* parse, struct str* output );
-static void output_token( struct parse* parse, struct str* output );
+enum { OUTPUT_BUFFER_SIZE = 65536 };
+
+// The preprocessed source is written in pieces as it is produced, through a
+// buffer, so the whole output is never held in memory.
+struct output {
+   FILE* file;
+   struct pos pos;
+   int length;
+   char last_ch;
+   bool line_beginning;
+   bool line_markers;
+   char buffer[ OUTPUT_BUFFER_SIZE ];
+};
+
+static void init_output( struct parse* parse, struct output* output );
+static void output_source( struct parse* parse, struct output* output );
+static void output_token( struct parse* parse, struct output* output );
+static void output_line_marker( struct parse* parse, struct output* output );
+static void output_string( struct output* output, const char* text,
+   int length );
+static void write_text( struct output* output, const char* text,
+   int length );
+static void write_str( struct output* output, const char* text );
+static void flush_output( struct output* output );
 
+// When an error stops the preprocessor, the output written up to that point is
+// still flushed, and the output file closed, before bailing.
 void p_preprocess( struct parse* parse ) {
    parse->read_flags = READF_NL | READF_SPACETAB;
-   struct str output;
-   str_init( &output );
-   output_source( parse, &output );
-   if ( output.length > 0 && output.value[ output.length - 1 ] != '\n' ) {
-      str_append( &output, NEWLINE_CHAR );
+   struct output* output = mem_alloc( sizeof( *output ) );
+   init_output( parse, output );
+   bool success = false;
+   jmp_buf bail, *prev_bail = parse->task->bail;
+   if ( setjmp( bail ) == 0 ) {
+      parse->task->bail = &bail;
+      output_source( parse, output );
+      if ( output->last_ch && output->last_ch != '\n' ) {
+         write_str( output, NEWLINE_CHAR );
+      }
+      success = true;
+   }
+   parse->task->bail = prev_bail;
+   flush_output( output );
+   if ( output->file != stdout ) {
+      fclose( output->file );
+   }
+   mem_free( output );
+   if ( ! success ) {
+      p_bail( parse );
    }
-   printf( "%s", output.value );
-   str_deinit( &output );
 }
 
-static void output_source( struct parse* parse, struct str* output ) {
+static void init_output( struct parse* parse, struct output* output ) {
+   output->file = stdout;
+   if ( parse->task->options->object_file ) {
+      output->file = fopen( parse->task->options->object_file, "wb" );
+      if ( ! output->file ) {
+         p_diag( parse, DIAG_ERR,
+            "failed to open output file: %s (%s)",
+            parse->task->options->object_file, strerror( errno ) );
+         p_bail( parse );
+      }
+   }
+   t_init_pos_id( &output->pos, INTERNALFILE_COMPILER );
+   output->length = 0;
+   output->last_ch = 0;
+   output->line_beginning = true;
+   output->line_markers = parse->task->options->line_markers;
+}
+
+static void output_source( struct parse* parse, struct output* output ) {
    while ( true ) {
       p_read_eoptiontk( parse );
       if ( parse->token->type != TK_END ) {
+         if ( output->line_markers && output->line_beginning ) {
+            output_line_marker( parse, output );
+         }
          output_token( parse, output );
       }
       else {
@@ -29,57 +90,121 @@ static void output_source( struct parse* parse, struct str* output ) {
 }
 
 // TODO: Get the original text of the token.
-static void output_token( struct parse* parse, struct str* output ) {
+static void output_token( struct parse* parse, struct output* output ) {
+   const char* text = p_token_text( parse, parse->token );
+   output->line_beginning = false;
    switch ( parse->token->type ) {
    case TK_NL:
-      str_append( output, NEWLINE_CHAR );
+      write_str( output, NEWLINE_CHAR );
+      output->line_beginning = true;
+      ++output->pos.line;
       break;
    case TK_HORZSPACE:
       for ( int i = 0; i < parse->token->length; ++i ) {
-         str_append( output, parse->token->text );
+         write_str( output, text );
       }
       break;
    case TK_LIT_STRING:
-      str_append( output, "\"" );
-      for ( int i = 0; i < parse->token->length; ++i ) {
-         if ( parse->token->text[ i ] == '"' ) {
-            str_append( output, "\\" );
-         }
-         char ch[] = { parse->token->text[ i ], 0 };
-         str_append( output, ch );
-      }
-      str_append( output, "\"" );
+      output_string( output, text, parse->token->length );
       break;
    case TK_LIT_CHAR:
-      str_append( output, "'" );
-      str_append( output, parse->token->text );
-      str_append( output, "'" );
+      write_str( output, "'" );
+      write_str( output, text );
+      write_str( output, "'" );
       break;
    case TK_LIT_OCTAL:
-      str_append( output, "0o" );
-      str_append( output, parse->token->text );
+      write_str( output, "0o" );
+      write_str( output, text );
       break;
    case TK_LIT_HEX:
-      str_append( output, "0x" );
-      str_append( output, parse->token->text );
+      write_str( output, "0x" );
+      write_str( output, text );
       break;
    case TK_LIT_BINARY:
-      str_append( output, "0b" );
-      str_append( output, parse->token->text );
+      write_str( output, "0b" );
+      write_str( output, text );
       break;
    case TK_LIT_RADIX:
-      for ( int i = 0; i < parse->token->length; ++i ) {
-         if ( parse->token->text[ i ] == '_' ) {
-            str_append( output, "r" );
-         }
-         else {
-            char ch[] = { parse->token->text[ i ], 0 };
-            str_append( output, ch );
+      {
+         const char* end = text + parse->token->length;
+         const char* separator;
+         while ( ( separator = memchr( text, '_', end - text ) ) ) {
+            write_text( output, text, separator - text );
+            write_str( output, "r" );
+            text = separator + 1;
          }
+         write_text( output, text, end - text );
       }
       break;
    default:
-      str_append( output, parse->token->text );
+      write_str( output, text );
       break;
    }
 }
+
+// Before a line is written, when the line does not directly follow the
+// previous line of the same file, writes a #line directive giving the
+// position of the line.
+static void output_line_marker( struct parse* parse, struct output* output ) {
+   struct pos pos = p_unpack_pos( parse->token->pos );
+   if ( pos.id == output->pos.id && pos.line == output->pos.line ) {
+      return;
+   }
+   char line[ 12 ];
+   snprintf( line, sizeof( line ), "%d", pos.line );
+   write_str( output, "#line " );
+   write_str( output, line );
+   const char* file = t_decode_pos_file( parse->task, &pos );
+   if ( file ) {
+      write_str( output, " " );
+      output_string( output, file, strlen( file ) );
+   }
+   write_str( output, NEWLINE_CHAR );
+   output->pos = pos;
+}
+
+// Writes a string literal, escaping the quotation marks. The text between
+// the quotation marks is written in runs.
+static void output_string( struct output* output, const char* text,
+   int length ) {
+   write_str( output, "\"" );
+   const char* end = text + length;
+   while ( text < end ) {
+      const char* quote = memchr( text, '"', end - text );
+      if ( ! quote ) {
+         write_text( output, text, end - text );
+         break;
+      }
+      write_text( output, text, quote - text );
+      write_str( output, "\\\"" );
+      text = quote + 1;
+   }
+   write_str( output, "\"" );
+}
+
+static void write_text( struct output* output, const char* text,
+   int length ) {
+   if ( length == 0 ) {
+      return;
+   }
+   if ( output->length + length > OUTPUT_BUFFER_SIZE ) {
+      flush_output( output );
+      if ( length > OUTPUT_BUFFER_SIZE ) {
+         fwrite( text, 1, length, output->file );
+         output->last_ch = text[ length - 1 ];
+         return;
+      }
+   }
+   memcpy( output->buffer + output->length, text, length );
+   output->length += length;
+   output->last_ch = text[ length - 1 ];
+}
+
+static void write_str( struct output* output, const char* text ) {
+   write_text( output, text, strlen( text ) );
+}
+
+static void flush_output( struct output* output ) {
+   fwrite( output->buffer, 1, output->length, output->file );
+   output->length = 0;
+}
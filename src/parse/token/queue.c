@@ -1,53 +1,67 @@
 #include "../phase.h"
 
+enum { INITIAL_QUEUE_CAPACITY = 16 };
+
+static void grow_queue( struct token_queue* queue );
+
 void p_init_token_queue( struct token_queue* queue, bool stream ) {
-   queue->head = NULL;
-   queue->tail = NULL;
-   queue->prev_entry = NULL;
+   queue->tokens = NULL;
+   queue->prev_token = NULL;
+   queue->capacity = 0;
+   queue->head = 0;
    queue->size = 0;
    queue->stream = stream;
 }
 
-struct queue_entry* p_push_entry( struct parse* parse,
-   struct token_queue* queue ) {
-   // Allocate an entry.
-   struct queue_entry* entry;
-   if ( parse->tkque_free_entry ) {
-      entry = parse->tkque_free_entry;
-      parse->tkque_free_entry = entry->next;
-   }
-   else {
-      entry = mem_alloc( sizeof( *entry ) );
+void p_deinit_token_queue( struct token_queue* queue ) {
+   if ( queue->tokens ) {
+      mem_free( queue->tokens );
+      queue->tokens = NULL;
    }
-   // Initialize necessary fields of the entry.
-   entry->next = NULL;
-   entry->token_allocated = false;
-   // Append the entry.
-   if ( queue->head ) {
-      queue->tail->next = entry;
-   }
-   else {
-      queue->head = entry;
+}
+
+// Allocates a token and appends it to the queue. The fields of the token are
+// not initialized.
+struct token* p_push_token( struct parse* parse, struct token_queue* queue ) {
+   if ( queue->size == queue->capacity ) {
+      grow_queue( queue );
    }
-   queue->tail = entry;
+   struct token* token = p_alloc_token( parse );
+   queue->tokens[ ( queue->head + queue->size ) &
+      ( queue->capacity - 1 ) ] = token;
    ++queue->size;
-   return entry;
+   return token;
 }
 
-struct token* p_shift_entry( struct parse* parse,
-   struct token_queue* queue ) {
-   // Free previous entry.
-   if ( queue->prev_entry ) {
-      struct queue_entry* entry = queue->prev_entry;
-      entry->next = parse->tkque_free_entry;
-      parse->tkque_free_entry = entry;
-      if ( entry->token_allocated ) {
-         p_free_token( parse, entry->token );
-      }
+// The tokens are moved so the head of the queue is at the start of the new
+// buffer.
+static void grow_queue( struct token_queue* queue ) {
+   int capacity = queue->capacity > 0 ?
+      queue->capacity * 2 : INITIAL_QUEUE_CAPACITY;
+   struct token** tokens = mem_arena_alloc( MEM_ARENA_TRANSIENT,
+      sizeof( *tokens ) * capacity );
+   for ( int i = 0; i < queue->size; ++i ) {
+      tokens[ i ] = p_get_queued_token( queue, i );
    }
-   struct queue_entry* entry = queue->head;
-   queue->head = entry->next;
-   queue->prev_entry = entry;
+   p_deinit_token_queue( queue );
+   queue->tokens = tokens;
+   queue->capacity = capacity;
+   queue->head = 0;
+}
+
+struct token* p_shift_token( struct parse* parse, struct token_queue* queue ) {
+   // Free previous token.
+   if ( queue->prev_token ) {
+      p_free_token( parse, queue->prev_token );
+   }
+   struct token* token = queue->tokens[ queue->head ];
+   queue->head = ( queue->head + 1 ) & ( queue->capacity - 1 );
+   queue->prev_token = token;
    --queue->size;
-   return entry->token;
+   return token;
+}
+
+// Returns the token at the specified position from the head of the queue.
+struct token* p_get_queued_token( struct token_queue* queue, int index ) {
+   return queue->tokens[ ( queue->head + index ) & ( queue->capacity - 1 ) ];
 }
@@ -2,6 +2,11 @@
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <time.h>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "../phase.h"
@@ -9,6 +14,18 @@
 enum { LINE_OFFSET = 1 };
 enum { ACC_EOF_CHARACTER = 127 };
 
+// A run is a sequence of characters that the lexer consumes without looking
+// at each one individually. None of the characters of a run need special
+// handling by read_ch(), so the backslash, the carriage return, the newline
+// character, and the tab character are never part of a run.
+enum run {
+   RUN_SPACE = 0x1,
+   RUN_ID = 0x2,
+   RUN_STRING = 0x4,
+   RUN_COMMENT = 0x8,
+   RUN_MULTILINE_COMMENT = 0x10
+};
+
 struct request {
    const char* given_path;
    struct file_entry* file;
@@ -17,10 +34,14 @@ struct request {
    bool err_open;
    bool err_loading;
    bool err_loaded_before;
+   bool guarded;
    bool implicit_bcs_ext;
+   // The header can be restored from the cache, or recorded for it.
+   bool header;
+   bool restored;
+   int line;
 };
 
-static void append_file( struct library* lib, struct file_entry* file );
 static void init_request( struct request* request,
    struct file_entry* offset_file, const char* path );
 static void init_request_module( struct request* request,
@@ -29,9 +50,11 @@ static void check_implicit_ext( struct parse* parse, struct request* request );
 static void load_source( struct parse* parse, struct request* request );
 static void find_source( struct parse* parse, struct request* request );
 static bool source_loading( struct parse* parse, struct request* request );
+static bool source_guarded( struct parse* parse, struct request* request );
 static void load_module( struct parse* parse, struct request* request );
 static void open_source_file( struct parse* parse, struct request* request );
 static struct source* alloc_source( struct parse* parse );
+static void read_contents( struct parse* parse, struct source* source );
 static void reset_filepos( struct source* source );
 static void create_entry( struct parse* parse, struct request* request,
    bool imported );
@@ -40,6 +63,11 @@ static void create_include_history_entry_imported( struct parse* parse,
    struct import_dirc* dirc );
 static void escape_ch( struct parse* parse, char*, struct str* text, bool );
 static char read_ch( struct parse* parse );
+static char read_special_ch( struct parse* parse );
+static char read_run( struct parse* parse, enum run run, struct str* text );
+static char* find_run_end( char* pos, char* end, enum run run );
+static char* find_long_run_end( char* pos, char* end, enum run run );
+static void refill_buffer( struct parse* parse );
 static char peek_ch( struct parse* parse );
 static void read_initial_ch( struct parse* parse );
 static struct str* temp_text( struct parse* parse );
@@ -53,7 +81,7 @@ void p_load_main_source( struct parse* parse ) {
    if ( request.source ) {
       parse->lib->file = request.file;
       parse->lib->file_pos.id = request.file->id;
-      append_file( parse->lib, request.file );
+      p_append_file( parse->lib, request.file );
       create_entry( parse, &request, false );
       create_include_history_entry( parse, 0 );
       t_update_err_file_dir( parse->task, request.file->full_path.value );
@@ -74,7 +102,7 @@ void p_load_imported_lib_source( struct parse* parse, struct import_dirc* dirc,
    if ( request.source ) {
       parse->lib->file = file;
       parse->lib->file_pos.id = file->id;
-      append_file( parse->lib, file );
+      p_append_file( parse->lib, file );
       create_entry( parse, &request, true );
       create_include_history_entry_imported( parse, dirc );
    }
@@ -99,14 +127,28 @@ void p_load_included_source( struct parse* parse, const char* file_path,
    struct request request;
    init_request( &request, parse->source->file, file_path );
    check_implicit_ext( parse, &request );
+   request.header = p_can_snapshot_header( parse );
+   request.line = pos->line;
    load_source( parse, &request );
    if ( request.source ) {
-      append_file( parse->lib, request.file );
+      p_append_file( parse->lib, request.file );
       create_entry( parse, &request, false );
       create_include_history_entry( parse, pos->line );
       p_define_included_macro( parse );
+      parse->source_entry->prev_tk = TK_NL;
+      if ( request.header ) {
+         p_record_header( parse );
+      }
    }
-   else {
+   // The contents of a file whose include guard is defined are skipped, so
+   // the file does not need to be read again.
+   else if ( request.guarded ) {
+      p_append_file( parse->lib, request.file );
+      parse->included_lines += request.file->lines;
+   }
+   // The tokens of a header restored from the cache are already queued for
+   // the parser.
+   else if ( ! request.restored ) {
       if ( request.err_loading ) {
          p_diag( parse, DIAG_POS_ERR, pos,
             "file already being loaded" );
@@ -118,7 +160,6 @@ void p_load_included_source( struct parse* parse, const char* file_path,
          p_bail( parse );
       }
    }
-   parse->source_entry->prev_tk = TK_NL;
    // A common mistake is for the user to #include the zcommon.acs file
    // multiple times. Error out when this happens.
    if ( strcmp( file_path, "zcommon.acs" ) == 0 ) {
@@ -136,7 +177,7 @@ void p_load_included_source( struct parse* parse, const char* file_path,
    }
 }
 
-static void append_file( struct library* lib, struct file_entry* file ) {
+void p_append_file( struct library* lib, struct file_entry* file ) {
    struct list_iter i;
    list_iterate( &lib->files, &i );
    while ( ! list_end( &i ) ) {
@@ -156,8 +197,12 @@ static void init_request( struct request* request,
    request->source = NULL;
    request->err_open = false;
    request->err_loaded_before = false;
+   request->guarded = false;
    request->err_loading = false;
    request->implicit_bcs_ext = false;
+   request->header = false;
+   request->restored = false;
+   request->line = 0;
 }
 
 static void init_request_module( struct request* request,
@@ -175,11 +220,18 @@ static void check_implicit_ext( struct parse* parse, struct request* request ) {
 static void load_source( struct parse* parse, struct request* request ) {
    find_source( parse, request );
    if ( request->file ) {
-      if ( ! source_loading( parse, request ) ) {
-         open_source_file( parse, request );
+      if ( source_loading( parse, request ) ) {
+         request->err_loading = true;
+      }
+      else if ( source_guarded( parse, request ) ) {
+         request->guarded = true;
+      }
+      else if ( request->header && p_restore_header( parse, request->file,
+         request->line ) ) {
+         request->restored = true;
       }
       else {
-         request->err_loading = true;
+         open_source_file( parse, request );
       }
    }
    else {
@@ -225,6 +277,11 @@ static bool source_loading( struct parse* parse, struct request* request ) {
    return ( entry != NULL );
 }
 
+static bool source_guarded( struct parse* parse, struct request* request ) {
+   return ( request->file->guard &&
+      p_is_macro_defined( parse, request->file->guard ) );
+}
+
 static void load_module( struct parse* parse, struct request* request ) {
    open_source_file( parse, request );
 }
@@ -242,6 +299,7 @@ static void open_source_file( struct parse* parse, struct request* request ) {
    source->fh = fh;
    source->prev = NULL;
    request->source = source;
+   read_contents( parse, source );
 }
 
 static struct source* alloc_source( struct parse* parse ) {
@@ -252,18 +310,57 @@ static struct source* alloc_source( struct parse* parse ) {
       parse->free_source = source->prev;
    }
    else {
-      source = mem_alloc( sizeof( *source ) );
+      source = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *source ) );
    }
    // Initialize with default values.
    source->file = NULL;
    source->fh = NULL;
    source->prev = NULL;
    reset_filepos( source );
+   source->tokens = 0;
    source->ch = '\0';
-   source->buffer_pos = SOURCE_BUFFER_SIZE;
+   source->contents = NULL;
+   source->pos = source->buffer + SOURCE_BUFFER_SIZE;
+   source->end = source->buffer + SOURCE_BUFFER_SIZE - SOURCE_LOOKAHEAD;
    return source;
 }
 
+// Reads the whole file into memory. A file whose size cannot be determined,
+// like a pipe, is left to be read in chunks.
+static void read_contents( struct parse* parse, struct source* source ) {
+   if ( fseek( source->fh, 0, SEEK_END ) != 0 ) {
+      return;
+   }
+   long size = ftell( source->fh );
+   if ( size < 0 || fseek( source->fh, 0, SEEK_SET ) != 0 ) {
+      return;
+   }
+   // Plus one for the implicit newline character. The null characters that
+   // follow the file allow read_ch() to look ahead without checking the end.
+   char* contents = mem_arena_alloc( MEM_ARENA_TRANSIENT,
+      size + 1 + SOURCE_LOOKAHEAD );
+   size_t count = fread( contents, sizeof( contents[ 0 ] ), size,
+      source->fh );
+   if ( count != ( size_t ) size && ferror( source->fh ) != 0 ) {
+      p_diag( parse, DIAG_ERR,
+         "failed to read file: %s (%s)",
+         source->file->full_path.value, strerror( errno ) );
+      p_bail( parse );
+   }
+   // Every line must be terminated by a newline character. If the end of the
+   // file is not a newline character, implicitly generate one. For empty
+   // files, this is not needed.
+   if ( count > 0 && contents[ count - 1 ] != '\n' ) {
+      contents[ count ] = '\n';
+      ++count;
+   }
+   memset( contents + count, '\0', SOURCE_LOOKAHEAD );
+   parse->stats.bytes += count;
+   source->contents = contents;
+   source->pos = contents;
+   source->end = contents + count;
+}
+
 static void reset_filepos( struct source* source ) {
    source->line = LINE_OFFSET;
    source->column = 0;
@@ -277,7 +374,7 @@ static void create_entry( struct parse* parse, struct request* request,
       parse->source_entry_free = entry->prev;
    }
    else {
-      entry = mem_alloc( sizeof( *entry ) );
+      entry = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *entry ) );
    }
    entry->prev = parse->source_entry;
    entry->source = request->source;
@@ -285,6 +382,8 @@ static void create_entry( struct parse* parse, struct request* request,
    p_init_token_queue( &entry->peeked, false );
    entry->main = ( entry->prev == NULL );
    entry->imported = imported;
+   entry->guard.name = NULL;
+   entry->guard.state = GUARD_UNKNOWN;
    entry->prev_tk = TK_NL;
    entry->line_beginning = true;
    parse->source_entry = entry;
@@ -334,11 +433,21 @@ void p_pop_source( struct parse* parse ) {
    struct source_entry* entry = parse->source_entry;
    struct source* source = entry->source;
    fclose( source->fh );
+   if ( source->contents ) {
+      mem_free( source->contents );
+      source->contents = NULL;
+   }
    if ( entry->main ) {
       parse->main_lib_lines = source->line - LINE_OFFSET;
    }
    else {
       parse->included_lines += source->line - LINE_OFFSET;
+      // Nothing must follow the #endif directive of the include guard.
+      if ( ! entry->imported && entry->guard.state == GUARD_CLOSED &&
+         entry->guard.tokens == source->tokens ) {
+         source->file->guard = entry->guard.name;
+         source->file->lines = source->line - LINE_OFFSET;
+      }
    }
    source->prev = parse->free_source;
    parse->free_source = source;
@@ -350,6 +459,7 @@ void p_pop_source( struct parse* parse ) {
       parse->macro_expan = parse->source_entry->macro_expan;
       parse->tkque = &parse->source_entry->peeked;
       // Free entry.
+      p_deinit_token_queue( &entry->peeked );
       entry->prev = parse->source_entry_free;
       parse->source_entry_free = entry;
       // We are now back to the library file. Remove the __INCLUDED__ macro.
@@ -362,6 +472,9 @@ void p_pop_source( struct parse* parse ) {
    if ( parse->include_history_entry ) {
       parse->include_history_entry = parse->include_history_entry->parent;
    }
+   if ( parse->header_recording ) {
+      p_finish_header( parse, entry );
+   }
 }
 
 void p_read_source( struct parse* parse, struct token* token ) {
@@ -389,7 +502,7 @@ void p_read_source( struct parse* parse, struct token* token ) {
    line = parse->source->line;
    column = parse->source->column;
    while ( ch == ' ' || ch == '\t' ) {
-      ch = read_ch( parse );
+      ch = read_run( parse, RUN_SPACE, NULL );
    }
    length = parse->source->column - column;
    tk = TK_HORZSPACE;
@@ -733,14 +846,13 @@ void p_read_source( struct parse* parse, struct token* token ) {
    identifier:
    // -----------------------------------------------------------------------
    {
-      int length = 0;
       text = temp_text( parse );
       while ( isalnum( ch ) || ch == '_' ) {
          append_ch( text, ch );
-         ch = read_ch( parse );
-         ++length;
+         ch = read_run( parse, RUN_ID, text );
       }
-      if ( strcmp( text->value, "__VA_ARGS__" ) == 0 &&
+      if ( text->length == 11 && text->value[ 0 ] == '_' &&
+         memcmp( text->value, "__VA_ARGS__", 11 ) == 0 &&
          ! parse->variadic_macro_context ) {
          struct pos pos;
          t_init_pos( &pos,
@@ -1109,7 +1221,7 @@ void p_read_source( struct parse* parse, struct token* token ) {
       }
       else {
          append_string_ch( text, ch );
-         ch = read_ch( parse );
+         ch = read_run( parse, RUN_STRING, text );
       }
    }
 
@@ -1165,7 +1277,7 @@ void p_read_source( struct parse* parse, struct token* token ) {
    comment:
    // -----------------------------------------------------------------------
    while ( ch && ch != '\n' ) {
-      ch = read_ch( parse );
+      ch = read_run( parse, RUN_COMMENT, NULL );
    }
    goto whitespace;
 
@@ -1187,29 +1299,30 @@ void p_read_source( struct parse* parse, struct token* token ) {
          }
       }
       else {
-         ch = read_ch( parse );
+         ch = read_run( parse, RUN_MULTILINE_COMMENT, NULL );
       }
    }
 
    finish:
    // -----------------------------------------------------------------------
+   if ( tk != TK_HORZSPACE && tk != TK_NL && tk != TK_END ) {
+      ++parse->source->tokens;
+      ++parse->stats.tokens;
+   }
    token->type = tk;
    if ( text != NULL ) {
-      token->modifiable_text = t_intern_text( parse->task, text->value,
+      token->text = t_intern_text_offset( parse->task, text->value,
          text->length );
-      token->text = token->modifiable_text;
       token->length = text->length;
    }
    else {
       const struct token_info* info = p_get_token_info( tk );
-      token->modifiable_text = NULL;
-      token->text = info->shared_text;
+      token->text = parse->token_texts[ tk ];
       token->length = ( length > 0 ) ?
          length : info->length;
    }
-   token->pos.line = line;
-   token->pos.column = column;
-   token->pos.id = parse->source->file_entry_id;
+   struct pos pos = { line, column, parse->source->file_entry_id };
+   token->pos = p_pack_pos( &pos );
    token->next = NULL;
 }
 
@@ -1231,48 +1344,41 @@ static char read_ch( struct parse* parse ) {
    else {
       ++source->column;
    }
-   // Read character.
-   enum { LOOKAHEAD_AMOUNT = 3 };
-   enum { SAFE_AMOUNT = SOURCE_BUFFER_SIZE - LOOKAHEAD_AMOUNT };
-   if ( source->buffer_pos >= SAFE_AMOUNT ) {
-      size_t unread = SOURCE_BUFFER_SIZE - source->buffer_pos;
-      memcpy( source->buffer, source->buffer + source->buffer_pos, unread );
-      size_t count = fread( source->buffer + unread,
-         sizeof( source->buffer[ 0 ] ), SOURCE_BUFFER_SIZE - unread,
-         source->fh );
-      if ( count != SOURCE_BUFFER_SIZE - unread &&
-         ferror( source->fh ) != 0 ) {
-         p_diag( parse, DIAG_ERR,
-            "failed to read file: %s (%s)",
-            parse->source->file->full_path.value, strerror( errno ) );
-         p_bail( parse );
-      }
-      // Every line must be terminated by a newline character. If the end of
-      // the file is not a newline character, implicitly generate one. For
-      // empty files, this is not needed.
-      if ( count < SOURCE_BUFFER_SIZE - unread && unread + count > 0 &&
-         source->buffer[ unread + count - 1 ] != '\n' ) {
-         source->buffer[ unread + count ] = '\n';
-         source->buffer[ unread + count + 1 ] = '\0';
+   // Ordinary character.
+   if ( source->pos < source->end ) {
+      char ch = *source->pos;
+      if ( ch != '\\' && ch != '\r' ) {
+         ++source->pos;
+         source->ch = ch;
+         return ch;
       }
-      else {
-         source->buffer[ unread + count ] = '\0';
+   }
+   return read_special_ch( parse );
+}
+
+// Handles the end of the buffer, line concatenation, and the Windows newline
+// character.
+static char read_special_ch( struct parse* parse ) {
+   struct source* source = parse->source;
+   if ( source->pos >= source->end ) {
+      if ( source->contents ) {
+         source->ch = '\0';
+         return '\0';
       }
-      source->buffer_pos = 0;
+      refill_buffer( parse );
    }
    // Line concatenation.
-   while ( source->buffer[ source->buffer_pos ] == '\\' ) {
+   while ( source->pos[ 0 ] == '\\' ) {
       // Linux newline character.
-      if ( source->buffer[ source->buffer_pos + 1 ] == '\n' ) {
-         source->buffer_pos += 2;
+      if ( source->pos[ 1 ] == '\n' ) {
+         source->pos += 2;
          ++source->line;
          source->column = 0;
          ++parse->line;
       }
       // Windows newline character.
-     else if ( source->buffer[ source->buffer_pos + 1 ] == '\r' &&
-         source->buffer[ source->buffer_pos + 2 ] == '\n' ) {
-         source->buffer_pos += 3;
+      else if ( source->pos[ 1 ] == '\r' && source->pos[ 2 ] == '\n' ) {
+         source->pos += 3;
          ++source->line;
          source->column = 0;
          ++parse->line;
@@ -1282,22 +1388,206 @@ static char read_ch( struct parse* parse ) {
       }
    }
    // Process character.
-   char ch = source->buffer[ source->buffer_pos ];
-   if ( ch == '\r' && source->buffer[ source->buffer_pos + 1 ] == '\n' ) {
+   char ch = source->pos[ 0 ];
+   if ( ch == '\r' && source->pos[ 1 ] == '\n' ) {
       // Replace the two-character Windows newline with a single-character
       // newline to simplify things.
       ch = '\n';
-      source->buffer_pos += 2;
+      source->pos += 2;
    }
    else {
-      ++source->buffer_pos;
+      ++source->pos;
    }
    source->ch = ch;
    return ch;
 }
 
+static void refill_buffer( struct parse* parse ) {
+   struct source* source = parse->source;
+   size_t unread = source->buffer + SOURCE_BUFFER_SIZE - source->pos;
+   memmove( source->buffer, source->pos, unread );
+   size_t count = fread( source->buffer + unread,
+      sizeof( source->buffer[ 0 ] ), SOURCE_BUFFER_SIZE - unread,
+      source->fh );
+   if ( count != SOURCE_BUFFER_SIZE - unread &&
+      ferror( source->fh ) != 0 ) {
+      p_diag( parse, DIAG_ERR,
+         "failed to read file: %s (%s)",
+         parse->source->file->full_path.value, strerror( errno ) );
+      p_bail( parse );
+   }
+   parse->stats.bytes += count;
+   // Every line must be terminated by a newline character. If the end of
+   // the file is not a newline character, implicitly generate one. For
+   // empty files, this is not needed.
+   if ( count < SOURCE_BUFFER_SIZE - unread && unread + count > 0 &&
+      source->buffer[ unread + count - 1 ] != '\n' ) {
+      source->buffer[ unread + count ] = '\n';
+      source->buffer[ unread + count + 1 ] = '\0';
+   }
+   else {
+      source->buffer[ unread + count ] = '\0';
+   }
+   source->pos = source->buffer;
+}
+
+// Reads the run of characters that follows the current character, and then
+// reads the character after the run. The characters of the run are appended to
+// the text, if one is given. Since the run contains no tabs or newline
+// characters, the column of each character is one more than the column of the
+// previous character, so the file position is updated once for the whole run.
+static char read_run( struct parse* parse, enum run run, struct str* text ) {
+   struct source* source = parse->source;
+   if ( source->ch != '\t' && source->ch != '\n' ) {
+      char* run_end = find_run_end( source->pos, source->end, run );
+      if ( run_end > source->pos ) {
+         int length = run_end - source->pos;
+         if ( text ) {
+            str_append_sub( text, source->pos, length );
+         }
+         source->column += length;
+         source->ch = run_end[ -1 ];
+         source->pos = run_end;
+      }
+   }
+   return read_ch( parse );
+}
+
+// The runs that each character can be a part of, indexed by the character.
+static const unsigned char run_table[ 256 ] = {
+   0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+   0x18, 0x00, 0x00, 0x18, 0x18, 0x00, 0x18, 0x18,
+   0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+   0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18,
+   0x1D, 0x1C, 0x18, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x0C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1C, 0x00, 0x1C, 0x1C, 0x1E,
+   0x1C, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E,
+   0x1E, 0x1E, 0x1E, 0x1C, 0x1C, 0x1C, 0x1C, 0x18,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+   0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C,
+};
+
+static char* find_run_end( char* pos, char* end, enum run run ) {
+   // Most runs are short, so look at the characters one at a time first.
+   char* short_end = ( end - pos > 16 ) ? pos + 16 : end;
+   while ( pos < short_end && ( run_table[ ( unsigned char ) *pos ] & run ) ) {
+      ++pos;
+   }
+   if ( pos < short_end || pos == end ) {
+      return pos;
+   }
+   return find_long_run_end( pos, end, run );
+}
+
+#if defined( __SSE2__ )
+
+// Looks at sixteen characters at a time. The comparisons are of signed bytes,
+// so characters with the high bit set are treated as negative numbers.
+static char* find_long_run_end( char* pos, char* end, enum run run ) {
+   const __m128i zero = _mm_setzero_si128();
+   while ( end - pos >= 16 ) {
+      __m128i chars = _mm_loadu_si128( ( const __m128i* ) pos );
+      __m128i match;
+      switch ( run ) {
+      case RUN_SPACE:
+         match = _mm_cmpeq_epi8( chars, _mm_set1_epi8( ' ' ) );
+         break;
+      case RUN_ID:
+         {
+            __m128i lower = _mm_or_si128( chars, _mm_set1_epi8( 0x20 ) );
+            match = _mm_or_si128(
+               _mm_or_si128(
+                  _mm_and_si128(
+                     _mm_cmpgt_epi8( chars, _mm_set1_epi8( '0' - 1 ) ),
+                     _mm_cmplt_epi8( chars, _mm_set1_epi8( '9' + 1 ) ) ),
+                  _mm_and_si128(
+                     _mm_cmpgt_epi8( lower, _mm_set1_epi8( 'a' - 1 ) ),
+                     _mm_cmplt_epi8( lower, _mm_set1_epi8( 'z' + 1 ) ) ) ),
+               _mm_cmpeq_epi8( chars, _mm_set1_epi8( '_' ) ) );
+         }
+         break;
+      case RUN_STRING:
+         {
+            __m128i printable = _mm_or_si128(
+               _mm_cmpgt_epi8( chars, _mm_set1_epi8( ' ' - 1 ) ),
+               _mm_cmplt_epi8( chars, zero ) );
+            __m128i special = _mm_or_si128(
+               _mm_or_si128(
+                  _mm_cmpeq_epi8( chars, _mm_set1_epi8( '"' ) ),
+                  _mm_cmpeq_epi8( chars, _mm_set1_epi8( '\\' ) ) ),
+               _mm_cmpeq_epi8( chars, _mm_set1_epi8( ACC_EOF_CHARACTER ) ) );
+            match = _mm_andnot_si128( special, printable );
+         }
+         break;
+      default:
+         {
+            __m128i special = _mm_or_si128(
+               _mm_or_si128(
+                  _mm_or_si128( _mm_cmpeq_epi8( chars, zero ),
+                     _mm_cmpeq_epi8( chars, _mm_set1_epi8( '\n' ) ) ),
+                  _mm_or_si128(
+                     _mm_cmpeq_epi8( chars, _mm_set1_epi8( '\r' ) ),
+                     _mm_cmpeq_epi8( chars, _mm_set1_epi8( '\t' ) ) ) ),
+               _mm_cmpeq_epi8( chars, _mm_set1_epi8( '\\' ) ) );
+            if ( run == RUN_MULTILINE_COMMENT ) {
+               special = _mm_or_si128( special,
+                  _mm_cmpeq_epi8( chars, _mm_set1_epi8( '*' ) ) );
+            }
+            match = _mm_cmpeq_epi8( special, zero );
+         }
+         break;
+      }
+      unsigned int mask = ( unsigned int ) _mm_movemask_epi8( match );
+      if ( mask != 0xFFFF ) {
+         while ( mask & 1 ) {
+            mask >>= 1;
+            ++pos;
+         }
+         return pos;
+      }
+      pos += 16;
+   }
+   while ( pos < end && ( run_table[ ( unsigned char ) *pos ] & run ) ) {
+      ++pos;
+   }
+   return pos;
+}
+
+#else
+
+static char* find_long_run_end( char* pos, char* end, enum run run ) {
+   while ( pos < end && ( run_table[ ( unsigned char ) *pos ] & run ) ) {
+      ++pos;
+   }
+   return pos;
+}
+
+#endif
+
 static char peek_ch( struct parse* parse ) {
-   return parse->source->buffer[ parse->source->buffer_pos ];
+   return *parse->source->pos;
 }
 
 static void read_initial_ch( struct parse* parse ) {
@@ -1446,8 +1736,13 @@ static struct str* temp_text( struct parse* parse ) {
 }
 
 static void append_ch( struct str* str, char ch ) {
-   char segment[ 2 ] = { ch, '\0' };
-   str_append( str, segment );
+   if ( str->length + 2 > str->buffer_length ) {
+      str_grow( str, ( str->buffer_length > 0 ) ?
+         str->buffer_length * 2 : 32 );
+   }
+   str->value[ str->length ] = ch;
+   ++str->length;
+   str->value[ str->length ] = '\0';
 }
 
 #if CHAR_MIN == 0
@@ -1464,6 +1759,136 @@ static void append_string_ch( struct str* text, char ch ) {
 
 #endif
 
+// Skips the text of an inactive section of an if-directive, up to the `#` that
+// begins the next line that could hold a directive, or up to the end of the
+// file. Only comments and string and character literals are recognized, since
+// a `#` inside them does not begin a directive. The text is not checked for
+// errors.
+void p_skip_section_text( struct parse* parse ) {
+   char ch = parse->source->ch;
+   bool line_beginning = true;
+   while ( true ) {
+      switch ( ch ) {
+      case '\0':
+         return;
+      case '#':
+         if ( line_beginning ) {
+            return;
+         }
+         ch = read_ch( parse );
+         break;
+      case '\n':
+         line_beginning = true;
+         ch = read_ch( parse );
+         break;
+      case ' ':
+      case '\t':
+         ch = read_run( parse, RUN_SPACE, NULL );
+         break;
+      case '/':
+         ch = read_ch( parse );
+         if ( ch == '/' ) {
+            while ( ch && ch != '\n' ) {
+               ch = read_run( parse, RUN_COMMENT, NULL );
+            }
+         }
+         else if ( ch == '*' ) {
+            ch = read_ch( parse );
+            while ( ch ) {
+               if ( ch == '*' ) {
+                  ch = read_ch( parse );
+                  if ( ch == '/' ) {
+                     ch = read_ch( parse );
+                     break;
+                  }
+               }
+               else {
+                  ch = read_run( parse, RUN_MULTILINE_COMMENT, NULL );
+               }
+            }
+         }
+         else {
+            line_beginning = false;
+         }
+         break;
+      case '"':
+         ch = read_ch( parse );
+         while ( ch && ch != '"' ) {
+            if ( ch == '\\' ) {
+               ch = read_ch( parse );
+               if ( ch ) {
+                  ch = read_ch( parse );
+               }
+            }
+            else {
+               ch = read_run( parse, RUN_STRING, NULL );
+            }
+         }
+         if ( ch == '"' ) {
+            ch = read_ch( parse );
+         }
+         line_beginning = false;
+         break;
+      case '\'':
+         ch = read_ch( parse );
+         if ( ch == '\\' ) {
+            ch = read_ch( parse );
+            if ( ch ) {
+               ch = read_ch( parse );
+            }
+         }
+         else if ( ch && ch != '\n' && ch != '\'' ) {
+            ch = read_ch( parse );
+         }
+         if ( ch == '\'' ) {
+            ch = read_ch( parse );
+         }
+         line_beginning = false;
+         break;
+      default:
+         if ( isalnum( ch ) || ch == '_' ) {
+            // In a number, a single quotation mark is a digit separator.
+            bool number = isdigit( ch );
+            while ( isalnum( ch ) || ch == '_' ||
+               ( number && ch == '\'' ) ) {
+               ch = read_run( parse, RUN_ID, NULL );
+            }
+         }
+         else {
+            ch = read_ch( parse );
+         }
+         line_beginning = false;
+         break;
+      }
+   }
+}
+
+// Reads the tokens of the main source file, without executing directives or
+// expanding macros. When the file is in memory, it is read repeatedly, for at
+// least a second, to get a stable measurement. Returns the number of times the
+// file was read.
+int p_bench_lexer( struct parse* parse ) {
+   struct source* source = parse->source;
+   struct token token;
+   clock_t start = clock();
+   int passes = 0;
+   while ( true ) {
+      do {
+         p_read_source( parse, &token );
+      } while ( token.type != TK_END );
+      ++passes;
+      if ( ! ( source->contents && clock() - start < CLOCKS_PER_SEC ) ) {
+         break;
+      }
+      // Start over.
+      source->pos = source->contents;
+      source->ch = '\0';
+      read_initial_ch( parse );
+      parse->stats.bytes += source->end - source->contents;
+   }
+   return passes;
+}
+
 void p_increment_pos( struct pos* pos, enum tk tk ) {
    switch ( tk ) {
    case TK_BRACE_R:
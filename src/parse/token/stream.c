@@ -34,6 +34,7 @@ struct macro_arg {
 
 static void read_peeked_token( struct parse* parse );
 static void read_token( struct parse* parse, struct token* token );
+static bool start_expan( struct parse* parse, struct macro* macro );
 static void free_expan( struct parse* parse, struct macro_expan* expan );
 static struct macro_expan* alloc_expan( struct parse* parse );
 static void init_macro_expan( struct macro_expan* expan,
@@ -62,6 +63,8 @@ static void expand_predef_date( struct parse* parse,
    struct macro_expan* expan );
 static void expand_predef_imported( struct parse* parse,
    struct macro_expan* expan );
+static void expand_object_macro( struct parse* parse,
+   struct macro_expan* expan );
 static void expand_macro( struct parse* parse,
    struct macro_expan* expan );
 static void expand_id( struct parse* parse, struct macro_expan* expan );
@@ -71,7 +74,7 @@ static void stringize( struct parse* parse, struct macro_expan* expan );
 static bool expand_param( struct parse* parse, struct macro_expan* expan );
 static bool expand_nested_macro( struct parse* parse,
    struct macro_expan* expan );
-static void output_expan( struct macro_expan* expan,
+static void output_expan( struct parse* parse, struct macro_expan* expan,
    struct macro_expan* other_expan );
 static void output( struct parse* parse, struct macro_expan* expan,
    struct token* token );
@@ -89,7 +92,8 @@ void p_init_stream( struct parse* parse ) {
    parse->tk_text = "";
    parse->tk_length = 0;
    parse->token_free = NULL;
-   parse->tkque_free_entry = NULL;
+   parse->token_slab = NULL;
+   parse->token_slab_left = 0;
    parse->source_token = &parse->token_source;
    parse->tkque = NULL;
    p_init_token_queue( &parse->parser_tkque, false );
@@ -112,7 +116,7 @@ void p_read_stream( struct parse* parse ) {
 
 static void read_peeked_token( struct parse* parse ) {
    if ( parse->tkque->size > 0 ) {
-      parse->token = p_shift_entry( parse, parse->tkque );
+      parse->token = p_shift_token( parse, parse->tkque );
    }
    else {
       parse->token = &parse->token_source;
@@ -128,7 +132,7 @@ static void read_token( struct parse* parse, struct token* token ) {
    while ( parse->macro_expan ) {
       if ( parse->macro_expan->output ) {
          token[ 0 ] = parse->macro_expan->output[ 0 ];
-         token->pos = parse->macro_expan->pos;
+         token->pos = p_pack_pos( &parse->macro_expan->pos );
          parse->macro_expan->output = token->next;
          if ( token->type == TK_MACRONAME ) {
             token->type = TK_ID;
@@ -142,14 +146,27 @@ static void read_token( struct parse* parse, struct token* token ) {
       }
    }
    // Read from a source file.
+   enum timer timer = t_switch_timer( parse->task, TIMER_LEX );
    p_read_source( parse, token );
+   t_switch_timer( parse->task, timer );
 }
 
 bool p_expand_macro( struct parse* parse ) {
-   struct macro* macro = p_find_macro( parse, parse->token->text );
+   struct macro* macro = p_find_macro( parse,
+      p_token_text( parse, parse->token ) );
    if ( ! macro ) {
       return false;
    }
+   enum timer timer = t_switch_timer( parse->task, TIMER_PREPROCESS );
+   bool expanded = start_expan( parse, macro );
+   if ( expanded ) {
+      ++parse->stats.macro_expansions;
+   }
+   t_switch_timer( parse->task, timer );
+   return expanded;
+}
+
+static bool start_expan( struct parse* parse, struct macro* macro ) {
    // The macro should not already be undergoing expansion.
    struct macro_expan* expan = parse->macro_expan;
    while ( expan ) {
@@ -184,7 +201,7 @@ bool p_expand_macro( struct parse* parse ) {
       expan->pos = parse->macro_expan->pos;
    }
    else {
-      expan->pos = parse->token->pos;
+      expan->pos = p_unpack_pos( parse->token->pos );
    }
    if ( macro->func_like ) {
       fill( parse, expan );
@@ -202,7 +219,7 @@ static struct macro_expan* alloc_expan( struct parse* parse ) {
       parse->macro_expan_free = expan->prev;
    }
    else {
-      expan = mem_alloc( sizeof( *expan ) );
+      expan = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *expan ) );
    }
    return expan;
 }
@@ -363,7 +380,7 @@ static void read_arg_token( struct parse* parse, struct macro_expan* expan ) {
          struct token token;
          p_init_token( &token );
          token.type = TK_HORZSPACE;
-         token.text = " ";
+         token.text = parse->space_text;
          token.length = 1;
          add_arg_token( parse, expan, &token );
       }
@@ -422,7 +439,7 @@ static struct macro_arg* alloc_arg( struct parse* parse ) {
       parse->macro_arg_free = arg->next;
    }
    else {
-      arg = mem_alloc( sizeof( *arg ) );
+      arg = mem_arena_alloc( MEM_ARENA_TRANSIENT, sizeof( *arg ) );
    }
    arg->next = NULL;
    arg->sequence = NULL;
@@ -444,11 +461,15 @@ static void append_arg( struct macro_expan* expan, struct macro_arg* arg ) {
 static void perform_expan( struct parse* parse, struct macro_expan* expan ) {
    if ( expan->macro->predef ) {
       expand_predef_macro( parse, expan );
+      expan->output = expan->output_head;
    }
-   else {
+   else if ( expan->macro->func_like ) {
       expand_macro( parse, expan );
+      expan->output = expan->output_head;
+   }
+   else {
+      expand_object_macro( parse, expan );
    }
-   expan->output = expan->output_head;
 }
 
 static void expand_predef_macro( struct parse* parse,
@@ -457,13 +478,18 @@ static void expand_predef_macro( struct parse* parse,
    case PREDEFMACRO_LINE:
       expand_predef_line( parse, expan );
       break;
+   // The values of these macros can differ when the header that uses them is
+   // #included again.
    case PREDEFMACRO_FILE:
+      p_spoil_header( parse );
       expand_predef_file( parse, expan );
       break;
    case PREDEFMACRO_TIME:
+      p_spoil_header( parse );
       expand_predef_time( parse, expan );
       break;
    case PREDEFMACRO_DATE:
+      p_spoil_header( parse );
       expand_predef_date( parse, expan );
       break;
    case PREDEFMACRO_IMPORTED:
@@ -486,9 +512,9 @@ static void expand_predef_line( struct parse* parse,
    struct token token;
    p_init_token( &token );
    token.type = TK_LIT_DECIMAL;
-   token.text = t_intern_text( parse->task, value, length );
+   token.text = t_intern_text_offset( parse->task, value, length );
    token.length = length;
-   token.pos = expan->pos;
+   token.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &token );
 }
 
@@ -502,8 +528,8 @@ static void expand_predef_file( struct parse* parse,
    p_init_token( &token );
    token.type = TK_LIT_STRING;
    token.length = strlen( file );
-   token.text = t_intern_text( parse->task, file, token.length );
-   token.pos = expan->pos;
+   token.text = t_intern_text_offset( parse->task, file, token.length );
+   token.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &token );
 }
 
@@ -518,9 +544,9 @@ static void expand_predef_time( struct parse* parse,
    struct token token;
    p_init_token( &token );
    token.type = TK_LIT_STRING;
-   token.text = t_intern_text( parse->task, value, length );
+   token.text = t_intern_text_offset( parse->task, value, length );
    token.length = length;
-   token.pos = expan->pos;
+   token.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &token );
 }
 
@@ -536,9 +562,9 @@ static void expand_predef_date( struct parse* parse,
    struct token token;
    p_init_token( &token );
    token.type = TK_LIT_STRING;
-   token.text = t_intern_text( parse->task, value, length );
+   token.text = t_intern_text_offset( parse->task, value, length );
    token.length = length;
-   token.pos = expan->pos;
+   token.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &token );
 }
 
@@ -548,12 +574,29 @@ static void expand_predef_imported( struct parse* parse,
    struct token token;
    p_init_token( &token );
    token.type = TK_LIT_DECIMAL;
-   token.text = "1";
-   token.length = strlen( token.text );
-   token.pos = expan->pos;
+   token.text = parse->one_text;
+   token.length = 1;
+   token.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &token );
 }
 
+// The expansion of an object-like macro is the same every time, so it is
+// performed only once. The output of the macro expansion is then the shared
+// list of tokens, which is not modified and is not freed with the expansion.
+static void expand_object_macro( struct parse* parse,
+   struct macro_expan* expan ) {
+   struct macro* macro = expan->macro;
+   if ( ! macro->expanded ) {
+      expand_macro( parse, expan );
+      macro->expansion = expan->output_head;
+      macro->expansion_tail = expan->output_tail;
+      macro->expanded = true;
+      expan->output_head = NULL;
+      expan->output_tail = NULL;
+   }
+   expan->output = macro->expansion;
+}
+
 static void expand_macro( struct parse* parse, struct macro_expan* expan ) {
    while ( expan->token ) {
       if ( expan->token->type == TK_ID ) {
@@ -600,7 +643,8 @@ static void expand_id( struct parse* parse, struct macro_expan* expan ) {
    if ( ( expan->token->next &&
       expan->token->next->type == TK_HASHHASH ) || (
       expan->output_tail && expan->output_tail->type == TK_HASHHASH ) ) {
-      struct macro_arg* arg = find_arg( expan, expan->token->text );
+      struct macro_arg* arg = find_arg( expan,
+         p_token_text( parse, expan->token ) );
       if ( arg ) {
          if ( arg->sequence ) {
             struct token* token = arg->sequence;
@@ -642,7 +686,8 @@ static struct macro_arg* find_arg( struct macro_expan* expan,
 }
 
 static bool expand_param( struct parse* parse, struct macro_expan* expan ) {
-   struct macro_arg* arg = find_arg( expan, expan->token->text );
+   struct macro_arg* arg = find_arg( expan,
+      p_token_text( parse, expan->token ) );
    if ( ! arg ) {
       return false;
    }
@@ -665,7 +710,8 @@ static bool expand_param( struct parse* parse, struct macro_expan* expan ) {
 
 static bool expand_nested_macro( struct parse* parse,
    struct macro_expan* expan ) {
-   struct macro* macro = p_find_macro( parse, expan->arg_token->text );
+   struct macro* macro = p_find_macro( parse,
+      p_token_text( parse, expan->arg_token ) );
    if ( ! macro ) {
       return false;
    }
@@ -690,20 +736,29 @@ static bool expand_nested_macro( struct parse* parse,
    init_macro_expan( nested_expan, expan );
    nested_expan->macro = macro;
    nested_expan->token = macro->body;
-   nested_expan->pos = expan->arg_token->pos;
+   nested_expan->pos = p_unpack_pos( expan->arg_token->pos );
    if ( macro->func_like ) {
       nested_expan->input = nested_expan->input->next;
       read_arg_list( parse, nested_expan );
    }
    perform_expan( parse, nested_expan );
-   output_expan( expan, nested_expan );
+   output_expan( parse, expan, nested_expan );
    expan->arg_token = nested_expan->input->next;
    free_expan( parse, nested_expan );
    return true;
 }
 
-static void output_expan( struct macro_expan* expan,
+static void output_expan( struct parse* parse, struct macro_expan* expan,
    struct macro_expan* other_expan ) {
+   // A shared expansion is copied.
+   if ( ! other_expan->output_head ) {
+      struct token* token = other_expan->output;
+      while ( token ) {
+         output( parse, expan, token );
+         token = token->next;
+      }
+      return;
+   }
    if ( expan->output_head ) {
       expan->output_tail->next = other_expan->output;
    }
@@ -732,19 +787,20 @@ static void output( struct parse* parse, struct macro_expan* expan,
 // `#` operator.
 static void stringize( struct parse* parse, struct macro_expan* expan ) {
    str_clear( &parse->temp_text );
-   struct macro_arg* arg = find_arg( expan, expan->token->text );
+   struct macro_arg* arg = find_arg( expan,
+      p_token_text( parse, expan->token ) );
    struct token* token = arg->sequence;
    while ( token ) {
-      str_append( &parse->temp_text, token->text );
+      str_append( &parse->temp_text, p_token_text( parse, token ) );
       token = token->next;
    }
    struct token result;
    p_init_token( &result );
    result.type = TK_LIT_STRING;
-   result.text = t_intern_text( parse->task, parse->temp_text.value,
+   result.text = t_intern_text_offset( parse->task, parse->temp_text.value,
       parse->temp_text.length );
    result.length = parse->temp_text.length;
-   result.pos = expan->pos;
+   result.pos = p_pack_pos( &expan->pos );
    output( parse, expan, &result );
 }
 
@@ -775,26 +831,25 @@ static void concat_tangible( struct parse* parse, struct macro_expan* expan,
    if ( type == TK_NONE ) {
       p_diag( parse, DIAG_POS_ERR, &expan->pos,
          "concatenating `%s` and `%s` produces an invalid token",
-         lside->text, rside->text );
+         p_token_text( parse, lside ), p_token_text( parse, rside ) );
       p_bail( parse );
    }
    struct token token;
    p_init_token( &token );
    token.type = type;
    token.next = rside->next;
-   token.pos = expan->pos;
+   token.pos = p_pack_pos( &expan->pos );
    const struct token_info* info = p_get_token_info( type );
    if ( info->length > 0 ) {
-      token.text = info->shared_text;
+      token.text = parse->token_texts[ type ];
       token.length = info->length;
    }
    else {
       str_clear( &parse->temp_text );
-      str_append( &parse->temp_text, lside->text );
-      str_append( &parse->temp_text, rside->text );
-      token.modifiable_text = t_intern_text( parse->task,
+      str_append( &parse->temp_text, p_token_text( parse, lside ) );
+      str_append( &parse->temp_text, p_token_text( parse, rside ) );
+      token.text = t_intern_text_offset( parse->task,
          parse->temp_text.value, parse->temp_text.length );
-      token.text = token.modifiable_text;
       token.length = parse->temp_text.length;
    }
    p_free_token( parse, rside );
@@ -976,27 +1031,24 @@ static enum tk concat_result( enum tk lside, enum tk rside ) {
 }
 
 void p_init_streamtk_iter( struct parse* parse, struct streamtk_iter* iter ) {
-   iter->entry = parse->tkque->head;
    iter->token = NULL;
+   iter->index = 0;
 }
 
 void p_next_stream( struct parse* parse, struct streamtk_iter* iter ) {
-   if ( iter->entry ) {
-      struct queue_entry* entry = iter->entry;
-      iter->token = entry->token;
-      iter->entry = entry->next;
+   if ( iter->index < parse->tkque->size ) {
+      iter->token = p_get_queued_token( parse->tkque, iter->index );
    }
    else {
       iter->token = push_token( parse );
    }
+   ++iter->index;
 }
 
 static struct token* push_token( struct parse* parse ) {
-   struct queue_entry* entry = p_push_entry( parse, parse->tkque );
-   entry->token = p_alloc_token( parse );
-   entry->token_allocated = true;
-   read_token( parse, entry->token );
-   return entry->token;
+   struct token* token = p_push_token( parse, parse->tkque );
+   read_token( parse, token );
+   return token;
 }
 
 // NOTE: Does not initialize fields.
@@ -1007,7 +1059,16 @@ struct token* p_alloc_token( struct parse* parse ) {
       parse->token_free = token->next;
    }
    else {
-      token = mem_alloc( sizeof( *token ) );
+      // When no more tokens are left, allocate a series of tokens in a single
+      // allocation.
+      if ( ! parse->token_slab_left ) {
+         parse->token_slab = mem_arena_alloc( MEM_ARENA_TRANSIENT,
+            sizeof( *parse->token_slab ) * TOKEN_SLAB_SIZE );
+         parse->token_slab_left = TOKEN_SLAB_SIZE;
+      }
+      token = parse->token_slab;
+      ++parse->token_slab;
+      --parse->token_slab_left;
    }
    token->next = NULL;
    return token;
@@ -1015,9 +1076,11 @@ struct token* p_alloc_token( struct parse* parse ) {
 
 void p_init_token( struct token* token ) {
    token->next = NULL;
-   token->modifiable_text = NULL;
-   token->text = "";
-   t_init_pos_id( &token->pos, INTERNALFILE_COMPILER );
+   // The empty text is the first text interned, at offset zero.
+   token->text = 0;
+   struct pos pos;
+   t_init_pos_id( &pos, INTERNALFILE_COMPILER );
+   token->pos = p_pack_pos( &pos );
    token->type = TK_END;
    token->length = 0;
 }
@@ -5,7 +5,10 @@
 
 static void read_peeked_token( struct parse* parse );
 static void read_token( struct parse* parse );
+static void read_expanded_token( struct parse* parse );
 static struct token* push_token( struct parse* parse );
+static enum tk classify_id( char* text, int length );
+static enum tk find_reserved_id( const char* text, int length );
 
 // Functions used by the parser.
 // ==========================================================================
@@ -18,14 +21,14 @@ void p_read_tk( struct parse* parse ) {
    read_peeked_token( parse );
    struct token* token = parse->token;
    parse->tk = token->type;
-   parse->tk_text = token->text;
-   parse->tk_pos = token->pos;
+   parse->tk_text = p_token_text( parse, token );
+   parse->tk_pos = p_unpack_pos( token->pos );
    parse->tk_length = token->length;
 }
 
 static void read_peeked_token( struct parse* parse ) {
    if ( parse->parser_tkque.size > 0 ) {
-      parse->token = p_shift_entry( parse, &parse->parser_tkque );
+      parse->token = p_shift_token( parse, &parse->parser_tkque );
    }
    else {
       read_token( parse );
@@ -33,6 +36,13 @@ static void read_peeked_token( struct parse* parse ) {
 }
 
 static void read_token( struct parse* parse ) {
+   read_expanded_token( parse );
+   if ( parse->header_recording ) {
+      p_record_header_token( parse, parse->token );
+   }
+}
+
+static void read_expanded_token( struct parse* parse ) {
    top:
    p_read_stream( parse );
    switch ( parse->token->type ) {
@@ -70,97 +80,8 @@ static void read_token( struct parse* parse ) {
 
    identifier:
    // -----------------------------------------------------------------------
-   {
-      char* text = parse->token->modifiable_text;
-      if ( ( parse->token->length >= 2 &&
-         ( islower( parse->token->text[ parse->token->length - 2 ] ) ||
-            parse->token->text[ parse->token->length - 2 ] == '_' ) &&
-         text[ parse->token->length - 1 ] == 'T' ) ||
-         ( parse->token->length == 1 && parse->token->text[ 0 ] == 'T' ) ) {
-         parse->token->type = TK_TYPENAME;
-      }
-      while ( *text ) {
-         *text = tolower( *text );
-         ++text;
-      }
-      // Type name.
-      if ( parse->token->type == TK_TYPENAME ) {
-         return;
-      }
-      // Reserved identifier.
-      static const struct {
-         const char* name;
-         enum tk tk;
-      } table[] = {
-         { "assert", TK_ASSERT },
-         { "auto", TK_AUTO },
-         { "bool", TK_BOOL },
-         { "break", TK_BREAK },
-         { "buildmsg", TK_BUILDMSG },
-         { "case", TK_CASE },
-         { "const", TK_CONST },
-         { "continue", TK_CONTINUE },
-         { "createtranslation", TK_PALTRANS },
-         { "default", TK_DEFAULT },
-         { "do", TK_DO },
-         { "else", TK_ELSE },
-         { "enum", TK_ENUM },
-         { "extern", TK_EXTERN },
-         { "false", TK_FALSE },
-         { "fixed", TK_FIXED },
-         { "for", TK_FOR },
-         { "foreach", TK_FOREACH },
-         { "function", TK_FUNCTION },
-         { "global", TK_GLOBAL },
-         { "goto", TK_GOTO },
-         { "if", TK_IF },
-         { "int", TK_INT },
-         { "let", TK_LET },
-         { "memcpy", TK_MEMCPY },
-         { "namespace", TK_NAMESPACE },
-         { "null", TK_NULL },
-         { "private", TK_PRIVATE },
-         { "raw", TK_RAW },
-         { "restart", TK_RESTART },
-         { "return", TK_RETURN },
-         { "script", TK_SCRIPT },
-         { "special", TK_SPECIAL },
-         { "static", TK_STATIC },
-         { "str", TK_STR },
-         { "strcpy", TK_STRCPY },
-         { "strict", TK_STRICT },
-         { "struct", TK_STRUCT },
-         { "suspend", TK_SUSPEND },
-         { "switch", TK_SWITCH },
-         { "terminate", TK_TERMINATE },
-         { "true", TK_TRUE },
-         { "typedef", TK_TYPEDEF },
-         { "until", TK_UNTIL },
-         { "upmost", TK_UPMOST },
-         { "using", TK_USING },
-         { "void", TK_VOID },
-         { "while", TK_WHILE },
-         { "world", TK_WORLD },
-         // Terminator.
-         { "\x7F", TK_END }
-      };
-      int left = 0;
-      int right = ARRAY_SIZE( table ) - 1;
-      while ( left <= right ) {
-         int middle = ( left + right ) / 2;
-         int result = strcmp( parse->token->text, table[ middle ].name );
-         if ( result > 0 ) {
-            left = middle + 1;
-         }
-         else if ( result < 0 ) {
-            right = middle - 1;
-         }
-         else {
-            parse->token->type = table[ middle ].tk;
-            return;
-         }
-      }
-   }
+   parse->token->type = classify_id( t_text( parse->task,
+      parse->token->text ), parse->token->length );
    return;
 
    // Concatenate adjacent strings.
@@ -178,8 +99,8 @@ static void read_token( struct parse* parse ) {
       if ( iter.token->type == TK_LIT_STRING ) {
          struct str text;
          str_init( &text );
-         str_append( &text, parse->token->text );
-         struct pos pos = parse->token->pos;
+         str_append( &text, p_token_text( parse, parse->token ) );
+         uint64_t pos = parse->token->pos;
          while ( true ) {
             p_init_streamtk_iter( parse, &iter );
             p_next_stream( parse, &iter );
@@ -190,23 +111,157 @@ static void read_token( struct parse* parse ) {
             }
             else if ( iter.token->type == TK_LIT_STRING ) {
                p_read_stream( parse );
-               str_append( &text, parse->token->text );
+               str_append( &text, p_token_text( parse, parse->token ) );
             }
             else {
                break;
             }
          }
          parse->token->pos = pos;
-         parse->token->modifiable_text = t_intern_text( parse->task,
+         parse->token->text = t_intern_text_offset( parse->task,
             text.value, text.length );
          parse->token->type = TK_LIT_STRING;
-         parse->token->text = parse->token->modifiable_text;
          parse->token->length = text.length;
          str_deinit( &text );
       }
    }
 }
 
+// Lowercases an identifier and determines whether it is a type name, a
+// reserved identifier, or a plain identifier, in a single pass over the text.
+static enum tk classify_id( char* text, int length ) {
+   // A type name is an identifier that ends with an uppercase `T` that is
+   // preceded by a lowercase letter or an underscore. The check is done on the
+   // original text, before it gets lowercased.
+   bool type_name = ( length >= 2 &&
+      ( islower( text[ length - 2 ] ) || text[ length - 2 ] == '_' ) &&
+      text[ length - 1 ] == 'T' ) || ( length == 1 && text[ 0 ] == 'T' );
+   // All reserved identifiers consist of letters only.
+   bool letters = true;
+   for ( int i = 0; i < length; ++i ) {
+      char ch = tolower( text[ i ] );
+      if ( ! ( ch >= 'a' && ch <= 'z' ) ) {
+         letters = false;
+      }
+      text[ i ] = ch;
+   }
+   if ( type_name ) {
+      return TK_TYPENAME;
+   }
+   else if ( letters ) {
+      return find_reserved_id( text, length );
+   }
+   else {
+      return TK_ID;
+   }
+}
+
+// Candidates are selected by the length and the first character of the
+// identifier, so at most a few comparisons are made.
+static enum tk find_reserved_id( const char* text, int length ) {
+   #define RESERVED_ID( name, tk ) \
+      if ( memcmp( text, name, length ) == 0 ) { return tk; }
+   switch ( length ) {
+   case 2:
+      switch ( text[ 0 ] ) {
+      case 'd': RESERVED_ID( "do", TK_DO ) break;
+      case 'i': RESERVED_ID( "if", TK_IF ) break;
+      }
+      break;
+   case 3:
+      switch ( text[ 0 ] ) {
+      case 'f': RESERVED_ID( "for", TK_FOR ) break;
+      case 'i': RESERVED_ID( "int", TK_INT ) break;
+      case 'l': RESERVED_ID( "let", TK_LET ) break;
+      case 'r': RESERVED_ID( "raw", TK_RAW ) break;
+      case 's': RESERVED_ID( "str", TK_STR ) break;
+      }
+      break;
+   case 4:
+      switch ( text[ 0 ] ) {
+      case 'a': RESERVED_ID( "auto", TK_AUTO ) break;
+      case 'b': RESERVED_ID( "bool", TK_BOOL ) break;
+      case 'c': RESERVED_ID( "case", TK_CASE ) break;
+      case 'e':
+         RESERVED_ID( "else", TK_ELSE )
+         RESERVED_ID( "enum", TK_ENUM )
+         break;
+      case 'g': RESERVED_ID( "goto", TK_GOTO ) break;
+      case 'n': RESERVED_ID( "null", TK_NULL ) break;
+      case 't': RESERVED_ID( "true", TK_TRUE ) break;
+      case 'v': RESERVED_ID( "void", TK_VOID ) break;
+      }
+      break;
+   case 5:
+      switch ( text[ 0 ] ) {
+      case 'b': RESERVED_ID( "break", TK_BREAK ) break;
+      case 'c': RESERVED_ID( "const", TK_CONST ) break;
+      case 'f':
+         RESERVED_ID( "false", TK_FALSE )
+         RESERVED_ID( "fixed", TK_FIXED )
+         break;
+      case 'u':
+         RESERVED_ID( "until", TK_UNTIL )
+         RESERVED_ID( "using", TK_USING )
+         break;
+      case 'w':
+         RESERVED_ID( "while", TK_WHILE )
+         RESERVED_ID( "world", TK_WORLD )
+         break;
+      }
+      break;
+   case 6:
+      switch ( text[ 0 ] ) {
+      case 'a': RESERVED_ID( "assert", TK_ASSERT ) break;
+      case 'e': RESERVED_ID( "extern", TK_EXTERN ) break;
+      case 'g': RESERVED_ID( "global", TK_GLOBAL ) break;
+      case 'm': RESERVED_ID( "memcpy", TK_MEMCPY ) break;
+      case 'r': RESERVED_ID( "return", TK_RETURN ) break;
+      case 's':
+         RESERVED_ID( "script", TK_SCRIPT )
+         RESERVED_ID( "static", TK_STATIC )
+         RESERVED_ID( "strcpy", TK_STRCPY )
+         RESERVED_ID( "strict", TK_STRICT )
+         RESERVED_ID( "struct", TK_STRUCT )
+         RESERVED_ID( "switch", TK_SWITCH )
+         break;
+      case 'u': RESERVED_ID( "upmost", TK_UPMOST ) break;
+      }
+      break;
+   case 7:
+      switch ( text[ 0 ] ) {
+      case 'd': RESERVED_ID( "default", TK_DEFAULT ) break;
+      case 'f': RESERVED_ID( "foreach", TK_FOREACH ) break;
+      case 'p': RESERVED_ID( "private", TK_PRIVATE ) break;
+      case 'r': RESERVED_ID( "restart", TK_RESTART ) break;
+      case 's':
+         RESERVED_ID( "special", TK_SPECIAL )
+         RESERVED_ID( "suspend", TK_SUSPEND )
+         break;
+      case 't': RESERVED_ID( "typedef", TK_TYPEDEF ) break;
+      }
+      break;
+   case 8:
+      switch ( text[ 0 ] ) {
+      case 'b': RESERVED_ID( "buildmsg", TK_BUILDMSG ) break;
+      case 'c': RESERVED_ID( "continue", TK_CONTINUE ) break;
+      case 'f': RESERVED_ID( "function", TK_FUNCTION ) break;
+      }
+      break;
+   case 9:
+      switch ( text[ 0 ] ) {
+      case 'n': RESERVED_ID( "namespace", TK_NAMESPACE ) break;
+      case 't': RESERVED_ID( "terminate", TK_TERMINATE ) break;
+      }
+      break;
+   case 17:
+      RESERVED_ID( "createtranslation", TK_PALTRANS )
+      break;
+   }
+   #undef RESERVED_ID
+   return TK_ID;
+}
+
 enum tk p_peek( struct parse* parse ) {
    return p_peek_tk( parse )->type;
 }
@@ -227,28 +282,25 @@ enum tk p_peek_2nd( struct parse* parse ) {
 }
 
 void p_init_parsertk_iter( struct parse* parse, struct parsertk_iter* iter ) {
-   iter->entry = parse->parser_tkque.head;
    iter->token = NULL;
+   iter->index = 0;
 }
 
 void p_next_tk( struct parse* parse, struct parsertk_iter* iter ) {
-   if ( iter->entry ) {
-      struct queue_entry* entry = iter->entry;
-      iter->token = entry->token;
-      iter->entry = entry->next;
+   if ( iter->index < parse->parser_tkque.size ) {
+      iter->token = p_get_queued_token( &parse->parser_tkque, iter->index );
    }
    else {
       iter->token = push_token( parse );
    }
+   ++iter->index;
 }
 
 static struct token* push_token( struct parse* parse ) {
-   struct queue_entry* entry = p_push_entry( parse, &parse->parser_tkque );
-   entry->token = p_alloc_token( parse );
-   entry->token_allocated = true;
+   struct token* token = p_push_token( parse, &parse->parser_tkque );
    read_token( parse );
-   entry->token[ 0 ] = parse->token[ 0 ];
-   return entry->token;
+   token[ 0 ] = parse->token[ 0 ];
+   return token;
 }
 
 /*
@@ -373,9 +425,10 @@ void p_read_eoptiontk( struct parse* parse ) {
 
 void p_test_preptk( struct parse* parse, enum tk expected ) {
    if ( parse->token->type != expected ) {
-      p_diag( parse, DIAG_POS_ERR | DIAG_SYNTAX, &parse->token->pos,
+      struct pos pos = p_unpack_pos( parse->token->pos );
+      p_diag( parse, DIAG_POS_ERR | DIAG_SYNTAX, &pos,
          "unexpected %s", p_present_token_temp( parse, parse->token->type ) );
-      p_diag( parse, DIAG_POS, &parse->token->pos,
+      p_diag( parse, DIAG_POS, &pos,
          "expecting %s here", p_present_token_temp( parse, expected ) );
       p_bail( parse );
    }
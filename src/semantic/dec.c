@@ -126,6 +126,8 @@ static void init_spec_test( struct spec_test* test, struct path* path,
 static void test_spec( struct semantic* semantic, struct spec_test* test );
 static void find_name_spec( struct semantic* semantic,
    struct spec_test* test );
+static bool test_dependency( struct semantic* semantic,
+   struct object* object );
 static void merge_type( struct semantic* semantic, struct spec_test* test,
    struct type_alias* alias );
 static void merge_ref( struct semantic* semantic, struct spec_test* test,
@@ -337,7 +339,7 @@ static void test_enumerator( struct semantic* semantic,
       }
       struct type_info base_type;
       s_init_type_info_scalar( &base_type, enumeration->base_type );
-      if ( ! s_instance_of( &base_type, &expr.type ) ) {
+      if ( ! s_instance_of( semantic, &base_type, &expr.type ) ) {
          s_type_mismatch( semantic, "enumerator", &expr.type,
             "enumeration-base", &base_type, &enumerator->object.pos );
          s_bail( semantic );
@@ -445,7 +447,8 @@ static bool test_member_spec( struct semantic* semantic,
       s_bail( semantic );
    }
    if ( member->spec == SPEC_STRUCT ) {
-      if ( member->structure->object.resolved || member->ref ) {
+      if ( member->ref ||
+         test_dependency( semantic, &member->structure->object ) ) {
          return true;
       }
       else {
@@ -458,7 +461,7 @@ static bool test_member_spec( struct semantic* semantic,
       }
    }
    else if ( member->spec == SPEC_ENUM ) {
-      return member->enumeration->object.resolved;
+      return test_dependency( semantic, &member->enumeration->object );
    }
    else {
       return true;
@@ -526,10 +529,10 @@ static bool test_typedef_spec( struct semantic* semantic,
       s_bail( semantic );
    }
    if ( alias->spec == SPEC_STRUCT ) {
-      return alias->structure->object.resolved;
+      return test_dependency( semantic, &alias->structure->object );
    }
    else if ( alias->spec == SPEC_ENUM ) {
-      return alias->enumeration->object.resolved;
+      return test_dependency( semantic, &alias->enumeration->object );
    }
    else {
       return true;
@@ -605,10 +608,10 @@ static bool test_var_spec( struct semantic* semantic, struct var* var ) {
       s_bail( semantic );
    }
    if ( var->spec == SPEC_STRUCT ) {
-      return var->structure->object.resolved;
+      return test_dependency( semantic, &var->structure->object );
    }
    else if ( var->spec == SPEC_ENUM ) {
-      return var->enumeration->object.resolved;
+      return test_dependency( semantic, &var->enumeration->object );
    }
    else {
       return true;
@@ -717,6 +720,18 @@ struct path* s_last_path_part( struct path* path ) {
    return path;
 }
 
+// Returns whether an object needed by a declaration is resolved. When it is
+// not, the object is recorded as the one blocking the declaration, so the
+// declaration can be retested once the object gets resolved.
+static bool test_dependency( struct semantic* semantic,
+   struct object* object ) {
+   if ( ! object->resolved ) {
+      semantic->blocker = object;
+      return false;
+   }
+   return true;
+}
+
 static void merge_type( struct semantic* semantic, struct spec_test* test,
    struct type_alias* alias ) {
    test->spec = alias->spec;
@@ -1360,7 +1375,7 @@ static bool test_scalar_initz( struct semantic* semantic,
    // Perform type checking when testing an initializer for a variable with
    // known type information.
    if ( test->initz_test ) {
-      if ( ! s_instance_of( test->type, &test->initz_type ) ) {
+      if ( ! s_instance_of( semantic, test->type, &test->initz_type ) ) {
          initz_mismatch( semantic, test->initz_test, &test->initz_type,
             test->type, &value->expr->pos );
          s_bail( semantic );
@@ -1396,7 +1411,7 @@ static bool test_scalar_initz( struct semantic* semantic,
       if ( expr.has_str ) {
          // In ACS, one can add strings and numbers, so an invalid string index
          // is possible. Make sure we have a valid string.
-         struct indexed_string* string = t_lookup_string( semantic->task,
+         struct indexed_string* string = s_lookup_string( semantic,
             value->expr->value );
          if ( string ) {
             value->more.string.string = string;
@@ -1415,9 +1430,9 @@ static bool test_scalar_initz( struct semantic* semantic,
             "variables)" );
          s_bail( semantic );
       }
-      expr.var->addr_taken = true;
+      s_set_flag( semantic, &expr.var->addr_taken );
       if ( expr.structure_member ) {
-         expr.structure_member->addr_taken = true;
+         s_set_flag( semantic, &expr.structure_member->addr_taken );
       }
    }
    return true;
@@ -1448,7 +1463,7 @@ static bool test_string_initz( struct semantic* semantic, struct dim* dim,
          "non-constant string initializer" );
       s_bail( semantic );
    }
-   struct indexed_string* string = t_lookup_string( semantic->task,
+   struct indexed_string* string = s_lookup_string( semantic,
       value->expr->value );
    if ( dim->length_node ) {
       if ( string->length >= dim->length ) {
@@ -1679,7 +1694,8 @@ static bool test_external_var( struct semantic* semantic, struct var* var ) {
       s_bail( semantic );
    }
    struct var* other_var = ( struct var* ) var->name->object;
-   if ( ! other_var->external && ! other_var->object.resolved ) {
+   if ( ! other_var->external &&
+      ! test_dependency( semantic, &other_var->object ) ) {
       return false;
    }
    var->imported = ( other_var->external == true );
@@ -1693,7 +1709,7 @@ static bool test_external_var( struct semantic* semantic, struct var* var ) {
       var_def->enumeration,
       var_def->dim,
       var_def->spec, var_def->storage );
-   if ( ! s_same_type( &type, &other_type ) ) {
+   if ( ! s_same_type( semantic, &type, &other_type ) ) {
       s_diag( semantic, DIAG_POS_ERR, &var->object.pos,
          "external variable declaration different from %s",
          var_def->external ? "previous declaration" : "actual variable" );
@@ -1760,7 +1776,7 @@ static void test_worldglobal_var( struct semantic* semantic,
       s_init_type_info( &prev_type, prev_var->ref, prev_var->structure,
          prev_var->enumeration, prev_var->dim, prev_var->spec,
          prev_var->storage );
-      if ( ! s_same_type( &type, &prev_type ) ) {
+      if ( ! s_same_type( semantic, &type, &prev_type ) ) {
          s_diag( semantic, DIAG_POS_ERR, &var->object.pos,
             "%s variable declaration different from previous declaration",
             t_get_storage_name( var->storage ) );
@@ -1934,10 +1950,10 @@ static bool test_func_return_spec( struct semantic* semantic,
       s_bail( semantic );
    }
    if ( func->return_spec == SPEC_STRUCT ) {
-      return func->structure->object.resolved;
+      return test_dependency( semantic, &func->structure->object );
    }
    else if ( func->return_spec == SPEC_ENUM ) {
-      return func->enumeration->object.resolved;
+      return test_dependency( semantic, &func->enumeration->object );
    }
    else {
       return true;
@@ -2060,10 +2076,10 @@ static bool test_param_spec( struct semantic* semantic,
       s_bail( semantic );
    }
    if ( param->spec == SPEC_STRUCT ) {
-      return param->structure->object.resolved;
+      return test_dependency( semantic, &param->structure->object );
    }
    else if ( param->spec == SPEC_ENUM ) {
-      return param->enumeration->object.resolved;
+      return test_dependency( semantic, &param->enumeration->object );
    }
    else {
       return true;
@@ -2139,7 +2155,7 @@ static bool test_param_default_value( struct semantic* semantic,
    struct type_info param_type;
    s_init_type_info( &param_type, param->ref, param->structure,
       param->enumeration, NULL, param->spec, STORAGE_LOCAL );
-   if ( ! s_instance_of( &param_type, &expr.type ) ) {
+   if ( ! s_instance_of( semantic, &param_type, &expr.type ) ) {
       default_value_mismatch( semantic, test->func, param, &param_type,
          &expr.type, &param->default_value->pos );
       s_bail( semantic );
@@ -2151,9 +2167,9 @@ static bool test_param_default_value( struct semantic* semantic,
             "map variables)" );
          s_bail( semantic );
       }
-      expr.var->addr_taken = true;
+      s_set_flag( semantic, &expr.var->addr_taken );
       if ( expr.structure_member ) {
-         expr.structure_member->addr_taken = true;
+         s_set_flag( semantic, &expr.structure_member->addr_taken );
       }
    }
    param->default_value_tested = true;
@@ -2201,7 +2217,7 @@ static bool test_external_func( struct semantic* semantic,
       resolved = true;
    }
    else {
-      if ( other_func->object.resolved ) {
+      if ( test_dependency( semantic, &other_func->object ) ) {
          struct type_info type;
          s_init_type_info_func( &type, func->ref, func->structure,
             func->enumeration, func->params, func->return_spec,
@@ -2211,7 +2227,7 @@ static bool test_external_func( struct semantic* semantic,
             other_func->structure, other_func->enumeration, other_func->params,
             other_func->return_spec, other_func->min_param,
             other_func->max_param, false );
-         if ( ! s_same_type( &type, &other_type ) ) {
+         if ( ! s_same_type( semantic, &type, &other_type ) ) {
             s_diag( semantic, DIAG_POS_ERR, &func->object.pos,
                "external function declaration different from %s",
                other_func->external ? "previous declaration" :
@@ -2292,7 +2308,8 @@ static void init_builtin_aliases( struct semantic* semantic,
 
 static void bind_builtin_aliases( struct semantic* semantic,
    struct builtin_aliases* aliases ) {
-   struct name* name = t_extend_name( semantic->ns->body, "__function__" );
+   struct name* name = s_extend_name( semantic, semantic->ns->body,
+      "__function__" );
    s_bind_local_name( semantic, name, &aliases->name.alias.object, true );
 }
 
@@ -2359,7 +2376,7 @@ static void test_nonzero_script_number( struct semantic* semantic,
       script->number->spec == SPEC_STR :
       script->number->root->type == NODE_INDEXED_STRING_USAGE );
    if ( script->named_script ) {
-      struct indexed_string* string = t_lookup_string( semantic->task,
+      struct indexed_string* string = s_lookup_string( semantic,
          script->number->value );
       if ( ! string ) {
          s_diag( semantic, DIAG_POS_ERR, &script->number->pos,
@@ -2434,7 +2451,8 @@ static void init_builtin_script_aliases( struct semantic* semantic,
 
 static void bind_builtin_script_aliases( struct semantic* semantic,
    struct builtin_script_aliases* aliases ) {
-   struct name* name = t_extend_name( semantic->ns->body, "__script__" );
+   struct name* name = s_extend_name( semantic, semantic->ns->body,
+      "__script__" );
    s_bind_local_name( semantic, name, &aliases->name.alias.object, true );
 }
 
@@ -243,7 +243,7 @@ static void select_alias( struct semantic* semantic, struct expr_test* test,
    struct result* result, struct alias* alias );
 static void select_magic_id( struct semantic* semantic, struct expr_test* test,
    struct result* result, struct magic_id* magic_id );
-static void expand_magic_id( struct semantic* semantic,
+static struct indexed_string* expand_magic_id( struct semantic* semantic,
    struct magic_id* magic_id );
 static void test_strcpy( struct semantic* semantic, struct expr_test* test,
    struct result* result, struct strcpy_call* call );
@@ -270,6 +270,7 @@ static void test_null( struct result* result );
 
 void s_init_expr_test( struct expr_test* test, bool result_required,
    bool suggest_paren_assign ) {
+   test->bail = NULL;
    test->buildmsg = NULL;
    s_init_type_info_scalar( &test->type, SPEC_VOID );
    test->name_offset = NULL;
@@ -292,26 +293,28 @@ void s_init_expr_test_enumerator( struct expr_test* test,
    }
 }
 
+// An expression that uses an object that is not resolved yet is abandoned by
+// jumping back here. Nested expressions jump straight to the bail point of the
+// expression being tested, so there is only one bail point per expression.
 void s_test_expr( struct semantic* semantic, struct expr_test* test,
    struct expr* expr ) {
-   if ( setjmp( test->bail ) == 0 ) {
+   jmp_buf bail;
+   if ( setjmp( bail ) == 0 ) {
+      test->bail = &bail;
       test_root( semantic, test, expr );
    }
    else {
       test->undef_erred = true;
    }
+   test->bail = NULL;
 }
 
 static void test_nested_expr( struct semantic* semantic,
    struct expr_test* parent_test, struct expr_test* test, struct expr* expr ) {
-   if ( setjmp( test->bail ) == 0 ) {
-      test_root( semantic, test, expr );
-      if ( test->has_str ) {
-         parent_test->has_str = true;
-      }
-   }
-   else {
-      longjmp( parent_test->bail, 1 );
+   test->bail = parent_test->bail;
+   test_root( semantic, test, expr );
+   if ( test->has_str ) {
+      parent_test->has_str = true;
    }
 }
 
@@ -419,7 +422,7 @@ static void test_binary( struct semantic* semantic, struct expr_test* test,
          "right operand not a value" );
       s_bail( semantic );
    }
-   if ( ! s_same_type( &lside.type, &rside.type ) ) {
+   if ( ! s_same_type( semantic, &lside.type, &rside.type ) ) {
       s_type_mismatch( semantic, "left-operand", &lside.type,
          "right-operand", &rside.type, &binary->pos );
       s_bail( semantic );
@@ -762,9 +765,9 @@ static void fold_bop_str( struct semantic* semantic, struct binary* binary,
 static void fold_bop_str_compare( struct semantic* semantic,
    struct binary* binary, struct result* lside, struct result* rside ) {
    struct indexed_string* lside_str =
-      t_lookup_string( semantic->task, lside->value );
+      s_lookup_string( semantic, lside->value );
    struct indexed_string* rside_str =
-      t_lookup_string( semantic->task, rside->value );
+      s_lookup_string( semantic, rside->value );
    int result = strcmp( lside_str->value, rside_str->value );
    switch ( binary->op ) {
    case BOP_EQ: binary->value = ( result == 0 ); break;
@@ -931,7 +934,7 @@ static void test_assign( struct semantic* semantic, struct expr_test* test,
          "right operand not a value" );
       s_bail( semantic );
    }
-   if ( ! s_instance_of( &lside.type, &rside.type ) ) {
+   if ( ! s_instance_of( semantic, &lside.type, &rside.type ) ) {
       s_type_mismatch( semantic, "left-operand", &lside.type,
          "right-operand", &rside.type, &assign->pos );
       s_bail( semantic );
@@ -956,16 +959,17 @@ static void test_assign( struct semantic* semantic, struct expr_test* test,
             "variables)" );
          s_bail( semantic );
       }
-      rside.data_origin.var->addr_taken = true;
+      s_set_flag( semantic, &rside.data_origin.var->addr_taken );
       if ( rside.data_origin.structure_member ) {
-         rside.data_origin.structure_member->addr_taken = true;
+         s_set_flag( semantic,
+            &rside.data_origin.structure_member->addr_taken );
       }
    }
    // Record the fact that the object was modified.
    if ( lside.object ) {
       if ( lside.object->node.type == NODE_VAR ) {
          struct var* var = ( struct var* ) lside.object;
-         var->modified = true;
+         s_set_flag( semantic, &var->modified );
       }
    }
    // To avoid the error where the user wanted equality operator but instead
@@ -1129,7 +1133,7 @@ static void test_conditional( struct semantic* semantic,
       }
    }
    struct type_info result_type;
-   if ( ! s_common_type( &middle.type, &right.type, &result_type ) ) {
+   if ( ! s_common_type( semantic, &middle.type, &right.type, &result_type ) ) {
       s_type_mismatch( semantic, cond->middle ?
          "middle-operand" : "left-operand", &middle.type, "right-operand",
          &right.type, &cond->pos );
@@ -1154,9 +1158,10 @@ static void test_conditional( struct semantic* semantic,
                "left operand" );
             s_bail( semantic );
          }
-         middle.data_origin.var->addr_taken = true;
+         s_set_flag( semantic, &middle.data_origin.var->addr_taken );
          if ( middle.data_origin.structure_member ) {
-            middle.data_origin.structure_member->addr_taken = true;
+            s_set_flag( semantic,
+               &middle.data_origin.structure_member->addr_taken );
          }
       }
       if ( right.data_origin.var ) {
@@ -1166,9 +1171,10 @@ static void test_conditional( struct semantic* semantic,
                "map variables)" );
             s_bail( semantic );
          }
-         right.data_origin.var->addr_taken = true;
+         s_set_flag( semantic, &right.data_origin.var->addr_taken );
          if ( right.data_origin.structure_member ) {
-            right.data_origin.structure_member->addr_taken = true;
+            s_set_flag( semantic,
+               &right.data_origin.structure_member->addr_taken );
          }
       }
    }
@@ -1423,7 +1429,7 @@ static void test_inc( struct semantic* semantic, struct expr_test* test,
    if ( operand.object ) {
       if ( operand.object->node.type == NODE_VAR ) {
          struct var* var = ( struct var* ) operand.object;
-         var->modified = true;
+         s_set_flag( semantic, &var->modified );
       }
    }
 }
@@ -1620,7 +1626,7 @@ static void test_subscript_array( struct semantic* semantic,
    s_init_expr_test( &index, true, false );
    test_nested_expr( semantic, test, &index, subscript->index );
    // Index must be of integer type.
-   if ( ! s_same_type( &index.type, &semantic->type_int ) ) {
+   if ( ! s_same_type( semantic, &index.type, &semantic->type_int ) ) {
       s_type_mismatch( semantic, "index", &index.type,
          "required", &semantic->type_int, &subscript->index->pos );
       s_bail( semantic );
@@ -1651,7 +1657,7 @@ static void test_subscript_array( struct semantic* semantic,
    result->usable = true;
    result->complete = true;
    if ( lside->type.ref->nullable ) {
-      semantic->lib->uses_nullable_refs = true;
+      s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
    }
    // Compile-time evaluation.
    switch ( element ) {
@@ -1697,14 +1703,14 @@ static void test_subscript_str( struct semantic* semantic,
    s_init_expr_test( &index, true, false );
    test_nested_expr( semantic, test, &index, subscript->index );
    // Index must be of integer type.
-   if ( ! s_same_type( &index.type, &semantic->type_int ) ) {
+   if ( ! s_same_type( semantic, &index.type, &semantic->type_int ) ) {
       s_type_mismatch( semantic, "index", &index.type,
          "required", &semantic->type_int, &subscript->index->pos );
       s_bail( semantic );
    }
    // Out-of-bounds warning for a constant index.
    if ( lside->folded && subscript->index->folded ) {
-      struct indexed_string* string = t_lookup_string( semantic->task,
+      struct indexed_string* string = s_lookup_string( semantic,
          lside->value );
       if ( string ) {
          warn_bounds_violation( semantic, subscript, "string-length",
@@ -1758,17 +1764,17 @@ static void test_access_struct( struct semantic* semantic,
    select_structure_member( semantic, lside, result, member );
    // Null check.
    if ( lside->type.ref->nullable ) {
-      semantic->lib->uses_nullable_refs = true;
+      s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
    }
 }
 
 static struct structure_member* get_structure_member(
    struct semantic* semantic, struct expr_test* test, struct access* access,
    struct result* lside ) {
-   struct name* name = t_extend_name( lside->type.structure->body,
+   struct name* name = s_extend_name( semantic, lside->type.structure->body,
       access->name );
-   if ( ! ( name->object &&
-      name->object->node.type == NODE_STRUCTURE_MEMBER ) ) {
+   struct object* object = s_bound_object( semantic, name );
+   if ( ! ( object && object->node.type == NODE_STRUCTURE_MEMBER ) ) {
       if ( lside->type.structure->anon ) {
          s_diag( semantic, DIAG_POS_ERR, &access->pos,
             "`%s` not a member of anonymous struct", access->name );
@@ -1784,25 +1790,27 @@ static struct structure_member* get_structure_member(
       }
       s_bail( semantic );
    }
-   if ( ! name->object->resolved ) {
+   if ( ! object->resolved ) {
       if ( semantic->trigger_err ) {
          s_diag( semantic, DIAG_POS_ERR, &access->pos,
             "struct member (`%s`) undefined", access->name );
          s_bail( semantic );
       }
       else {
+         semantic->blocker = object;
          test->undef_erred = true;
-         longjmp( test->bail, 1 );
+         longjmp( *test->bail, 1 );
       }
    }
-   return ( struct structure_member* ) name->object;
+   return ( struct structure_member* ) object;
 }
 
 static void test_access_ns( struct semantic* semantic,
    struct expr_test* test, struct access* access, struct result* lside,
    struct result* result ) {
    struct ns* ns = ( struct ns* ) lside->object;
-   struct object* object = s_get_ns_object( ns, access->name, NODE_NONE );
+   struct object* object = s_get_ns_object( semantic, ns, access->name,
+      NODE_NONE );
    if ( ! object ) {
       s_unknown_ns_object( semantic, ns, access->name, &access->pos );
       s_bail( semantic );
@@ -1814,8 +1822,9 @@ static void test_access_ns( struct semantic* semantic,
          s_bail( semantic );
       }
       else {
+         semantic->blocker = object;
          test->undef_erred = true;
-         longjmp( test->bail, 1 );
+         longjmp( *test->bail, 1 );
       }
    }
    access->type = ACCESS_NAMESPACE;
@@ -1890,8 +1899,9 @@ static void select_ns_object( struct semantic* semantic,
 static void test_access_array( struct semantic* semantic,
    struct expr_test* test, struct access* access, struct result* lside,
    struct result* result ) {
-   struct name* name = t_extend_name( semantic->task->array_name, "." );
-   name = t_extend_name( name, access->name );
+   struct name* name = s_extend_name( semantic, semantic->task->array_name,
+      "." );
+   name = s_extend_name( semantic, name, access->name );
    if ( ! name->object ) {
       s_diag( semantic, DIAG_POS_ERR, &access->pos,
          "`%s` not a member of the array type", access->name );
@@ -1910,15 +1920,16 @@ static void test_access_array( struct semantic* semantic,
    access->rside = &name->object->node;
    // Null check.
    if ( lside->type.ref->nullable ) {
-      semantic->lib->uses_nullable_refs = true;
+      s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
    }
 }
 
 static void test_access_str( struct semantic* semantic,
    struct expr_test* test, struct access* access, struct result* lside,
    struct result* result ) {
-   struct name* name = t_extend_name( semantic->task->str_name, "." );
-   name = t_extend_name( name, access->name );
+   struct name* name = s_extend_name( semantic, semantic->task->str_name,
+      "." );
+   name = s_extend_name( semantic, name, access->name );
    if ( ! name->object ) {
       s_diag( semantic, DIAG_POS_ERR, &access->pos,
          "`%s` not a member of the `str` type", access->name );
@@ -1992,8 +2003,7 @@ static void test_call( struct semantic* semantic, struct expr_test* expr_test,
          result->usable = ( operand.type.spec != SPEC_VOID );
       }
       result->complete = true;
-      static struct func dummy_func;
-      dummy_func.type = FUNC_SAMPLE;
+      static struct func dummy_func = { .type = FUNC_SAMPLE };
       call->func = &dummy_func;
       call->ref_func = func;
    }
@@ -2032,7 +2042,7 @@ static void test_call_operand( struct semantic* semantic,
       test->min_param = func->max_param;
       test->max_param = func->max_param;
       if ( operand->type.ref->nullable ) {
-         semantic->lib->uses_nullable_refs = true;
+         s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
       }
    }
    else {
@@ -2108,7 +2118,7 @@ static void test_format_item( struct semantic* semantic,
    }
    struct type_info required_type;
    s_init_type_info_scalar( &required_type, spec );
-   if ( ! s_instance_of( &required_type, &arg.type ) ) {
+   if ( ! s_instance_of( semantic, &required_type, &arg.type ) ) {
       s_type_mismatch( semantic, "argument", &arg.type,
          "required", &required_type, &item->value->pos );
       s_bail( semantic );
@@ -2159,7 +2169,7 @@ static void test_int_arg( struct semantic* semantic, struct expr_test* test,
    test_nested_expr( semantic, test, &arg, expr );
    struct type_info required_type;
    s_init_type_info_scalar( &required_type, SPEC_INT );
-   if ( ! s_instance_of( &required_type, &arg.type ) ) {
+   if ( ! s_instance_of( semantic, &required_type, &arg.type ) ) {
       s_type_mismatch( semantic, "argument", &arg.type,
          "required", &required_type, &expr->pos );
       s_bail( semantic );
@@ -2250,7 +2260,7 @@ static void test_remaining_arg( struct semantic* semantic,
       struct type_info param_type;
       s_init_type_info( &param_type, param->ref, param->structure,
          param->enumeration, NULL, param->spec, STORAGE_LOCAL );
-      if ( ! s_instance_of( &param_type, &arg.type ) ) {
+      if ( ! s_instance_of( semantic, &param_type, &arg.type ) ) {
          arg_mismatch( semantic, &expr->pos, &arg.type,
             "parameter", &param_type, "argument", test->num_args + 1 );
          s_bail( semantic );
@@ -2272,9 +2282,9 @@ static void test_remaining_arg( struct semantic* semantic,
             "map variables)" );
          s_bail( semantic );
       }
-      arg.var->addr_taken = true;
+      s_set_flag( semantic, &arg.var->addr_taken );
       if ( arg.structure_member ) {
-         arg.structure_member->addr_taken = true;
+         s_set_flag( semantic, &arg.structure_member->addr_taken );
       }
    }
    if ( test->call->constant && ! expr->folded ) {
@@ -2413,7 +2423,7 @@ static void test_sure( struct semantic* semantic, struct expr_test* test,
       s_init_type_info_null( &result->type );
       result->complete = true;
       result->usable = true;
-      semantic->lib->uses_nullable_refs = true;
+      s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
    }
    else {
       struct type_snapshot snapshot;
@@ -2422,7 +2432,7 @@ static void test_sure( struct semantic* semantic, struct expr_test* test,
       sure->ref = snapshot.ref;
       if ( sure->ref->nullable ) {
          sure->ref->nullable = false;
-         semantic->lib->uses_nullable_refs = true;
+         s_set_flag( semantic, &semantic->lib->uses_nullable_refs );
       }
       else {
          sure->already_safe = true;
@@ -2543,8 +2553,9 @@ static void test_name_usage( struct semantic* semantic, struct expr_test* test,
    struct result* result, struct name_usage* usage ) {
    struct object* object = NULL;
    if ( test->name_offset ) {
-      struct name* name = t_extend_name( test->name_offset, usage->text );
-      object = name->object;
+      struct name* name = s_extend_name( semantic, test->name_offset,
+         usage->text );
+      object = s_bound_object( semantic, name );
    }
    if ( ! object ) {
       struct object_search search;
@@ -2570,8 +2581,9 @@ static void test_name_usage( struct semantic* semantic, struct expr_test* test,
          s_bail( semantic );
       }
       else {
+         semantic->blocker = object;
          test->undef_erred = true;
-         longjmp( test->bail, 1 );
+         longjmp( *test->bail, 1 );
       }
    }
 }
@@ -2825,7 +2837,7 @@ static void select_var( struct semantic* semantic, struct result* result,
    result->object = &var->object;
    result->complete = true;
    result->usable = true;
-   var->used = true;
+   s_set_flag( semantic, &var->used );
 }
 
 static void select_param( struct semantic* semantic, struct result* result,
@@ -2911,7 +2923,7 @@ static void select_func( struct semantic* semantic, struct result* result,
       result->usable = true;
       result->folded = true;
       result->complete = true;
-      ++impl->usage;
+      s_increment( semantic, &impl->usage );
    }
    // When an action-special is not called, it decays into an integer value.
    // The value is the ID of the action-special.
@@ -2950,21 +2962,22 @@ static void select_alias( struct semantic* semantic, struct expr_test* test,
 
 static void select_magic_id( struct semantic* semantic, struct expr_test* test,
    struct result* result, struct magic_id* magic_id ) {
-   expand_magic_id( semantic, magic_id );
    struct indexed_string_usage* string_usage = t_alloc_indexed_string_usage();
-   string_usage->string = magic_id->string;
+   string_usage->string = expand_magic_id( semantic, magic_id );
    test->magic_id_usage = string_usage;
    test_string( semantic, test, result, string_usage->string );
 }
 
-static void expand_magic_id( struct semantic* semantic,
+// The string is not kept in the magic identifier. `__namespace__` is shared by
+// every body, and its string depends on the namespace of the body.
+static struct indexed_string* expand_magic_id( struct semantic* semantic,
    struct magic_id* magic_id ) {
    struct str name;
    str_init( &name );
    switch ( magic_id->name ) {
    case MAGICID_SCRIPT:
       if ( semantic->func_test->script->named_script ) {
-         struct indexed_string* string = t_lookup_string( semantic->task,
+         struct indexed_string* string = s_lookup_string( semantic,
             semantic->func_test->script->number->value );
          str_append( &name, string->value );
       }
@@ -2994,9 +3007,10 @@ static void expand_magic_id( struct semantic* semantic,
       UNREACHABLE();
       s_bail( semantic );
    }
-   magic_id->string = t_intern_string_copy( semantic->task,
-      name.value, name.length );
+   struct indexed_string* string = s_intern_string( semantic, name.value,
+      name.length );
    str_deinit( &name );
+   return string;
 }
 
 static void test_strcpy( struct semantic* semantic, struct expr_test* test,
@@ -3096,7 +3110,7 @@ static void test_memcpy( struct semantic* semantic, struct expr_test* test,
    struct expr_test src;
    s_init_expr_test( &src, false, false );
    test_nested_expr( semantic, test, &src, call->source );
-   if ( ! s_same_storageignored_type( &src.type, &dst.type ) ) {
+   if ( ! s_same_storageignored_type( semantic, &src.type, &dst.type ) ) {
       s_type_mismatch( semantic, "source", &src.type,
          "destination", &dst.type, &call->source->pos );
       s_diag( semantic, DIAG_NOTE | DIAG_POS, &call->source->pos,
@@ -3233,7 +3247,7 @@ static void test_compound_literal( struct semantic* semantic,
       s_test_var( semantic, literal->var );
       if ( ! literal->var->object.resolved ) {
          test->undef_erred = true;
-         longjmp( test->bail, 1 );
+         longjmp( *test->bail, 1 );
       }
    }
    select_var( semantic, result, literal->var );
@@ -0,0 +1,363 @@
+#include <string.h>
+
+#include "../common.h"
+#include "phase.h"
+
+struct body {
+   struct node* node;
+   struct ns_fragment* fragment;
+   struct list diags;
+   bool done;
+   bool failed;
+};
+
+struct body_diag {
+   struct pos pos;
+   struct str text;
+   int flags;
+};
+
+struct body_pool {
+   struct semantic* semantic;
+   struct body* bodies;
+   int capacity;
+   int count;
+   // The next body to be tested.
+   int next;
+   // Every body before this one has been tested.
+   int done;
+   // The first body that failed to be tested, or the number of bodies.
+   int failed;
+   struct mutex lock;
+   struct cond_var body_done;
+};
+
+struct body_worker {
+   struct body_pool* pool;
+   struct semantic semantic;
+   struct thread thread;
+   jmp_buf* bail;
+   // The body being tested.
+   int index;
+};
+
+static void collect_bodies( struct body_pool* pool,
+   struct ns_fragment* fragment );
+static void add_body( struct body_pool* pool, struct node* node,
+   struct ns_fragment* fragment );
+static void init_worker( struct body_worker* worker, struct body_pool* pool );
+static void run_worker( void* data );
+static bool take_body( struct body_worker* worker );
+static void test_body( struct body_worker* worker, struct body* body );
+static void finish_body( struct body_worker* worker, struct body* body );
+static void merge_stats( struct semantic* semantic,
+   struct body_worker* worker );
+static void show_diags( struct body_pool* pool );
+
+// Once the namespace-level objects are resolved, a body only reads them, so
+// the bodies can be tested on several threads. Each thread has its own copy of
+// the semantic state, with its own scopes and sweeps, and binds local names in
+// its own table. What the bodies share is changed under the lock of the pool.
+//
+// The result is the same as when the bodies are tested one after the other:
+// the diagnostics of each body are kept and shown in the order of the bodies
+// once every thread is done, and a new string is interned only after every
+// earlier body has been tested, so the strings get the same indexes. An error
+// in a body stops the compilation, and the bodies after it are not tested.
+void s_test_bodies( struct semantic* semantic, struct ns_fragment* fragment ) {
+   struct body_pool pool;
+   pool.semantic = semantic;
+   pool.bodies = NULL;
+   pool.capacity = 0;
+   pool.count = 0;
+   collect_bodies( &pool, fragment );
+   pool.next = 0;
+   pool.done = 0;
+   pool.failed = pool.count;
+   int jobs = semantic->task->options->jobs;
+   if ( jobs > pool.count ) {
+      jobs = pool.count;
+   }
+   if ( jobs > 0 ) {
+      struct body_worker* workers = mem_alloc( sizeof( *workers ) * jobs );
+      for ( int i = 0; i < jobs; ++i ) {
+         init_worker( &workers[ i ], &pool );
+      }
+      c_init_mutex( &pool.lock );
+      c_init_cond( &pool.body_done );
+      mem_set_lock( &pool.lock );
+      // The calling thread is one of the workers, so the bodies still get
+      // tested when no thread can be started.
+      int started = 1;
+      while ( started < jobs && c_start_thread( &workers[ started ].thread,
+         run_worker, &workers[ started ] ) ) {
+         ++started;
+      }
+      run_worker( &workers[ 0 ] );
+      for ( int i = 1; i < started; ++i ) {
+         c_join_thread( &workers[ i ].thread );
+      }
+      mem_set_lock( NULL );
+      c_deinit_cond( &pool.body_done );
+      c_deinit_mutex( &pool.lock );
+      for ( int i = 0; i < jobs; ++i ) {
+         merge_stats( semantic, &workers[ i ] );
+      }
+      mem_free( workers );
+   }
+   show_diags( &pool );
+   if ( pool.bodies ) {
+      mem_free( pool.bodies );
+   }
+   if ( pool.failed < pool.count ) {
+      s_bail( semantic );
+   }
+}
+
+// The bodies are listed in the order test_objects_bodies_ns() tests them.
+static void collect_bodies( struct body_pool* pool,
+   struct ns_fragment* fragment ) {
+   struct semantic* semantic = pool->semantic;
+   struct list_iter i;
+   list_iterate( &fragment->runnables, &i );
+   while ( ! list_end( &i ) ) {
+      struct node* node = list_data( &i );
+      switch ( node->type ) {
+      case NODE_SCRIPT:
+         add_body( pool, node, fragment );
+         break;
+      case NODE_FUNC:
+         if ( semantic->lib == semantic->main_lib ) {
+            struct func* func = ( struct func* ) node;
+            if ( func->type == FUNC_USER ) {
+               add_body( pool, node, fragment );
+            }
+         }
+         break;
+      case NODE_NAMESPACEFRAGMENT:
+         collect_bodies( pool, ( struct ns_fragment* ) node );
+         break;
+      default:
+         UNREACHABLE();
+         s_bail( semantic );
+      }
+      list_next( &i );
+   }
+}
+
+static void add_body( struct body_pool* pool, struct node* node,
+   struct ns_fragment* fragment ) {
+   if ( pool->count == pool->capacity ) {
+      pool->capacity = pool->capacity > 0 ? pool->capacity * 2 : 64;
+      pool->bodies = mem_realloc( pool->bodies,
+         sizeof( *pool->bodies ) * pool->capacity );
+   }
+   struct body* body = &pool->bodies[ pool->count ];
+   body->node = node;
+   body->fragment = fragment;
+   list_init( &body->diags );
+   body->done = false;
+   body->failed = false;
+   ++pool->count;
+}
+
+static void init_worker( struct body_worker* worker, struct body_pool* pool ) {
+   worker->pool = pool;
+   worker->bail = NULL;
+   worker->index = -1;
+   struct semantic* semantic = &worker->semantic;
+   *semantic = *pool->semantic;
+   semantic->scope = NULL;
+   semantic->func_scope = NULL;
+   semantic->free_scope = NULL;
+   semantic->free_sweep = NULL;
+   semantic->topfunc_test = NULL;
+   semantic->func_test = NULL;
+   semantic->depth = 0;
+   semantic->blocker = NULL;
+   semantic->name_cache.entries = NULL;
+   semantic->name_cache.capacity = 0;
+   semantic->name_cache.size = 0;
+   semantic->worker = worker;
+   semantic->local_names.entries = NULL;
+   semantic->local_names.capacity = 0;
+   semantic->local_names.size = 0;
+   semantic->in_localscope = false;
+   semantic->stats.object_tests = 0;
+   semantic->stats.test_iterations = 0;
+   semantic->stats.name_lookups = 0;
+   semantic->stats.name_cache_hits = 0;
+   semantic->stats.name_cache_misses = 0;
+}
+
+static void run_worker( void* data ) {
+   struct body_worker* worker = data;
+   while ( take_body( worker ) ) {
+      struct body* body = &worker->pool->bodies[ worker->index ];
+      jmp_buf bail;
+      if ( setjmp( bail ) == 0 ) {
+         worker->bail = &bail;
+         test_body( worker, body );
+      }
+      else {
+         body->failed = true;
+      }
+      worker->bail = NULL;
+      finish_body( worker, body );
+      // The scopes of a body that failed are left unpopped, so the worker
+      // cannot test another body.
+      if ( body->failed ) {
+         break;
+      }
+   }
+}
+
+static bool take_body( struct body_worker* worker ) {
+   struct body_pool* pool = worker->pool;
+   bool taken = false;
+   c_lock( &pool->lock );
+   if ( pool->next < pool->failed ) {
+      worker->index = pool->next;
+      ++pool->next;
+      taken = true;
+   }
+   c_unlock( &pool->lock );
+   return taken;
+}
+
+static void test_body( struct body_worker* worker, struct body* body ) {
+   struct semantic* semantic = &worker->semantic;
+   semantic->ns = body->fragment->ns;
+   semantic->ns_fragment = body->fragment;
+   semantic->strong_type = body->fragment->strict;
+   if ( body->node->type == NODE_SCRIPT ) {
+      s_test_script( semantic, ( struct script* ) body->node );
+   }
+   else {
+      s_test_func_body( semantic, ( struct func* ) body->node );
+   }
+}
+
+static void finish_body( struct body_worker* worker, struct body* body ) {
+   struct body_pool* pool = worker->pool;
+   c_lock( &pool->lock );
+   body->done = true;
+   if ( body->failed && worker->index < pool->failed ) {
+      pool->failed = worker->index;
+   }
+   while ( pool->done < pool->count && pool->bodies[ pool->done ].done ) {
+      ++pool->done;
+   }
+   c_wake_all( &pool->body_done );
+   c_unlock( &pool->lock );
+}
+
+static void merge_stats( struct semantic* semantic,
+   struct body_worker* worker ) {
+   semantic->stats.object_tests += worker->semantic.stats.object_tests;
+   semantic->stats.test_iterations += worker->semantic.stats.test_iterations;
+   semantic->stats.name_lookups += worker->semantic.stats.name_lookups;
+   semantic->stats.name_cache_hits += worker->semantic.stats.name_cache_hits;
+   semantic->stats.name_cache_misses +=
+      worker->semantic.stats.name_cache_misses;
+}
+
+// Shows the diagnostics of the bodies up to, and including, the first body
+// that failed.
+static void show_diags( struct body_pool* pool ) {
+   struct task* task = pool->semantic->task;
+   for ( int i = 0; i < pool->count && i <= pool->failed; ++i ) {
+      struct list_iter k;
+      list_iterate( &pool->bodies[ i ].diags, &k );
+      while ( ! list_end( &k ) ) {
+         struct body_diag* diag = list_data( &k );
+         if ( diag->flags & DIAG_FILE ) {
+            t_diag( task, diag->flags, &diag->pos, "%s", diag->text.value );
+         }
+         else {
+            t_diag( task, diag->flags, "%s", diag->text.value );
+         }
+         str_deinit( &diag->text );
+         list_next( &k );
+      }
+   }
+}
+
+void s_buffer_diag( struct semantic* semantic, int flags, va_list* args ) {
+   struct body_worker* worker = semantic->worker;
+   struct body_diag* diag = mem_alloc( sizeof( *diag ) );
+   diag->flags = flags;
+   if ( flags & DIAG_FILE ) {
+      diag->pos = *va_arg( *args, struct pos* );
+   }
+   const char* format = va_arg( *args, const char* );
+   str_init( &diag->text );
+   str_append_format_va( &diag->text, format, args );
+   list_append( &worker->pool->bodies[ worker->index ].diags, diag );
+}
+
+void s_bail_body( struct semantic* semantic ) {
+   longjmp( *semantic->worker->bail, 1 );
+}
+
+void s_lock( struct semantic* semantic ) {
+   if ( semantic->worker ) {
+      c_lock( &semantic->worker->pool->lock );
+   }
+}
+
+void s_unlock( struct semantic* semantic ) {
+   if ( semantic->worker ) {
+      c_unlock( &semantic->worker->pool->lock );
+   }
+}
+
+// Sets a flag of an object that bodies tested on other threads can also set.
+void s_set_flag( struct semantic* semantic, bool* flag ) {
+   s_lock( semantic );
+   *flag = true;
+   s_unlock( semantic );
+}
+
+void s_increment( struct semantic* semantic, int* counter ) {
+   s_lock( semantic );
+   ++*counter;
+   s_unlock( semantic );
+}
+
+struct name* s_extend_name( struct semantic* semantic, struct name* parent,
+   const char* extension ) {
+   s_lock( semantic );
+   struct name* name = t_extend_name( parent, extension );
+   s_unlock( semantic );
+   return name;
+}
+
+struct indexed_string* s_lookup_string( struct semantic* semantic,
+   int index ) {
+   s_lock( semantic );
+   struct indexed_string* string = t_lookup_string( semantic->task, index );
+   s_unlock( semantic );
+   return string;
+}
+
+// A new string waits for every earlier body to be tested, so it gets the index
+// it would get if the bodies were tested one after the other.
+struct indexed_string* s_intern_string( struct semantic* semantic,
+   const char* value, int length ) {
+   struct body_worker* worker = semantic->worker;
+   if ( ! worker ) {
+      return t_intern_string_copy( semantic->task, value, length );
+   }
+   struct body_pool* pool = worker->pool;
+   c_lock( &pool->lock );
+   struct indexed_string* string = t_find_string( semantic->task, value );
+   if ( ! string ) {
+      while ( pool->done < worker->index ) {
+         c_wait( &pool->body_done, &pool->lock );
+      }
+      string = t_intern_string_copy( semantic->task, value, length );
+   }
+   c_unlock( &pool->lock );
+   return string;
+}
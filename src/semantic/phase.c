@@ -1,4 +1,5 @@
 #include <string.h>
+#include <stdint.h>
 
 #include "../common.h"
 #include "phase.h"
@@ -26,6 +27,54 @@ struct ns_link_retriever {
    struct ns_link* link;
 };
 
+// Scripts that share a name (compared case-insensitively) or a number are
+// chained together, in the order they were added.
+struct dup_script {
+   struct script* script;
+   struct dup_script* next;
+   struct dup_script* tail;
+   const char* name;
+   unsigned int hash;
+};
+
+struct dup_script_table {
+   struct dup_script** slots;
+   int capacity;
+};
+
+// An object that could not be resolved waits on the object that blocked it.
+// Waiters are kept in a hash table, by blocker, and are retested only when the
+// blocker gets resolved. An object whose blocker is unknown is stalled, and is
+// retested whenever the other objects make progress.
+struct waiter {
+   struct object* object;
+   struct object* blocker;
+   struct ns_fragment* fragment;
+   struct library* lib;
+   struct waiter* next;
+};
+
+struct name_cache_entry {
+   struct name* name;
+   struct object* object;
+};
+
+struct local_name {
+   struct name* name;
+   struct object* object;
+};
+
+struct worklist {
+   struct waiter** waiters;
+   struct waiter* ready;
+   struct waiter* ready_tail;
+   struct waiter* stalled;
+   struct waiter* free_waiter;
+   struct library* shown_lib;
+   int capacity;
+   bool progress;
+};
+
 static void init_worldglobal_vars( struct semantic* semantic );
 static void test_acs( struct semantic* semantic );
 static void test_module_acs( struct semantic* semantic, struct library* lib );
@@ -68,6 +117,12 @@ static void import_item( struct semantic* semantic, struct ns* ns,
    struct using_dirc* dirc, struct using_item* item );
 static void search_linked_object( struct semantic* semantic,
    struct object_search* search );
+static struct name_cache_entry* find_cached_name( struct semantic* semantic,
+   struct name* name );
+static void cache_name( struct semantic* semantic, struct name* name,
+   struct object* object );
+static void grow_name_cache( struct name_cache* cache );
+static void clear_name_cache( struct semantic* semantic );
 static void test_objects( struct semantic* semantic );
 static void test_all( struct semantic* semantic );
 static void test_lib( struct semantic* semantic, struct library* lib );
@@ -75,14 +130,43 @@ static void test_namespace( struct semantic* semantic,
    struct ns_fragment* fragment );
 static void test_namespace_object( struct semantic* semantic,
    struct object* object );
+static void init_worklist( struct semantic* semantic,
+   struct worklist* worklist );
+static int count_unresolved_objects( struct ns_fragment* fragment );
+static void deinit_worklist( struct worklist* worklist );
+static void add_waiter( struct semantic* semantic, struct worklist* worklist,
+   struct object* object );
+static void wake_waiters( struct worklist* worklist, struct object* object );
+static struct object* first_unresolved_member( struct object* object );
+static void wake_member_waiters( struct worklist* worklist,
+   struct object* object, struct object* first_member );
+static unsigned int hash_pointer( const void* pointer );
+static void run_worklist( struct semantic* semantic,
+   struct worklist* worklist );
+static void test_waiter( struct semantic* semantic, struct worklist* worklist,
+   struct waiter* waiter );
+static void switch_lib( struct semantic* semantic, struct worklist* worklist,
+   struct library* lib );
+static bool prune_all( struct semantic* semantic );
+static bool prune_namespace( struct ns_fragment* fragment );
 static void test_objects_bodies( struct semantic* semantic );
 static void test_objects_bodies_lib( struct semantic* semantic,
    struct library* lib );
 static void test_objects_bodies_ns( struct semantic* semantic,
    struct ns_fragment* fragment );
 static void check_dup_scripts( struct semantic* semantic );
-static void match_dup_script( struct semantic* semantic, struct script* script,
-   struct script* prev_script, bool imported );
+static void init_dup_script_table( struct dup_script_table* table,
+   int max_size );
+static void init_dup_script( struct semantic* semantic,
+   struct dup_script* entry, struct script* script );
+static void add_dup_script( struct dup_script_table* table,
+   struct dup_script* entry );
+static struct dup_script** find_dup_script( struct dup_script_table* table,
+   struct dup_script* entry );
+static void dup_script_err( struct semantic* semantic, struct script* script,
+   struct script* prev_script );
+static void dup_imported_script_warn( struct semantic* semantic,
+   struct script* script, struct script* imported_script );
 static void assign_script_numbers( struct semantic* semantic );
 static void bind_private_name( struct name* name, struct object* object );
 static void bind_func_name( struct semantic* semantic, struct name* name,
@@ -99,6 +183,11 @@ static void init_ns_link_retriever( struct semantic* semantic,
 static void next_ns_link( struct ns_link_retriever* retriever );
 static void dupnameglobal_err( struct semantic* semantic, struct name* name,
    struct object* object );
+static void bind_object( struct semantic* semantic, struct name* name,
+   struct object* object );
+static struct local_name* find_local_name( struct semantic* semantic,
+   struct name* name );
+static void grow_local_names( struct local_names* names );
 static void add_sweep_name( struct semantic* semantic, struct scope* scope,
    struct name* name, struct object* object );
 
@@ -121,8 +210,24 @@ void s_init( struct semantic* semantic, struct task* task ) {
    semantic->retest_nss = false;
    semantic->resolved_objects = false;
    semantic->trigger_err = false;
+   semantic->blocker = NULL;
+   semantic->worklist = NULL;
+   semantic->name_cache.entries = NULL;
+   semantic->name_cache.capacity = 0;
+   semantic->name_cache.size = 0;
+   semantic->type_table = mem_alloc( sizeof( *semantic->type_table ) );
+   s_init_type_table( semantic->type_table );
+   semantic->worker = NULL;
+   semantic->local_names.entries = NULL;
+   semantic->local_names.capacity = 0;
+   semantic->local_names.size = 0;
    semantic->in_localscope = false;
    semantic->strong_type = false;
+   semantic->stats.object_tests = 0;
+   semantic->stats.test_iterations = 0;
+   semantic->stats.name_lookups = 0;
+   semantic->stats.name_cache_hits = 0;
+   semantic->stats.name_cache_misses = 0;
 }
 
 static void init_worldglobal_vars( struct semantic* semantic ) {
@@ -177,10 +282,14 @@ void s_test( struct semantic* semantic ) {
 static void test_bcs( struct semantic* semantic ) {
    init_builtin_namespace_aliases( semantic );
    test_imported_acs_libs( semantic );
+   enum timer timer = t_switch_timer( semantic->task, TIMER_BIND_NAMES );
    bind_names( semantic );
    perform_usings( semantic );
+   t_switch_timer( semantic->task, TIMER_TEST_OBJECTS );
    test_objects( semantic );
+   t_switch_timer( semantic->task, TIMER_TEST_BODIES );
    test_objects_bodies( semantic );
+   t_switch_timer( semantic->task, timer );
    check_dup_scripts( semantic );
    assign_script_numbers( semantic );
    // TODO: Refactor this.
@@ -357,6 +466,7 @@ static void bind_func( struct semantic* semantic, struct func* func ) {
 }
 
 static void show_private_objects( struct semantic* semantic ) {
+   clear_name_cache( semantic );
    struct list_iter i;
    list_iterate( &semantic->lib->private_objects, &i );
    while ( ! list_end( &i ) ) {
@@ -434,6 +544,7 @@ static void show_namespace( struct ns_fragment* fragment ) {
 }
 
 static void hide_private_objects( struct semantic* semantic ) {
+   clear_name_cache( semantic );
    struct list_iter i;
    list_iterate( &semantic->lib->private_objects, &i );
    while ( ! list_end( &i ) ) {
@@ -601,7 +712,7 @@ static void import_item( struct semantic* semantic, struct ns* ns,
    struct object* object;
    switch ( item->type ) {
    case USINGITEM_STRUCT:
-      object = s_get_ns_object( ns, item->name, NODE_STRUCTURE );
+      object = s_get_ns_object( semantic, ns, item->name, NODE_STRUCTURE );
       if ( ! object ) {
          s_diag( semantic, DIAG_POS_ERR, &item->pos,
             "struct `%s` not found", item->name );
@@ -609,7 +720,8 @@ static void import_item( struct semantic* semantic, struct ns* ns,
       }
       break;
    case USINGITEM_ENUM:
-      object = s_get_ns_object( ns, item->name, NODE_ENUMERATION );
+      object = s_get_ns_object( semantic, ns, item->name,
+         NODE_ENUMERATION );
       if ( ! object ) {
          s_diag( semantic, DIAG_POS_ERR, &item->pos,
             "enum `%s` not found", item->name );
@@ -622,7 +734,7 @@ static void import_item( struct semantic* semantic, struct ns* ns,
       }
       break;
    default:
-      object = s_get_ns_object( ns, item->name, NODE_NONE );
+      object = s_get_ns_object( semantic, ns, item->name, NODE_NONE );
       if ( ! object ) {
          s_unknown_ns_object( semantic, ns, item->name, &item->pos );
          s_bail( semantic );
@@ -640,11 +752,12 @@ static void import_item( struct semantic* semantic, struct ns* ns,
    default:
       body = semantic->ns->body;
    }
-   struct name* name = t_extend_name( body, item->usage_name );
+   struct name* name = s_extend_name( semantic, body, item->usage_name );
    // Duplicate imports are allowed as long as both names refer to the same
    // object.
-   if ( name->object && name->object->node.type == NODE_ALIAS ) {
-      struct alias* alias = ( struct alias* ) name->object;
+   struct object* bound_object = s_bound_object( semantic, name );
+   if ( bound_object && bound_object->node.type == NODE_ALIAS ) {
+      struct alias* alias = ( struct alias* ) bound_object;
       if ( alias->target == object ) {
          s_diag( semantic, DIAG_POS | DIAG_WARN, &item->pos,
             "duplicate import of %s`%s`",
@@ -717,7 +830,7 @@ void s_follow_path( struct semantic* semantic, struct follower* follower ) {
       }
       // Middle.
       while ( path->next ) {
-         object = s_get_ns_object( ns, path->text, NODE_NONE );
+         object = s_get_ns_object( semantic, ns, path->text, NODE_NONE );
          if ( ! object ) {
             s_diag( semantic, DIAG_POS_ERR, &path->pos,
                "`%s` not found", path->text );
@@ -732,7 +845,8 @@ void s_follow_path( struct semantic* semantic, struct follower* follower ) {
          path = path->next;
       }
       // Tail.
-      object = s_get_ns_object( ns, path->text, follower->requested_node );
+      object = s_get_ns_object( semantic, ns, path->text,
+         follower->requested_node );
    }
    // Single-part path.
    else {
@@ -787,6 +901,8 @@ void s_init_object_search( struct object_search* search, int requested_node,
 
 void s_search_object( struct semantic* semantic,
    struct object_search* search ) {
+   ++semantic->stats.name_lookups;
+   struct name* cached_name = NULL;
    search->ns = semantic->ns;
    while ( search->ns ) {
       // Search in the namespace.
@@ -801,11 +917,23 @@ void s_search_object( struct semantic* semantic,
       default:
          body = search->ns->body;
       }
-      struct name* name = t_extend_name( body, search->name );
-      if ( name->object ) {
-         search->object = name->object;
+      struct name* name = s_extend_name( semantic, body, search->name );
+      search->object = s_bound_object( semantic, name );
+      if ( search->object ) {
          break;
       }
+      // The rest of the search depends only on the name and the namespace
+      // where the search starts, so its result can be reused.
+      if ( ! cached_name ) {
+         struct name_cache_entry* entry = find_cached_name( semantic, name );
+         if ( entry ) {
+            ++semantic->stats.name_cache_hits;
+            search->object = entry->object;
+            return;
+         }
+         ++semantic->stats.name_cache_misses;
+         cached_name = name;
+      }
       // Search in any of the linked namespaces.
       search_linked_object( semantic, search );
       if ( search->object ) {
@@ -818,6 +946,73 @@ void s_search_object( struct semantic* semantic,
       struct alias* alias = ( struct alias* ) search->object;
       search->object = alias->target;
    }
+   if ( cached_name ) {
+      cache_name( semantic, cached_name, search->object );
+   }
+}
+
+static struct name_cache_entry* find_cached_name( struct semantic* semantic,
+   struct name* name ) {
+   struct name_cache* cache = &semantic->name_cache;
+   if ( cache->size == 0 ) {
+      return NULL;
+   }
+   unsigned int mask = cache->capacity - 1;
+   unsigned int i = hash_pointer( name ) & mask;
+   while ( cache->entries[ i ].name ) {
+      if ( cache->entries[ i ].name == name ) {
+         return &cache->entries[ i ];
+      }
+      i = ( i + 1 ) & mask;
+   }
+   return NULL;
+}
+
+static void cache_name( struct semantic* semantic, struct name* name,
+   struct object* object ) {
+   struct name_cache* cache = &semantic->name_cache;
+   if ( ( cache->size + 1 ) * 2 > cache->capacity ) {
+      grow_name_cache( cache );
+   }
+   unsigned int mask = cache->capacity - 1;
+   unsigned int i = hash_pointer( name ) & mask;
+   while ( cache->entries[ i ].name ) {
+      i = ( i + 1 ) & mask;
+   }
+   cache->entries[ i ].name = name;
+   cache->entries[ i ].object = object;
+   ++cache->size;
+}
+
+static void grow_name_cache( struct name_cache* cache ) {
+   enum { INITIAL_CAPACITY = 256 };
+   struct name_cache_entry* entries = cache->entries;
+   int capacity = cache->capacity;
+   cache->capacity = capacity > 0 ? capacity * 2 : INITIAL_CAPACITY;
+   cache->entries = mem_alloc( sizeof( *cache->entries ) * cache->capacity );
+   memset( cache->entries, 0, sizeof( *cache->entries ) * cache->capacity );
+   unsigned int mask = cache->capacity - 1;
+   for ( int i = 0; i < capacity; ++i ) {
+      if ( entries[ i ].name ) {
+         unsigned int k = hash_pointer( entries[ i ].name ) & mask;
+         while ( cache->entries[ k ].name ) {
+            k = ( k + 1 ) & mask;
+         }
+         cache->entries[ k ] = entries[ i ];
+      }
+   }
+   if ( entries ) {
+      mem_free( entries );
+   }
+}
+
+// Called whenever a namespace-level binding or a namespace link changes.
+static void clear_name_cache( struct semantic* semantic ) {
+   struct name_cache* cache = &semantic->name_cache;
+   if ( cache->size > 0 ) {
+      memset( cache->entries, 0, sizeof( *cache->entries ) * cache->capacity );
+      cache->size = 0;
+   }
 }
 
 static void search_linked_object( struct semantic* semantic,
@@ -826,13 +1021,13 @@ static void search_linked_object( struct semantic* semantic,
    init_ns_link_retriever( semantic, &links, search->ns );
    next_ns_link( &links );
    while ( links.link && ! search->object ) {
-      search->object = s_get_ns_object( links.link->ns, search->name,
-         search->requested_node );
+      search->object = s_get_ns_object( semantic, links.link->ns,
+         search->name, search->requested_node );
       next_ns_link( &links );
    }
    // Make sure no other object with the same name can be found.
-   while ( links.link && ! s_get_ns_object( links.link->ns, search->name,
-      search->requested_node ) ) {
+   while ( links.link && ! s_get_ns_object( semantic, links.link->ns,
+      search->name, search->requested_node ) ) {
       next_ns_link( &links );
    }
    if ( links.link ) {
@@ -853,8 +1048,8 @@ static void search_linked_object( struct semantic* semantic,
       s_diag( semantic, DIAG_POS, &search->object->pos,
          "%s`%s` found here", prefix, search->name );
       while ( links.link ) {
-         struct object* object = s_get_ns_object( links.link->ns, search->name,
-            search->requested_node );
+         struct object* object = s_get_ns_object( semantic, links.link->ns,
+            search->name, search->requested_node );
          if ( object ) {
             s_diag( semantic, DIAG_POS, &object->pos,
                "another %s`%s` found here", prefix, search->name );
@@ -866,8 +1061,8 @@ static void search_linked_object( struct semantic* semantic,
 }
 
 // Retrieves an object from a namespace.
-struct object* s_get_ns_object( struct ns* ns, const char* object_name,
-   int requested_node ) {
+struct object* s_get_ns_object( struct semantic* semantic, struct ns* ns,
+   const char* object_name, int requested_node ) {
    struct name* body;
    switch ( requested_node ) {
    case NODE_STRUCTURE:
@@ -879,7 +1074,7 @@ struct object* s_get_ns_object( struct ns* ns, const char* object_name,
    default:
       body = ns->body;
    }
-   struct name* name = t_extend_name( body, object_name );
+   struct name* name = s_extend_name( semantic, body, object_name );
    if ( name->object ) {
       struct object* object = name->object;
       while ( object->next_scope ) {
@@ -896,10 +1091,26 @@ struct object* s_get_ns_object( struct ns* ns, const char* object_name,
    return NULL;
 }
 
+// Objects are tested in the order they appear once, and afterwards only when
+// an object they are waiting on gets resolved. The objects that are left are
+// tested again in order, as long as something gets resolved, and then one last
+// time to report errors.
 static void test_objects( struct semantic* semantic ) {
+   struct worklist worklist;
+   init_worklist( semantic, &worklist );
+   semantic->worklist = &worklist;
+   ++semantic->stats.test_iterations;
+   test_all( semantic );
+   semantic->worklist = NULL;
+   run_worklist( semantic, &worklist );
+   deinit_worklist( &worklist );
+   if ( ! prune_all( semantic ) ) {
+      return;
+   }
    while ( true ) {
       semantic->retest_nss = false;
       semantic->resolved_objects = false;
+      ++semantic->stats.test_iterations;
       test_all( semantic );
       if ( semantic->retest_nss ) {
          // Continue resolving as long as something got resolved. If nothing
@@ -945,13 +1156,26 @@ static void test_namespace( struct semantic* semantic,
    while ( object ) {
       struct object* next_object = object->next;
       object->next = NULL;
+      semantic->blocker = NULL;
+      struct object* first_member = first_unresolved_member( object );
       test_namespace_object( semantic, object );
+      ++semantic->stats.object_tests;
       if ( object->resolved ) {
          semantic->resolved_objects = true;
       }
       else {
          t_append_unresolved_namespace_object( fragment, object );
       }
+      if ( semantic->worklist &&
+         object->node.type != NODE_NAMESPACEFRAGMENT ) {
+         if ( object->resolved ) {
+            wake_waiters( semantic->worklist, object );
+         }
+         else {
+            add_waiter( semantic, semantic->worklist, object );
+         }
+         wake_member_waiters( semantic->worklist, object, first_member );
+      }
       object = next_object;
    }
    if ( ! fragment->unresolved ) {
@@ -1010,6 +1234,294 @@ static void test_namespace_object( struct semantic* semantic,
    }
 }
 
+static void init_worklist( struct semantic* semantic,
+   struct worklist* worklist ) {
+   int total = 0;
+   struct list_iter i;
+   list_iterate( &semantic->main_lib->dynamic_bcs, &i );
+   while ( ! list_end( &i ) ) {
+      struct library* lib = list_data( &i );
+      total += count_unresolved_objects( lib->upmost_ns_fragment );
+      list_next( &i );
+   }
+   total += count_unresolved_objects(
+      semantic->main_lib->upmost_ns_fragment );
+   worklist->capacity = 1;
+   while ( worklist->capacity < total ) {
+      worklist->capacity <<= 1;
+   }
+   worklist->waiters = mem_alloc( sizeof( *worklist->waiters ) *
+      worklist->capacity );
+   memset( worklist->waiters, 0, sizeof( *worklist->waiters ) *
+      worklist->capacity );
+   worklist->ready = NULL;
+   worklist->ready_tail = NULL;
+   worklist->stalled = NULL;
+   worklist->free_waiter = NULL;
+   worklist->shown_lib = NULL;
+   worklist->progress = false;
+}
+
+static int count_unresolved_objects( struct ns_fragment* fragment ) {
+   int count = 0;
+   struct object* object = fragment->unresolved;
+   while ( object ) {
+      if ( object->node.type == NODE_NAMESPACEFRAGMENT ) {
+         count += count_unresolved_objects( ( struct ns_fragment* ) object );
+      }
+      else {
+         ++count;
+      }
+      object = object->next;
+   }
+   return count;
+}
+
+static void deinit_worklist( struct worklist* worklist ) {
+   for ( int i = 0; i < worklist->capacity; ++i ) {
+      struct waiter* waiter = worklist->waiters[ i ];
+      while ( waiter ) {
+         struct waiter* next = waiter->next;
+         mem_free( waiter );
+         waiter = next;
+      }
+   }
+   mem_free( worklist->waiters );
+   struct waiter* waiter = worklist->stalled;
+   while ( waiter ) {
+      struct waiter* next = waiter->next;
+      mem_free( waiter );
+      waiter = next;
+   }
+   waiter = worklist->free_waiter;
+   while ( waiter ) {
+      struct waiter* next = waiter->next;
+      mem_free( waiter );
+      waiter = next;
+   }
+}
+
+// Makes the object that just failed to resolve wait on the object that blocked
+// it. The waiter is stalled when the blocker is not known, or when the blocker
+// is already resolved and so will never wake the waiter.
+static void add_waiter( struct semantic* semantic, struct worklist* worklist,
+   struct object* object ) {
+   struct waiter* waiter = worklist->free_waiter;
+   if ( waiter ) {
+      worklist->free_waiter = waiter->next;
+   }
+   else {
+      waiter = mem_alloc( sizeof( *waiter ) );
+   }
+   waiter->object = object;
+   waiter->blocker = semantic->blocker;
+   waiter->fragment = semantic->ns_fragment;
+   waiter->lib = semantic->lib;
+   if ( waiter->blocker && ! waiter->blocker->resolved ) {
+      unsigned int slot = hash_pointer( waiter->blocker ) &
+         ( worklist->capacity - 1 );
+      waiter->next = worklist->waiters[ slot ];
+      worklist->waiters[ slot ] = waiter;
+   }
+   else {
+      waiter->next = worklist->stalled;
+      worklist->stalled = waiter;
+   }
+}
+
+// Moves the waiters of a newly resolved object to the ready queue. The stalled
+// objects are retested only after some object gets newly resolved, so this
+// must not be called for an object that was resolved in an earlier test.
+static void wake_waiters( struct worklist* worklist, struct object* object ) {
+   worklist->progress = true;
+   struct waiter** link = &worklist->waiters[ hash_pointer( object ) &
+      ( worklist->capacity - 1 ) ];
+   while ( *link ) {
+      struct waiter* waiter = *link;
+      if ( waiter->blocker == object ) {
+         *link = waiter->next;
+         waiter->next = NULL;
+         if ( worklist->ready ) {
+            worklist->ready_tail->next = waiter;
+         }
+         else {
+            worklist->ready = waiter;
+         }
+         worklist->ready_tail = waiter;
+      }
+      else {
+         link = &waiter->next;
+      }
+   }
+}
+
+// Enumerators and struct members are resolved as part of their enumeration or
+// structure, but objects can wait on them directly. The members are resolved
+// in order, so the members resolved by a test are the ones from the first
+// member that was unresolved before the test.
+static struct object* first_unresolved_member( struct object* object ) {
+   if ( object->node.type == NODE_ENUMERATION ) {
+      struct enumerator* enumerator =
+         ( ( struct enumeration* ) object )->head;
+      while ( enumerator && enumerator->object.resolved ) {
+         enumerator = enumerator->next;
+      }
+      return enumerator ? &enumerator->object : NULL;
+   }
+   else if ( object->node.type == NODE_STRUCTURE ) {
+      struct structure_member* member =
+         ( ( struct structure* ) object )->member;
+      while ( member && member->object.resolved ) {
+         member = member->next;
+      }
+      return member ? &member->object : NULL;
+   }
+   return NULL;
+}
+
+static void wake_member_waiters( struct worklist* worklist,
+   struct object* object, struct object* first_member ) {
+   if ( ! first_member ) {
+      return;
+   }
+   if ( object->node.type == NODE_ENUMERATION ) {
+      struct enumerator* enumerator = ( struct enumerator* ) first_member;
+      while ( enumerator && enumerator->object.resolved ) {
+         wake_waiters( worklist, &enumerator->object );
+         enumerator = enumerator->next;
+      }
+   }
+   else {
+      struct structure_member* member =
+         ( struct structure_member* ) first_member;
+      while ( member && member->object.resolved ) {
+         wake_waiters( worklist, &member->object );
+         member = member->next;
+      }
+   }
+}
+
+static unsigned int hash_pointer( const void* pointer ) {
+   return ( unsigned int ) ( ( uintptr_t ) pointer >> 3 ) * 2654435761u;
+}
+
+static void run_worklist( struct semantic* semantic,
+   struct worklist* worklist ) {
+   struct library* prev_lib = semantic->lib;
+   while ( true ) {
+      while ( worklist->ready ) {
+         struct waiter* waiter = worklist->ready;
+         worklist->ready = waiter->next;
+         test_waiter( semantic, worklist, waiter );
+      }
+      // Retest the stalled objects only when something got resolved since
+      // they were last tested.
+      if ( worklist->stalled && worklist->progress ) {
+         // The stalled waiters are kept in reverse order.
+         worklist->ready_tail = worklist->stalled;
+         while ( worklist->stalled ) {
+            struct waiter* waiter = worklist->stalled;
+            worklist->stalled = waiter->next;
+            waiter->next = worklist->ready;
+            worklist->ready = waiter;
+         }
+         worklist->progress = false;
+         ++semantic->stats.test_iterations;
+      }
+      else {
+         break;
+      }
+   }
+   switch_lib( semantic, worklist, NULL );
+   semantic->lib = prev_lib;
+}
+
+static void test_waiter( struct semantic* semantic, struct worklist* worklist,
+   struct waiter* waiter ) {
+   struct object* object = waiter->object;
+   struct ns_fragment* fragment = waiter->fragment;
+   struct library* lib = waiter->lib;
+   // The waiter is reused when the object has to wait again.
+   waiter->next = worklist->free_waiter;
+   worklist->free_waiter = waiter;
+   if ( object->resolved ) {
+      return;
+   }
+   switch_lib( semantic, worklist, lib );
+   semantic->ns = fragment->ns;
+   semantic->ns_fragment = fragment;
+   semantic->strong_type = fragment->strict;
+   semantic->blocker = NULL;
+   struct object* first_member = first_unresolved_member( object );
+   test_namespace_object( semantic, object );
+   ++semantic->stats.object_tests;
+   if ( object->resolved ) {
+      wake_waiters( worklist, object );
+   }
+   else {
+      add_waiter( semantic, worklist, object );
+   }
+   wake_member_waiters( worklist, object, first_member );
+}
+
+// The private objects of a library are visible only while its objects are
+// tested.
+static void switch_lib( struct semantic* semantic, struct worklist* worklist,
+   struct library* lib ) {
+   if ( worklist->shown_lib != lib ) {
+      if ( worklist->shown_lib ) {
+         semantic->lib = worklist->shown_lib;
+         hide_private_objects( semantic );
+      }
+      if ( lib ) {
+         semantic->lib = lib;
+         show_private_objects( semantic );
+      }
+      worklist->shown_lib = lib;
+   }
+}
+
+// Removes the resolved objects from the lists of unresolved objects. Returns
+// whether any unresolved objects are left.
+static bool prune_all( struct semantic* semantic ) {
+   bool unresolved = false;
+   struct list_iter i;
+   list_iterate( &semantic->main_lib->dynamic_bcs, &i );
+   while ( ! list_end( &i ) ) {
+      struct library* lib = list_data( &i );
+      if ( prune_namespace( lib->upmost_ns_fragment ) ) {
+         unresolved = true;
+      }
+      list_next( &i );
+   }
+   if ( prune_namespace( semantic->main_lib->upmost_ns_fragment ) ) {
+      unresolved = true;
+   }
+   return unresolved;
+}
+
+static bool prune_namespace( struct ns_fragment* fragment ) {
+   struct object* object = fragment->unresolved;
+   fragment->unresolved = NULL;
+   fragment->unresolved_tail = NULL;
+   while ( object ) {
+      struct object* next_object = object->next;
+      object->next = NULL;
+      if ( object->node.type == NODE_NAMESPACEFRAGMENT ) {
+         prune_namespace( ( struct ns_fragment* ) object );
+      }
+      if ( ! object->resolved ) {
+         t_append_unresolved_namespace_object( fragment, object );
+      }
+      object = next_object;
+   }
+   if ( ! fragment->unresolved ) {
+      fragment->object.resolved = true;
+      return false;
+   }
+   return true;
+}
+
 static void test_objects_bodies( struct semantic* semantic ) {
    semantic->trigger_err = true;
    struct list_iter i;
@@ -1026,7 +1538,12 @@ static void test_objects_bodies_lib( struct semantic* semantic,
    struct library* prev_lib = semantic->lib;
    semantic->lib = lib;
    show_private_objects( semantic );
-   test_objects_bodies_ns( semantic, lib->upmost_ns_fragment );
+   if ( semantic->task->options->jobs > 1 ) {
+      s_test_bodies( semantic, lib->upmost_ns_fragment );
+   }
+   else {
+      test_objects_bodies_ns( semantic, lib->upmost_ns_fragment );
+   }
    hide_private_objects( semantic );
    semantic->lib = prev_lib;
 }
@@ -1072,77 +1589,164 @@ static void test_objects_bodies_ns( struct semantic* semantic,
    semantic->strong_type = parent_fragment->strict;
 }
 
+// Scripts are checked in the order they appear. When a script of the library
+// being compiled has a duplicate in the same library, the first duplicate that
+// comes after it is reported as an error. Otherwise, every duplicate found in
+// the imported libraries is reported as a warning.
 static void check_dup_scripts( struct semantic* semantic ) {
+   // Scripts of the library being compiled.
+   int total = list_size( &semantic->main_lib->scripts );
+   struct dup_script* entries = mem_alloc( sizeof( *entries ) * ( total + 1 ) );
+   struct dup_script_table table;
+   init_dup_script_table( &table, total );
    struct list_iter i;
    list_iterate( &semantic->main_lib->scripts, &i );
+   for ( int k = 0; ! list_end( &i ); ++k ) {
+      init_dup_script( semantic, &entries[ k ], list_data( &i ) );
+      add_dup_script( &table, &entries[ k ] );
+      list_next( &i );
+   }
+   // Scripts of imported libraries.
+   int imported_total = 0;
+   list_iterate( &semantic->main_lib->dynamic, &i );
    while ( ! list_end( &i ) ) {
-      struct list_iter k = i;
-      list_next( &k );
-      while ( ! list_end( &k ) ) {
-         match_dup_script( semantic, list_data( &k ), list_data( &i ), false );
-         list_next( &k );
-      }
-      // Check for duplicates in an imported library.
+      struct library* lib = list_data( &i );
+      imported_total += list_size( &lib->scripts );
+      list_next( &i );
+   }
+   struct dup_script* imported_entries = mem_alloc(
+      sizeof( *imported_entries ) * ( imported_total + 1 ) );
+   struct dup_script_table imported_table;
+   init_dup_script_table( &imported_table, imported_total );
+   int k = 0;
+   list_iterate( &semantic->main_lib->dynamic, &i );
+   while ( ! list_end( &i ) ) {
+      struct library* lib = list_data( &i );
       struct list_iter j;
-      list_iterate( &semantic->main_lib->dynamic, &j );
+      list_iterate( &lib->scripts, &j );
       while ( ! list_end( &j ) ) {
-         struct library* lib = list_data( &j );
-         list_iterate( &lib->scripts, &k );
-         while ( ! list_end( &k ) ) {
-            match_dup_script( semantic, list_data( &i ), list_data( &k ),
-               true );
-            list_next( &k );
-         }
+         init_dup_script( semantic, &imported_entries[ k ], list_data( &j ) );
+         add_dup_script( &imported_table, &imported_entries[ k ] );
+         ++k;
          list_next( &j );
       }
       list_next( &i );
    }
+   // Report duplicates.
+   for ( k = 0; k < total; ++k ) {
+      struct dup_script* entry = &entries[ k ];
+      if ( entry->next ) {
+         dup_script_err( semantic, entry->next->script, entry->script );
+      }
+      struct dup_script* imported_entry =
+         *find_dup_script( &imported_table, entry );
+      while ( imported_entry ) {
+         dup_imported_script_warn( semantic, entry->script,
+            imported_entry->script );
+         imported_entry = imported_entry->next;
+      }
+   }
+   mem_free( imported_table.slots );
+   mem_free( imported_entries );
+   mem_free( table.slots );
+   mem_free( entries );
 }
 
-static void match_dup_script( struct semantic* semantic, struct script* script,
-   struct script* prev_script, bool imported ) {
-   // Script names.
-   if ( script->named_script && prev_script->named_script ) {
-      struct indexed_string* name =
-         t_lookup_string( semantic->task, script->number->value );
-      struct indexed_string* prev_name =
-         t_lookup_string( semantic->task, prev_script->number->value );
-      if ( bcc_stricmp( name->value, prev_name->value ) == 0 ) {
-         if ( imported ) {
-            s_diag( semantic, DIAG_POS | DIAG_WARN, &script->pos,
-               "script \"%s\" already found in an imported library",
-               name->value );
-            s_diag( semantic, DIAG_POS, &prev_script->pos,
-               "script in imported library found here" );
-         }
-         else {
-            s_diag( semantic, DIAG_POS_ERR, &script->pos,
-               "duplicate script \"%s\"", name->value );
-            s_diag( semantic, DIAG_POS, &prev_script->pos,
-               "script already found here" );
-            s_bail( semantic );
-         }
-      }
+static void init_dup_script_table( struct dup_script_table* table,
+   int max_size ) {
+   // Keep the table at most half full.
+   table->capacity = 1;
+   while ( table->capacity < max_size * 2 ) {
+      table->capacity <<= 1;
+   }
+   table->slots = mem_alloc( sizeof( *table->slots ) * table->capacity );
+   memset( table->slots, 0, sizeof( *table->slots ) * table->capacity );
+}
+
+static void init_dup_script( struct semantic* semantic,
+   struct dup_script* entry, struct script* script ) {
+   entry->script = script;
+   entry->next = NULL;
+   entry->tail = entry;
+   if ( script->named_script ) {
+      entry->name = t_lookup_string( semantic->task,
+         script->number->value )->value;
+      entry->hash = c_hash_str_nocase( entry->name );
+   }
+   else {
+      entry->name = NULL;
+      entry->hash = ( unsigned int ) script->number->value * 2654435761u;
+   }
+}
+
+static void add_dup_script( struct dup_script_table* table,
+   struct dup_script* entry ) {
+   struct dup_script** slot = find_dup_script( table, entry );
+   if ( *slot ) {
+      ( *slot )->tail->next = entry;
+      ( *slot )->tail = entry;
    }
-   // Script numbers.
-   else if ( ! script->named_script && ! prev_script->named_script ) {
-      if ( script->number->value == prev_script->number->value ) {
-         if ( imported ) {
-            s_diag( semantic, DIAG_POS | DIAG_WARN, &script->pos,
-               "script %d already found in an imported library",
-               script->number->value );
-            s_diag( semantic, DIAG_POS, &prev_script->pos,
-               "script in imported library found here" );
+   else {
+      *slot = entry;
+   }
+}
+
+// Returns the slot that holds the first script with the same name or number
+// as the specified script, or the empty slot where such a script would go.
+static struct dup_script** find_dup_script( struct dup_script_table* table,
+   struct dup_script* entry ) {
+   unsigned int mask = table->capacity - 1;
+   unsigned int i = entry->hash & mask;
+   while ( table->slots[ i ] ) {
+      struct dup_script* other = table->slots[ i ];
+      if ( other->hash == entry->hash ) {
+         if ( entry->name && other->name ) {
+            if ( bcc_stricmp( entry->name, other->name ) == 0 ) {
+               break;
+            }
          }
-         else {
-            s_diag( semantic, DIAG_POS_ERR, &script->pos,
-               "duplicate script %d", script->number->value );
-            s_diag( semantic, DIAG_POS, &prev_script->pos,
-               "script already found here" );
-            s_bail( semantic );
+         else if ( ! entry->name && ! other->name ) {
+            if ( entry->script->number->value ==
+               other->script->number->value ) {
+               break;
+            }
          }
       }
+      i = ( i + 1 ) & mask;
+   }
+   return &table->slots[ i ];
+}
+
+static void dup_script_err( struct semantic* semantic, struct script* script,
+   struct script* prev_script ) {
+   if ( script->named_script ) {
+      s_diag( semantic, DIAG_POS_ERR, &script->pos,
+         "duplicate script \"%s\"", t_lookup_string( semantic->task,
+            script->number->value )->value );
+   }
+   else {
+      s_diag( semantic, DIAG_POS_ERR, &script->pos,
+         "duplicate script %d", script->number->value );
    }
+   s_diag( semantic, DIAG_POS, &prev_script->pos,
+      "script already found here" );
+   s_bail( semantic );
+}
+
+static void dup_imported_script_warn( struct semantic* semantic,
+   struct script* script, struct script* imported_script ) {
+   if ( script->named_script ) {
+      s_diag( semantic, DIAG_POS | DIAG_WARN, &script->pos,
+         "script \"%s\" already found in an imported library",
+         t_lookup_string( semantic->task, script->number->value )->value );
+   }
+   else {
+      s_diag( semantic, DIAG_POS | DIAG_WARN, &script->pos,
+         "script %d already found in an imported library",
+         script->number->value );
+   }
+   s_diag( semantic, DIAG_POS, &imported_script->pos,
+      "script in imported library found here" );
 }
 
 static void assign_script_numbers( struct semantic* semantic ) {
@@ -1191,7 +1795,8 @@ void s_pop_scope( struct semantic* semantic ) {
          // Remove names.
          for ( int i = 0; i < sweep->size; ++i ) {
             struct name* name = sweep->names[ i ];
-            name->object = name->object->next_scope;
+            bind_object( semantic, name,
+               s_bound_object( semantic, name )->next_scope );
          }
          // Reuse sweep.
          struct sweep* prev = sweep->prev;
@@ -1201,6 +1806,9 @@ void s_pop_scope( struct semantic* semantic ) {
       }
    }
    struct scope* scope = semantic->scope;
+   if ( scope->ns_link ) {
+      clear_name_cache( semantic );
+   }
    semantic->scope = scope->prev;
    if ( scope == semantic->func_scope ) {
       semantic->func_scope = scope->prev_func_scope;
@@ -1218,6 +1826,7 @@ void s_bind_name( struct semantic* semantic, struct name* name,
       dupname_err( semantic, name, object );
    }
    name->object = object;
+   clear_name_cache( semantic );
 }
 
 // Binds namespace-level private objects.
@@ -1242,7 +1851,9 @@ void s_bind_local_name( struct semantic* semantic, struct name* name,
 // Function scope.
 static void bind_func_name( struct semantic* semantic, struct name* name,
    struct object* object ) {
-   if ( ! name->object || name->object->depth < semantic->func_scope->depth ) {
+   struct object* bound_object = s_bound_object( semantic, name );
+   if ( ! bound_object ||
+      bound_object->depth < semantic->func_scope->depth ) {
       add_sweep_name( semantic, semantic->func_scope, name, object );
    }
    else {
@@ -1253,7 +1864,8 @@ static void bind_func_name( struct semantic* semantic, struct name* name,
 // Local scope.
 static void bind_block_name( struct semantic* semantic, struct name* name,
    struct object* object ) {
-   if ( ! name->object || name->object->depth < semantic->depth ) {
+   struct object* bound_object = s_bound_object( semantic, name );
+   if ( ! bound_object || bound_object->depth < semantic->depth ) {
       add_sweep_name( semantic, semantic->scope, name, object );
    }
    else {
@@ -1273,13 +1885,14 @@ static void dupname_err( struct semantic* semantic, struct name* name,
    t_copy_name( name, false, &object_name );
    s_diag( semantic, DIAG_POS_ERR, &object->pos,
       "duplicate %s name, `%s`", category, object_name.value );
-   if ( name->object->pos.id == INTERNALFILE_COMPILER ) {
-      s_diag( semantic, DIAG_POS | DIAG_NOTE, &name->object->pos,
+   struct object* bound_object = s_bound_object( semantic, name );
+   if ( bound_object->pos.id == INTERNALFILE_COMPILER ) {
+      s_diag( semantic, DIAG_POS | DIAG_NOTE, &bound_object->pos,
          "`%s` is the name of a builtin %s", object_name.value,
-         ( name->object->node.type == NODE_FUNC ) ? "function" : "object" );         
+         ( bound_object->node.type == NODE_FUNC ) ? "function" : "object" );         
    }
    else {
-      s_diag( semantic, DIAG_POS | DIAG_NOTE, &name->object->pos,
+      s_diag( semantic, DIAG_POS | DIAG_NOTE, &bound_object->pos,
          "`%s` is the name of this %s", object_name.value, category );
    }
    s_bail( semantic );
@@ -1295,6 +1908,7 @@ static void unbind_name( struct name* name, struct object* object ) {
 
 static void insert_namespace_link( struct semantic* semantic,
    struct ns_link* link, bool block_scope ) {
+   clear_name_cache( semantic );
    if ( semantic->in_localscope ) {
       struct scope* target_scope = ( block_scope ) ?
          semantic->scope :
@@ -1379,18 +1993,95 @@ static void add_sweep_name( struct semantic* semantic, struct scope* scope,
    sweep->names[ sweep->size ] = name;
    ++sweep->size;
    object->depth = scope->depth;
-   object->next_scope = name->object;
-   name->object = object;
+   object->next_scope = s_bound_object( semantic, name );
+   bind_object( semantic, name, object );
+}
+
+// Returns the object a name refers to in the scope being tested.
+struct object* s_bound_object( struct semantic* semantic, struct name* name ) {
+   if ( semantic->worker ) {
+      struct local_name* entry = find_local_name( semantic, name );
+      if ( entry && entry->name ) {
+         return entry->object;
+      }
+   }
+   return name->object;
+}
+
+static void bind_object( struct semantic* semantic, struct name* name,
+   struct object* object ) {
+   if ( semantic->worker ) {
+      struct local_names* names = &semantic->local_names;
+      if ( ( names->size + 1 ) * 2 > names->capacity ) {
+         grow_local_names( names );
+      }
+      struct local_name* entry = find_local_name( semantic, name );
+      if ( ! entry->name ) {
+         entry->name = name;
+         ++names->size;
+      }
+      entry->object = object;
+   }
+   else {
+      name->object = object;
+   }
+}
+
+// Returns the entry of the name, or the empty entry where the name should be
+// placed. An entry is kept after its scope is popped, holding the
+// namespace-level object again.
+static struct local_name* find_local_name( struct semantic* semantic,
+   struct name* name ) {
+   struct local_names* names = &semantic->local_names;
+   if ( names->capacity == 0 ) {
+      return NULL;
+   }
+   unsigned int mask = names->capacity - 1;
+   unsigned int i = hash_pointer( name ) & mask;
+   while ( names->entries[ i ].name && names->entries[ i ].name != name ) {
+      i = ( i + 1 ) & mask;
+   }
+   return &names->entries[ i ];
+}
+
+static void grow_local_names( struct local_names* names ) {
+   enum { INITIAL_CAPACITY = 64 };
+   struct local_name* entries = names->entries;
+   int capacity = names->capacity;
+   names->capacity = capacity > 0 ? capacity * 2 : INITIAL_CAPACITY;
+   names->entries = mem_alloc( sizeof( *names->entries ) * names->capacity );
+   memset( names->entries, 0, sizeof( *names->entries ) * names->capacity );
+   unsigned int mask = names->capacity - 1;
+   for ( int i = 0; i < capacity; ++i ) {
+      if ( entries[ i ].name ) {
+         unsigned int k = hash_pointer( entries[ i ].name ) & mask;
+         while ( names->entries[ k ].name ) {
+            k = ( k + 1 ) & mask;
+         }
+         names->entries[ k ] = entries[ i ];
+      }
+   }
+   if ( entries ) {
+      mem_free( entries );
+   }
 }
 
 void s_diag( struct semantic* semantic, int flags, ... ) {
    va_list args;
    va_start( args, flags );
-   t_diag_args( semantic->task, flags, &args );
+   if ( semantic->worker ) {
+      s_buffer_diag( semantic, flags, &args );
+   }
+   else {
+      t_diag_args( semantic->task, flags, &args );
+   }
    va_end( args );
 }
 
 void s_bail( struct semantic* semantic ) {
+   if ( semantic->worker ) {
+      s_bail_body( semantic );
+   }
    t_bail( semantic->task );
 }
 
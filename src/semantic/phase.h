@@ -22,6 +22,45 @@ struct object_search {
    int requested_node;
 };
 
+// Remembers where the names not found in the current namespace were found, so
+// the linked and parent namespaces are searched only once for each name. The
+// cache is cleared whenever a result could change: when a name is bound at
+// namespace level, when the private objects of a library are shown or hidden,
+// when a namespace link is inserted, and when a scope holding namespace links
+// is popped.
+struct name_cache {
+   struct name_cache_entry* entries;
+   int capacity;
+   int size;
+};
+
+// Canonical types. Every distinct type, and every distinct reference chain,
+// parameter list, and dimension list a type is made of, is interned into a
+// single node, so two types are the same exactly when their nodes are the
+// same. A node is made of up to four earlier nodes or objects and up to four
+// integers, see type.c for the layout of each kind.
+struct type_node {
+   struct type_node* chain;
+   const void* part[ 4 ];
+   int value[ 4 ];
+   unsigned int hash;
+};
+
+struct type_table {
+   struct type_node** buckets;
+   int capacity;
+   int size;
+};
+
+// While the bodies are tested on several threads, a name bound in a local
+// scope is kept in a table of the thread instead of in the name itself, which
+// holds only the namespace-level object. See parallel.c.
+struct local_names {
+   struct local_name* entries;
+   int capacity;
+   int size;
+};
+
 struct type_info {
    struct ref* ref;
    struct structure* structure;
@@ -35,6 +74,9 @@ struct type_info {
       struct ref_array array;
       struct ref_func func;
    } implicit_ref;
+   // Canonical form of the type. Found when the type is first compared and
+   // cleared whenever the type changes.
+   struct type_node* node;
    bool builtin_func;
 };
 
@@ -69,7 +111,7 @@ struct stmt_test {
 };
 
 struct expr_test {
-   jmp_buf bail;
+   jmp_buf* bail;
    struct type_info type;
    struct buildmsg* buildmsg;
    struct name* name_offset;
@@ -137,11 +179,27 @@ struct semantic {
    struct var* global_arrays[ MAX_GLOBAL_VARS ];
    struct type_info type_int;
    int depth;
+   // The object that kept the object being tested from getting resolved.
+   struct object* blocker;
+   struct worklist* worklist;
+   struct name_cache name_cache;
+   struct type_table* type_table;
+   // Set while the bodies are tested on several threads.
+   struct body_worker* worker;
+   struct local_names local_names;
    bool retest_nss;
    bool resolved_objects;
    bool trigger_err;
    bool in_localscope;
    bool strong_type;
+   // Reported by the -time-report option.
+   struct {
+      int object_tests;
+      int test_iterations;
+      int name_lookups;
+      int name_cache_hits;
+      int name_cache_misses;
+   } stats;
 };
 
 void s_init( struct semantic* semantic, struct task* task );
@@ -178,6 +236,20 @@ void s_diag( struct semantic* semantic, int flags, ... );
 void s_bail( struct semantic* semantic );
 void p_test_inline_asm( struct semantic* semantic, struct stmt_test* test,
    struct inline_asm* inline_asm );
+void s_init_type_table( struct type_table* table );
+void s_test_bodies( struct semantic* semantic, struct ns_fragment* fragment );
+void s_buffer_diag( struct semantic* semantic, int flags, va_list* args );
+void s_bail_body( struct semantic* semantic );
+void s_lock( struct semantic* semantic );
+void s_unlock( struct semantic* semantic );
+void s_set_flag( struct semantic* semantic, bool* flag );
+void s_increment( struct semantic* semantic, int* counter );
+struct name* s_extend_name( struct semantic* semantic, struct name* parent,
+   const char* extension );
+struct indexed_string* s_lookup_string( struct semantic* semantic, int index );
+struct indexed_string* s_intern_string( struct semantic* semantic,
+   const char* value, int length );
+struct object* s_bound_object( struct semantic* semantic, struct name* name );
 void s_init_type_info( struct type_info* type, struct ref* ref,
    struct structure* structure, struct enumeration* enumeration,
    struct dim* dim, int spec, int storage );
@@ -193,8 +265,10 @@ void s_init_type_info_func( struct type_info* type, struct ref* ref,
 void s_init_type_info_builtin_func( struct type_info* type );
 void s_init_type_info_scalar( struct type_info* type, int spec );
 void s_init_type_info_null( struct type_info* type );
-bool s_same_type( struct type_info* a, struct type_info* b );
-bool s_instance_of( struct type_info* type, struct type_info* instance );
+bool s_same_type( struct semantic* semantic, struct type_info* a,
+   struct type_info* b );
+bool s_instance_of( struct semantic* semantic, struct type_info* type,
+   struct type_info* instance );
 void s_present_type( struct type_info* type, struct str* string );
 bool s_is_ref_type( struct type_info* type );
 bool s_is_value_type( struct type_info* type );
@@ -230,8 +304,8 @@ void s_type_mismatch( struct semantic* semantic, const char* label_a,
    struct pos* pos );
 void s_test_nested_func( struct semantic* semantic, struct func* func );
 int s_spec( struct semantic* semantic, int spec );
-struct object* s_get_ns_object( struct ns* ns, const char* object_name,
-   int requested_node );
+struct object* s_get_ns_object( struct semantic* semantic, struct ns* ns,
+   const char* object_name, int requested_node );
 bool s_is_enumerator( struct type_info* type );
 bool s_is_null( struct type_info* type );
 bool s_is_nullable( struct type_info* type );
@@ -244,13 +318,14 @@ enum subscript_result s_subscript_array_ref( struct semantic* semantic,
    struct type_info* type, struct type_info* element_type );
 enum type_description s_describe_type( struct type_info* type );
 bool s_is_ref( struct type_info* type );
-bool s_common_type( struct type_info* a, struct type_info* b,
-   struct type_info* result );
+bool s_common_type( struct semantic* semantic, struct type_info* a,
+   struct type_info* b, struct type_info* result );
 bool s_is_void( struct type_info* type );
 void s_reveal( struct type_info* type );
 bool s_is_str( struct type_info* type );
 bool s_is_struct_ref( struct type_info* type );
-bool s_same_storageignored_type( struct type_info* a, struct type_info* b );
+bool s_same_storageignored_type( struct semantic* semantic,
+   struct type_info* a, struct type_info* b );
 void s_init_magic_id( struct magic_id* magic_id, int name );
 
 #endif
@@ -169,7 +169,8 @@ static void init_builtin_aliases( struct semantic* semantic,
 static void bind_builtin_aliases( struct semantic* semantic,
    struct builtin_aliases* aliases ) {
    if ( aliases->append.used ) {
-      struct name* name = t_extend_name( semantic->ns->body, "append" );
+      struct name* name = s_extend_name( semantic, semantic->ns->body,
+         "append" );
       s_bind_local_name( semantic, name, &aliases->append.alias.object, true );
    }
 }
@@ -259,7 +260,7 @@ static void test_case( struct semantic* semantic, struct stmt_test* test,
       s_bail( semantic );
    }
    // Check case type.
-   if ( ! s_same_type( &expr.type, &switch_test->cond_type ) ) {
+   if ( ! s_same_type( semantic, &expr.type, &switch_test->cond_type ) ) {
       s_type_mismatch( semantic, "case-value", &expr.type,
          "switch-condition", &switch_test->cond_type,
          &label->number->pos );
@@ -268,7 +269,7 @@ static void test_case( struct semantic* semantic, struct stmt_test* test,
    // For a string-based switch statement, make sure each case is a valid
    // string.
    if ( switch_test->cond_type.spec == SPEC_STR &&
-      ! t_lookup_string( semantic->task, label->number->value ) ) {
+      ! s_lookup_string( semantic, label->number->value ) ) {
       s_diag( semantic, DIAG_POS_ERR, &label->number->pos,
          "case value not a valid string" );
       s_bail( semantic );
@@ -363,7 +364,7 @@ static void test_assert( struct semantic* semantic, struct stmt_test* test,
       s_test_expr( semantic, &test, assert->message );
       struct type_info required_type;
       s_init_type_info_scalar( &required_type, SPEC_STR );
-      if ( ! s_instance_of( &required_type, &test.type ) ) {
+      if ( ! s_instance_of( semantic, &required_type, &test.type ) ) {
          s_type_mismatch( semantic, "argument", &test.type,
             "required", &required_type, &assert->message->pos );
          s_bail( semantic );
@@ -381,7 +382,7 @@ static void test_assert( struct semantic* semantic, struct stmt_test* test,
       if ( ! assert->cond->value ) {
          struct indexed_string* string = NULL;
          if ( assert->message ) {
-            string = t_lookup_string( semantic->task,
+            string = s_lookup_string( semantic,
                assert->message->value );
             if ( ! string ) {
                s_diag( semantic, DIAG_POS_ERR, &assert->message->pos,
@@ -760,9 +761,9 @@ static void test_foreach( struct semantic* semantic, struct stmt_test* test,
             "variables)" );
          s_bail( semantic );
       }
-      expr.var->addr_taken = true;
+      s_set_flag( semantic, &expr.var->addr_taken );
       if ( expr.structure_member ) {
-         expr.structure_member->addr_taken = true;
+         s_set_flag( semantic, &expr.structure_member->addr_taken );
       }
    }
    // Key.
@@ -771,7 +772,7 @@ static void test_foreach( struct semantic* semantic, struct stmt_test* test,
       struct type_info type;
       s_init_type_info( &type, key->ref, key->structure, key->enumeration,
          key->dim, key->spec, key->storage );
-      if ( ! s_instance_of( &type, &iter.key ) ) {
+      if ( ! s_instance_of( semantic, &type, &iter.key ) ) {
          s_type_mismatch( semantic, "key", &type,
             "collection-key", &iter.key, &key->object.pos );
          s_bail( semantic );
@@ -782,7 +783,7 @@ static void test_foreach( struct semantic* semantic, struct stmt_test* test,
    struct type_info type;
    s_init_type_info( &type, value->ref, value->structure, value->enumeration,
       value->dim, value->spec, value->storage );
-   if ( ! s_instance_of( &type, &iter.value ) ) {
+   if ( ! s_instance_of( semantic, &type, &iter.value ) ) {
       s_type_mismatch( semantic, "value", &type,
          "collection-value", &iter.value, &value->object.pos );
       s_bail( semantic );
@@ -953,7 +954,7 @@ static void test_return_value( struct semantic* semantic,
       struct type_info return_type;
       s_init_type_info( &return_type, func->ref, func->structure,
          func->enumeration, NULL, func->return_spec, STORAGE_LOCAL );
-      if ( ! s_instance_of( &return_type, &expr.type ) ) {
+      if ( ! s_instance_of( semantic, &return_type, &expr.type ) ) {
          s_type_mismatch( semantic, "return-value", &expr.type,
             "function-return", &return_type, &stmt->return_value->pos );
          s_bail( semantic );
@@ -974,9 +975,9 @@ static void test_return_value( struct semantic* semantic,
             "variables)" );
          s_bail( semantic );
       }
-      expr.var->addr_taken = true;
+      s_set_flag( semantic, &expr.var->addr_taken );
       if ( expr.structure_member ) {
-         expr.structure_member->addr_taken = true;
+         s_set_flag( semantic, &expr.structure_member->addr_taken );
       }
    }
 }
@@ -1056,7 +1057,7 @@ static void test_paltrans_arg( struct semantic* semantic, struct expr* arg,
    struct type_info required_type;
    s_init_type_info_scalar( &required_type, s_spec( semantic,
       require_fixed_type ? SPEC_FIXED : SPEC_INT ) );
-   if ( ! s_instance_of( &required_type, &expr.type ) ) {
+   if ( ! s_instance_of( semantic, &required_type, &expr.type ) ) {
       s_type_mismatch( semantic, "argument", &expr.type,
          "required", &required_type, &arg->pos );
       s_bail( semantic );
@@ -1,15 +1,41 @@
 #include <string.h>
+#include <stdint.h>
 
 #include "phase.h"
 
+// The kind of a type node is stored in its first value. The other fields hold:
+//   TYPENODE_TYPE:  part = { ref, dim, structure, enumeration },
+//                   value = { kind, spec }
+//   TYPENODE_REF:   part = { next, params }, value = { kind, type, ... }, where
+//                   the rest of the values are { dim_count, storage } for an
+//                   array reference, { storage } for a structure reference,
+//                   and { local } for a function reference
+//   TYPENODE_PARAM: part = { next, ref }, value = { kind, spec }
+//   TYPENODE_DIM:   part = { next }, value = { kind, length }
+enum {
+   TYPENODE_TYPE,
+   TYPENODE_REF,
+   TYPENODE_PARAM,
+   TYPENODE_DIM
+};
+
 static void create_implicit_ref( struct type_info* type );
-static bool same_ref( struct ref* a, struct ref* b );
-static bool same_ref_struct( struct ref_struct* a, struct ref_struct* b );
-static bool same_ref_array( struct ref_array* a, struct ref_array* b );
-static bool same_ref_func( struct ref_func* a, struct ref_func* b );
+static struct type_node* type_node( struct semantic* semantic,
+   struct type_info* type );
+static struct type_node* ref_node( struct semantic* semantic,
+   struct ref* ref );
+static struct type_node* param_node( struct semantic* semantic,
+   struct param* param );
+static struct type_node* dim_node( struct semantic* semantic,
+   struct dim* dim );
+static void init_type_node( struct type_node* node, int kind );
+static struct type_node* intern_type_node( struct type_table* table,
+   struct type_node* key );
+static unsigned int hash_type_node( struct type_node* node );
+static bool same_type_node( struct type_node* a, struct type_node* b );
+static void grow_type_table( struct type_table* table );
 static bool same_spec_primitive( int a, int b );
 static bool compatible_raw_spec( int spec );
-static bool same_dim( struct dim* a, struct dim* b );
 static void present_extended_spec( struct structure* structure,
    struct enumeration* enumeration, int spec, struct str* string );
 static void present_spec( int spec, struct str* string );
@@ -19,6 +45,12 @@ static void present_param_list( struct param* param, struct str* string );
 static struct ref* dup_ref( struct ref* ref );
 static void set_storage( struct type_info* type, int storage );
 
+void s_init_type_table( struct type_table* table ) {
+   table->buckets = NULL;
+   table->capacity = 0;
+   table->size = 0;
+}
+
 void s_init_type_info( struct type_info* type, struct ref* ref,
    struct structure* structure, struct enumeration* enumeration,
    struct dim* dim, int spec, int storage ) {
@@ -28,6 +60,7 @@ void s_init_type_info( struct type_info* type, struct ref* ref,
    type->dim = dim;
    type->spec = spec;
    type->storage = storage;
+   type->node = NULL;
    type->builtin_func = false;
    if ( type->ref && type->ref->implicit ) {
       create_implicit_ref( type );
@@ -83,6 +116,7 @@ void s_init_type_info_array_ref( struct type_info* type, struct ref* ref,
    struct ref_array* array = &type->implicit_ref.array;
    array->ref.next = type->ref;
    array->ref.type = REF_ARRAY;
+   array->ref.type_node = NULL;
    array->ref.nullable = false;
    array->ref.implicit = true;
    array->dim_count = dim_count;
@@ -102,6 +136,7 @@ void s_init_type_info_func( struct type_info* type, struct ref* ref,
    struct ref_func* func = &type->implicit_ref.func;
    func->ref.next = type->ref;
    func->ref.type = REF_FUNCTION;
+   func->ref.type_node = NULL;
    func->ref.nullable = false;
    func->ref.implicit = true;
    func->params = params;
@@ -125,6 +160,7 @@ void s_init_type_info_null( struct type_info* type ) {
    struct ref* ref = &type->implicit_ref.ref;
    ref->next = NULL;
    ref->type = REF_NULL;
+   ref->type_node = NULL;
    ref->nullable = true;
    ref->implicit = true;
    type->ref = ref;
@@ -136,6 +172,7 @@ void s_decay( struct semantic* semantic, struct type_info* type ) {
       struct ref_array* array = &type->implicit_ref.array;
       array->ref.next = type->ref;
       array->ref.type = REF_ARRAY;
+      array->ref.type_node = NULL;
       array->ref.nullable = false;
       array->ref.implicit = true;
       array->dim_count = 0;
@@ -147,24 +184,29 @@ void s_decay( struct semantic* semantic, struct type_info* type ) {
       }
       type->ref = &array->ref;
       type->dim = NULL;
+      type->node = NULL;
    }
    // Structure type.
    else if ( ! type->ref && type->structure ) {
       struct ref_struct* implicit_ref = &type->implicit_ref.structure;
       implicit_ref->ref.next = NULL;
       implicit_ref->ref.type = REF_STRUCTURE;
+      implicit_ref->ref.type_node = NULL;
       implicit_ref->ref.nullable = false;
       implicit_ref->ref.implicit = true;
       implicit_ref->storage = type->storage;
       type->ref = &implicit_ref->ref;
+      type->node = NULL;
    }
    // Enumeration type.
    else if ( ! type->ref && type->enumeration ) {
       type->spec = s_spec( semantic, type->enumeration->base_type );
+      type->node = NULL;
    }
 }
 
-bool s_same_type( struct type_info* a, struct type_info* b ) {
+bool s_same_type( struct semantic* semantic, struct type_info* a,
+   struct type_info* b ) {
    if ( s_is_null( a ) ) {
       return s_is_ref( b );
    }
@@ -177,69 +219,174 @@ bool s_same_type( struct type_info* a, struct type_info* b ) {
          return ( s_describe_type( b ) == TYPEDESC_PRIMITIVE &&
             same_spec_primitive( a->spec, b->spec ) );
       default:
-         return ( same_ref( a->ref, b->ref ) &&
-            a->structure == b->structure &&
-            a->enumeration == b->enumeration &&
-            a->spec == b->spec &&
-            same_dim( a->dim, b->dim ) );
+         return ( type_node( semantic, a ) == type_node( semantic, b ) );
       }
    }
 }
 
-static bool same_ref( struct ref* a, struct ref* b ) {
-   while ( a && b ) {
-      if ( ! ( a->type == b->type ) ) {
-         return false;
-      }
-      bool same = false;
-      switch ( a->type ) {
-      case REF_ARRAY:
-         same = same_ref_array(
-            ( struct ref_array* ) a,
-            ( struct ref_array* ) b );
+// The nodes kept in references and parameters can be shared by bodies being
+// tested on other threads, so they are read and filled in under the lock.
+static struct type_node* type_node( struct semantic* semantic,
+   struct type_info* type ) {
+   if ( ! type->node ) {
+      s_lock( semantic );
+      struct type_node key;
+      init_type_node( &key, TYPENODE_TYPE );
+      key.part[ 0 ] = ref_node( semantic, type->ref );
+      key.part[ 1 ] = dim_node( semantic, type->dim );
+      key.part[ 2 ] = type->structure;
+      key.part[ 3 ] = type->enumeration;
+      key.value[ 1 ] = type->spec;
+      type->node = intern_type_node( semantic->type_table, &key );
+      s_unlock( semantic );
+   }
+   return type->node;
+}
+
+// The node of a reference is kept in the reference, so the rest of a chain
+// shared by many types is interned only once.
+static struct type_node* ref_node( struct semantic* semantic,
+   struct ref* ref ) {
+   if ( ! ref ) {
+      return NULL;
+   }
+   if ( ! ref->type_node ) {
+      struct type_node key;
+      init_type_node( &key, TYPENODE_REF );
+      key.part[ 0 ] = ref_node( semantic, ref->next );
+      key.value[ 1 ] = ref->type;
+      switch ( ref->type ) {
+      case REF_ARRAY: {
+            struct ref_array* array = ( struct ref_array* ) ref;
+            key.value[ 2 ] = array->dim_count;
+            key.value[ 3 ] = array->storage;
+         }
+         break;
+      case REF_STRUCTURE: {
+            struct ref_struct* structure = ( struct ref_struct* ) ref;
+            key.value[ 2 ] = structure->storage;
+         }
          break;
-      case REF_FUNCTION:
-         same = same_ref_func(
-            ( struct ref_func* ) a,
-            ( struct ref_func* ) b );
+      case REF_FUNCTION: {
+            struct ref_func* func = ( struct ref_func* ) ref;
+            key.part[ 1 ] = param_node( semantic, func->params );
+            key.value[ 2 ] = func->local;
+         }
          break;
-      case REF_STRUCTURE:
-      case REF_NULL:
-         same = same_ref_struct(
-            ( struct ref_struct* ) a,
-            ( struct ref_struct* ) b );
+      default:
          break;
       }
-      if ( ! same ) {
-         return false;
-      }
-      a = a->next;
-      b = b->next;
+      ref->type_node = intern_type_node( semantic->type_table, &key );
+   }
+   return ref->type_node;
+}
+
+static struct type_node* param_node( struct semantic* semantic,
+   struct param* param ) {
+   if ( ! param ) {
+      return NULL;
+   }
+   if ( ! param->type_node ) {
+      struct type_node key;
+      init_type_node( &key, TYPENODE_PARAM );
+      key.part[ 0 ] = param_node( semantic, param->next );
+      key.part[ 1 ] = ref_node( semantic, param->ref );
+      key.value[ 1 ] = param->spec;
+      param->type_node = intern_type_node( semantic->type_table, &key );
    }
-   return ( a == NULL && b == NULL );
+   return param->type_node;
 }
 
-static bool same_ref_struct( struct ref_struct* a, struct ref_struct* b ) {
-   return ( a->storage == b->storage );
+// The length of an implicit dimension is filled in by the initializer, which
+// can happen after the dimension is first compared, so the node of a dimension
+// is not kept.
+static struct type_node* dim_node( struct semantic* semantic,
+   struct dim* dim ) {
+   if ( ! dim ) {
+      return NULL;
+   }
+   struct type_node key;
+   init_type_node( &key, TYPENODE_DIM );
+   key.part[ 0 ] = dim_node( semantic, dim->next );
+   key.value[ 1 ] = dim->length;
+   return intern_type_node( semantic->type_table, &key );
+}
+
+static void init_type_node( struct type_node* node, int kind ) {
+   node->chain = NULL;
+   for ( int i = 0; i < ARRAY_SIZE( node->part ); ++i ) {
+      node->part[ i ] = NULL;
+      node->value[ i ] = 0;
+   }
+   node->value[ 0 ] = kind;
+   node->hash = 0;
+}
+
+static struct type_node* intern_type_node( struct type_table* table,
+   struct type_node* key ) {
+   key->hash = hash_type_node( key );
+   if ( table->size > 0 ) {
+      struct type_node* node =
+         table->buckets[ key->hash & ( table->capacity - 1 ) ];
+      while ( node ) {
+         if ( node->hash == key->hash && same_type_node( node, key ) ) {
+            return node;
+         }
+         node = node->chain;
+      }
+   }
+   if ( table->size >= table->capacity ) {
+      grow_type_table( table );
+   }
+   struct type_node* node = mem_alloc( sizeof( *node ) );
+   *node = *key;
+   unsigned int i = node->hash & ( table->capacity - 1 );
+   node->chain = table->buckets[ i ];
+   table->buckets[ i ] = node;
+   ++table->size;
+   return node;
 }
 
-static bool same_ref_array( struct ref_array* a, struct ref_array* b ) {
-   return ( a->dim_count == b->dim_count && a->storage == b->storage );
+static unsigned int hash_type_node( struct type_node* node ) {
+   unsigned int hash = 2166136261u;
+   for ( int i = 0; i < ARRAY_SIZE( node->part ); ++i ) {
+      uintptr_t part = ( uintptr_t ) node->part[ i ] >> 3;
+      hash = ( hash ^ ( unsigned int ) part ) * 16777619u;
+      hash = ( hash ^ ( unsigned int ) node->value[ i ] ) * 16777619u;
+   }
+   return hash;
 }
 
-static bool same_ref_func( struct ref_func* a, struct ref_func* b ) {
-   struct param* param_a = a->params;
-   struct param* param_b = b->params;
-   while ( param_a && param_b &&
-      param_a->spec == param_b->spec &&
-      same_ref( param_a->ref, param_b->ref ) ) {
-      param_a = param_a->next;
-      param_b = param_b->next;
+static bool same_type_node( struct type_node* a, struct type_node* b ) {
+   for ( int i = 0; i < ARRAY_SIZE( a->part ); ++i ) {
+      if ( ! ( a->part[ i ] == b->part[ i ] &&
+         a->value[ i ] == b->value[ i ] ) ) {
+         return false;
+      }
+   }
+   return true;
+}
+
+static void grow_type_table( struct type_table* table ) {
+   enum { INITIAL_CAPACITY = 256 };
+   struct type_node** buckets = table->buckets;
+   int capacity = table->capacity;
+   table->capacity = capacity > 0 ? capacity * 2 : INITIAL_CAPACITY;
+   table->buckets = mem_alloc( sizeof( *table->buckets ) * table->capacity );
+   memset( table->buckets, 0, sizeof( *table->buckets ) * table->capacity );
+   unsigned int mask = table->capacity - 1;
+   for ( int i = 0; i < capacity; ++i ) {
+      struct type_node* node = buckets[ i ];
+      while ( node ) {
+         struct type_node* next = node->chain;
+         node->chain = table->buckets[ node->hash & mask ];
+         table->buckets[ node->hash & mask ] = node;
+         node = next;
+      }
+   }
+   if ( buckets ) {
+      mem_free( buckets );
    }
-   return (
-      param_a == NULL &&
-      param_b == NULL &&
-      a->local == b->local );
 }
 
 static bool same_spec_primitive( int a, int b ) {
@@ -267,17 +414,9 @@ static bool compatible_raw_spec( int spec ) {
    }
 }
 
-static bool same_dim( struct dim* a, struct dim* b ) {
-   while ( a && b && a->length == b->length ) {
-      a = a->next;
-      b = b->next;
-   }
-   return ( a == NULL && b == NULL );
-}
-
-bool s_common_type( struct type_info* a, struct type_info* b,
-   struct type_info* result ) {
-   if ( s_same_type( a, b ) ) {
+bool s_common_type( struct semantic* semantic, struct type_info* a,
+   struct type_info* b, struct type_info* result ) {
+   if ( s_same_type( semantic, a, b ) ) {
       switch ( s_describe_type( a ) ) {
       case TYPEDESC_ARRAYREF:
       case TYPEDESC_STRUCTREF:
@@ -323,7 +462,8 @@ bool s_common_type( struct type_info* a, struct type_info* b,
    return false;
 }
 
-bool s_instance_of( struct type_info* type, struct type_info* instance ) {
+bool s_instance_of( struct semantic* semantic, struct type_info* type,
+   struct type_info* instance ) {
    bool valid = false;
    switch ( s_describe_type( type ) ) {
    case TYPEDESC_ARRAYREF:
@@ -333,11 +473,11 @@ bool s_instance_of( struct type_info* type, struct type_info* instance ) {
          valid = type->ref->nullable;
       }
       else if ( ! type->ref->nullable ) {
-         valid = ( s_same_type( type, instance ) &&
+         valid = ( s_same_type( semantic, type, instance ) &&
             ! instance->ref->nullable );
       }
       else {
-         valid = s_same_type( type, instance );
+         valid = s_same_type( semantic, type, instance );
       }
       break;
    case TYPEDESC_ENUM:
@@ -345,11 +485,11 @@ bool s_instance_of( struct type_info* type, struct type_info* instance ) {
          struct type_info revealed_type;
          s_init_type_info_copy( &revealed_type, instance );
          s_reveal( &revealed_type );
-         valid = s_same_type( type, &revealed_type );
+         valid = s_same_type( semantic, type, &revealed_type );
       }
       break;
    case TYPEDESC_PRIMITIVE:
-      valid = s_same_type( type, instance );
+      valid = s_same_type( semantic, type, instance );
       break;
    default:
       break;
@@ -638,15 +778,13 @@ bool s_is_onedim_int_array_ref( struct semantic* semantic,
 }
 
 bool s_is_int_value( struct type_info* type ) {
-   struct type_info required_type;
-   s_init_type_info_scalar( &required_type, SPEC_INT );
-   return s_same_type( &required_type, type );
+   return ( s_describe_type( type ) == TYPEDESC_PRIMITIVE &&
+      same_spec_primitive( SPEC_INT, type->spec ) );
 }
 
 bool s_is_str_value( struct type_info* type ) {
-   struct type_info required_type;
-   s_init_type_info_scalar( &required_type, SPEC_STR );
-   return s_same_type( &required_type, type );
+   return ( s_describe_type( type ) == TYPEDESC_PRIMITIVE &&
+      same_spec_primitive( SPEC_STR, type->spec ) );
 }
 
 bool s_is_enumerator( struct type_info* type ) {
@@ -723,6 +861,7 @@ void s_reveal( struct type_info* type ) {
    case TYPEDESC_PRIMITIVE:
       if ( type->enumeration ) {
          type->spec = SPEC_ENUM;
+         type->node = NULL;
       }
       break;
    default:
@@ -739,14 +878,15 @@ bool s_is_struct_ref( struct type_info* type ) {
    return ( s_describe_type( type ) == TYPEDESC_STRUCTREF );
 }
 
-bool s_same_storageignored_type( struct type_info* a, struct type_info* b ) {
+bool s_same_storageignored_type( struct semantic* semantic,
+   struct type_info* a, struct type_info* b ) {
    struct type_info temp_a;
    struct type_info temp_b;
    s_init_type_info_copy( &temp_a, a );
    s_init_type_info_copy( &temp_b, b );
    set_storage( &temp_a, STORAGE_MAP );
    set_storage( &temp_b, STORAGE_MAP );
-   return s_same_type( &temp_a, &temp_b );
+   return s_same_type( semantic, &temp_a, &temp_b );
 }
 
 static void set_storage( struct type_info* type, int storage ) {
@@ -759,16 +899,19 @@ static void set_storage( struct type_info* type, int storage ) {
          {
             struct ref_array* array = ( struct ref_array* ) type->ref;
             array->storage = storage;
+            array->ref.type_node = NULL;
          }
          break;
       case REF_STRUCTURE:
          {
             struct ref_struct* structure = ( struct ref_struct* ) type->ref;
             structure->storage = storage;
+            structure->ref.type_node = NULL;
          }
          break;
       default:
          break;
       }
+      type->node = NULL;
    }
 }
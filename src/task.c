@@ -35,17 +35,37 @@ static void decode_pos( struct task* task, struct pos* pos,
    struct include_history_entry** file, int* line, int* column );
 static const char* decode_filename( struct task* task,
    struct include_history_entry* entry );
+static void append_first_path( struct file_query* query );
+static struct file_search* find_search( struct task* task,
+   struct file_query* query, unsigned int hash );
+static struct file_search* add_search( struct task* task,
+   struct file_query* query, unsigned int hash );
 static bool identify_file( struct task* task, struct file_query* query );
 static bool identify_file_relative( struct task* task,
    struct file_query* query );
+static bool read_fileid( struct task* task, struct file_query* query );
 static struct file_entry* add_file( struct task* task,
    struct file_query* query );
+static void grow_file_entries( struct file_table* table );
+static void grow_file_searches( struct file_table* table );
 static struct file_entry* create_file_entry( struct task* task,
    struct file_query* query );
 static void link_file_entry( struct task* task, struct file_entry* entry );
+static void init_entry_vector( struct entry_vector* vector );
+static void append_vector_entry( struct entry_vector* vector, void* entry );
+static void* get_vector_entry( struct entry_vector* vector, int id );
+static struct name* find_child_name( struct name* parent, char ch );
+static struct name* add_child_name( struct name* parent, char ch );
+static void create_name_table( struct name* name );
+static int get_name_table_index( char ch );
 static struct indexed_string* intern_string( struct task* task,
    struct str_table* table, const char* value, int length, bool copy_value );
+static struct indexed_string** find_string_slot( struct str_table* table,
+   const char* value, unsigned int hash );
+static void grow_str_table( struct str_table* table );
 static void init_ref( struct ref* ref, int type );
+static void add_text_pages( struct task* task, struct text_buffer* buffer,
+   int count );
 
 void t_init( struct task* task, struct options* options, jmp_buf* bail,
    struct str* compiler_dir ) {
@@ -53,7 +73,31 @@ void t_init( struct task* task, struct options* options, jmp_buf* bail,
    task->err_file = NULL;
    task->bail = bail;
    task->text_buffer = NULL;
+   task->text_pages = NULL;
+   task->text_page_capacity = 0;
+   task->text_page_count = 0;
+   // The empty text is interned first, so its offset is zero.
+   t_intern_text( task, "", 0 );
    task->file_entries = NULL;
+   init_entry_vector( &task->file_entry_vector );
+   task->file_table.entries = NULL;
+   task->file_table.searches = NULL;
+   task->file_table.entry_capacity = 0;
+   task->file_table.entry_count = 0;
+   task->file_table.search_capacity = 0;
+   task->file_table.search_count = 0;
+   task->file_stats.searches = 0;
+   task->file_stats.cached_searches = 0;
+   task->file_stats.queries = 0;
+   task->file_stats.saved_queries = 0;
+   for ( int i = 0; i < TIMER_TOTAL; ++i ) {
+      task->timers.wall[ i ] = 0.0;
+      task->timers.cpu[ i ] = 0.0;
+   }
+   task->timers.wall_start = c_get_wall_time();
+   task->timers.cpu_start = ( double ) clock() / CLOCKS_PER_SEC;
+   task->timers.current = TIMER_NONE;
+   task->timers.cpu_timer = TIMER_NONE;
    init_str_table( &task->str_table );
    init_str_table( &task->script_name_table );
    task->empty_string = t_intern_string( task, "", 0 );
@@ -123,6 +167,7 @@ void t_init( struct task* task, struct options* options, jmp_buf* bail,
    task->blank_name = task->upmost_ns->body;
 
    list_init( &task->include_history );
+   init_entry_vector( &task->include_history_vector );
    task->last_diag_file = NULL;
    add_internal_file( task, "<none>" );
    add_internal_file( task, "<compiler>" );
@@ -183,7 +228,9 @@ void t_append_unresolved_namespace_object( struct ns_fragment* fragment,
 static void init_str_table( struct str_table* table ) {
    table->head = NULL;
    table->tail = NULL;
-   table->root = NULL;
+   table->slots = NULL;
+   table->strings = NULL;
+   table->capacity = 0;
    table->size = 0;
 }
 
@@ -192,55 +239,116 @@ struct name* t_create_name( void ) {
    name->parent = NULL;
    name->next = NULL;
    name->drop = NULL;
+   name->table = NULL;
    name->object = NULL;
    name->ch = 0;
+   name->num_children = 0;
    return name;
 }
 
 struct name* t_extend_name( struct name* parent, const char* extension ) {
-   struct name* name = parent->drop;
    const char* ch = extension;
    while ( *ch ) {
-      // Find the correct node to enter.
-      struct name* prev = NULL;
-      while ( name && name->ch < *ch ) {
-         prev = name;
-         name = name->next;
-      }
-      // Enter a new node if no node could be found.
-      if ( ! name ) {
-         name = t_create_name();
-         name->parent = parent;
-         name->ch = *ch;
-         if ( prev ) {
-            prev->next = name;
-         }
-         else {
-            parent->drop = name;
-         }
-      }
+      struct name* name = find_child_name( parent, *ch );
       // Enter a new node if no node with the same character exists in the
       // parent node.
-      else if ( name->ch != *ch ) {
-         struct name* smaller_name = t_create_name();
-         smaller_name->next = name;
-         smaller_name->parent = parent;
-         smaller_name->ch = *ch;
-         name = smaller_name;
-         if ( prev ) {
-            prev->next = name;
-         }
-         else {
-            parent->drop = name;
-         }
+      if ( ! name ) {
+         name = add_child_name( parent, *ch );
       }
       parent = name;
-      name = name->drop;
       ++ch;
    }
    return parent;
 }
 
+static struct name* find_child_name( struct name* parent, char ch ) {
+   if ( parent->table ) {
+      int index = get_name_table_index( ch );
+      if ( index >= 0 ) {
+         return parent->table->children[ index ];
+      }
+   }
+   struct name* name = parent->drop;
+   while ( name && name->ch < ch ) {
+      name = name->next;
+   }
+   if ( name && name->ch == ch ) {
+      return name;
+   }
+   return NULL;
+}
+
+static struct name* add_child_name( struct name* parent, char ch ) {
+   struct name* name = t_create_name();
+   name->parent = parent;
+   name->ch = ch;
+   struct name* prev = NULL;
+   struct name* next = parent->drop;
+   while ( next && next->ch < ch ) {
+      prev = next;
+      next = next->next;
+   }
+   name->next = next;
+   if ( prev ) {
+      prev->next = name;
+   }
+   else {
+      parent->drop = name;
+   }
+   if ( parent->table ) {
+      int index = get_name_table_index( ch );
+      if ( index >= 0 ) {
+         parent->table->children[ index ] = name;
+      }
+   }
+   else {
+      enum { TABLE_MIN_CHILDREN = 8 };
+      ++parent->num_children;
+      if ( parent->num_children >= TABLE_MIN_CHILDREN ) {
+         create_name_table( parent );
+      }
+   }
+   return name;
+}
+
+static void create_name_table( struct name* name ) {
+   name->table = mem_alloc( sizeof( *name->table ) );
+   for ( int i = 0; i < NAME_TABLE_SIZE; ++i ) {
+      name->table->children[ i ] = NULL;
+   }
+   struct name* child = name->drop;
+   while ( child ) {
+      int index = get_name_table_index( child->ch );
+      if ( index >= 0 ) {
+         name->table->children[ index ] = child;
+      }
+      child = child->next;
+   }
+}
+
+// The table holds letters, digits, the underscore, and the dot, which are the
+// characters used in identifiers and in the separators of names.
+static int get_name_table_index( char ch ) {
+   if ( ch >= 'a' && ch <= 'z' ) {
+      return ch - 'a';
+   }
+   else if ( ch >= 'A' && ch <= 'Z' ) {
+      return 26 + ( ch - 'A' );
+   }
+   else if ( ch >= '0' && ch <= '9' ) {
+      return 52 + ( ch - '0' );
+   }
+   else if ( ch == '_' ) {
+      return 62;
+   }
+   else if ( ch == '.' ) {
+      return 63;
+   }
+   else {
+      return -1;
+   }
+}
+
 void t_copy_name( struct name* start, bool full, struct str* str ) {
    int length = 0;
    struct name* name = start;
@@ -334,6 +442,7 @@ struct include_history_entry* t_alloc_include_history_entry(
    entry->line = 0;
    entry->imported = false;
    list_append( &task->include_history, entry );
+   append_vector_entry( &task->include_history_vector, entry );
    return entry;
 }
 
@@ -470,30 +579,28 @@ static void decode_pos( struct task* task, struct pos* pos,
 
 struct include_history_entry* t_decode_include_history_entry(
    struct task* task, int id ) {
-   struct list_iter i;
-   list_iterate( &task->include_history, &i );
-   while ( ! list_end( &i ) ) {
-      struct include_history_entry* entry = list_data( &i );
-      while ( entry->id == id ) {
-         return entry;
-      }
-      list_next( &i );
+   struct include_history_entry* entry = get_vector_entry(
+      &task->include_history_vector, id );
+   if ( entry ) {
+      return entry;
    }
    return list_head( &task->include_history );
 }
 
+struct file_entry* t_decode_file_entry( struct task* task, int id ) {
+   return get_vector_entry( &task->file_entry_vector, id );
+}
+
 static const char* decode_filename( struct task* task,
    struct include_history_entry* entry ) {
    if ( entry->altern_name ) {
       return entry->altern_name;
    }
    else {
-      struct file_entry* file_entry = task->file_entries;
-      while ( file_entry ) {
-         if ( file_entry->id == entry->file_entry_id ) {
-            return file_entry->path.value;
-         }
-         file_entry = file_entry->next;
+      struct file_entry* file_entry = get_vector_entry(
+         &task->file_entry_vector, entry->file_entry_id );
+      if ( file_entry ) {
+         return file_entry->path.value;
       }
       return NULL;
    }
@@ -531,6 +638,28 @@ bool t_same_pos( struct pos* a, struct pos* b ) {
       a->column == b->column );
 }
 
+// Switches to the specified part of the compilation, and returns the previous
+// part, so it can be switched back to. The CPU clock is read only when
+// switching to a part other than lexing or preprocessing.
+enum timer t_switch_timer( struct task* task, enum timer timer ) {
+   enum timer prev_timer = task->timers.current;
+   if ( task->options->time_report != TIME_REPORT_NONE ) {
+      double wall = c_get_wall_time();
+      task->timers.wall[ prev_timer ] += wall - task->timers.wall_start;
+      task->timers.wall_start = wall;
+      if ( timer != TIMER_LEX && timer != TIMER_PREPROCESS &&
+         timer != task->timers.cpu_timer ) {
+         double cpu = ( double ) clock() / CLOCKS_PER_SEC;
+         task->timers.cpu[ task->timers.cpu_timer ] +=
+            cpu - task->timers.cpu_start;
+         task->timers.cpu_start = cpu;
+         task->timers.cpu_timer = timer;
+      }
+   }
+   task->timers.current = timer;
+   return prev_timer;
+}
+
 void t_init_file_query( struct file_query* query, struct file_entry* offset_file,
    const char* path ) {
    query->given_path = path;
@@ -545,47 +674,120 @@ void t_find_file( struct task* task, struct file_query* query ) {
    struct str path;
    str_init( &path );
    query->path = &path;
-   if ( identify_file( task, query ) ) {
-      query->file = add_file( task, query );
-      query->success = true;
+   append_first_path( query );
+   unsigned int hash = c_hash_str( path.value );
+   struct file_search* search = find_search( task, query, hash );
+   if ( search ) {
+      ++task->file_stats.cached_searches;
+      task->file_stats.saved_queries += search->queries;
    }
-   str_deinit( &path );
-}
-
-static bool identify_file( struct task* task, struct file_query* query ) {
-   // Absolute path.
-   if ( c_is_absolute_path( query->given_path ) ) {
-      str_append( query->path, query->given_path );
-      return c_read_fileid( &query->fileid, query->path->value );
-   }
-   // Relative path.
    else {
-      return identify_file_relative( task, query );
+      search = add_search( task, query, hash );
+      int queries = task->file_stats.queries;
+      if ( identify_file( task, query ) ) {
+         search->file = add_file( task, query );
+      }
+      search->queries = task->file_stats.queries - queries;
    }
+   ++task->file_stats.searches;
+   if ( search->file ) {
+      query->file = search->file;
+      query->fileid = search->file->file_id;
+      query->success = true;
+   }
+   str_deinit( &path );
 }
 
-static bool identify_file_relative( struct task* task,
-   struct file_query* query ) {
-   // Try directory of current file.
-   if ( query->offset_file ) {
+// The first path tried is the given path. A relative path is first tried
+// relative to the directory of the current file.
+static void append_first_path( struct file_query* query ) {
+   if ( query->offset_file && ! c_is_absolute_path( query->given_path ) ) {
       str_copy( query->path, query->offset_file->path.value,
          query->offset_file->path.length );
       c_extract_dirname( query->path );
       if ( query->path->length > 0 ) {
          str_append( query->path, OS_PATHSEP );
       }
-      str_append( query->path, query->given_path );
-      if ( c_read_fileid( &query->fileid, query->path->value ) ) {
-         return true;
-      }
    }
-   // Try path directly.
-   else {
-      str_append( query->path, query->given_path );
-      if ( c_read_fileid( &query->fileid, query->path->value ) ) {
-         return true;
+   str_append( query->path, query->given_path );
+}
+
+static struct file_search* find_search( struct task* task,
+   struct file_query* query, unsigned int hash ) {
+   struct file_table* table = &task->file_table;
+   if ( table->search_count == 0 ) {
+      return NULL;
+   }
+   struct file_search* search =
+      table->searches[ hash & ( table->search_capacity - 1 ) ];
+   while ( search && ! ( search->hash == hash &&
+      strcmp( search->path.value, query->path->value ) == 0 &&
+      strcmp( search->given_path, query->given_path ) == 0 ) ) {
+      search = search->next;
+   }
+   return search;
+}
+
+static struct file_search* add_search( struct task* task,
+   struct file_query* query, unsigned int hash ) {
+   struct file_table* table = &task->file_table;
+   if ( table->search_count >= table->search_capacity / 2 ) {
+      grow_file_searches( table );
+   }
+   struct file_search* search = mem_alloc( sizeof( *search ) );
+   search->file = NULL;
+   str_init( &search->path );
+   str_append( &search->path, query->path->value );
+   search->given_path = t_intern_text( task, query->given_path,
+      strlen( query->given_path ) );
+   search->hash = hash;
+   search->queries = 0;
+   struct file_search** bucket =
+      &table->searches[ hash & ( table->search_capacity - 1 ) ];
+   search->next = *bucket;
+   *bucket = search;
+   ++table->search_count;
+   return search;
+}
+
+static void grow_file_searches( struct file_table* table ) {
+   int capacity = table->search_capacity > 0 ?
+      table->search_capacity * 2 : 64;
+   struct file_search** searches = mem_alloc( sizeof( *searches ) *
+      capacity );
+   memset( searches, 0, sizeof( *searches ) * capacity );
+   for ( int i = 0; i < table->search_capacity; ++i ) {
+      struct file_search* search = table->searches[ i ];
+      while ( search ) {
+         struct file_search* next = search->next;
+         struct file_search** bucket =
+            &searches[ search->hash & ( capacity - 1 ) ];
+         search->next = *bucket;
+         *bucket = search;
+         search = next;
       }
    }
+   if ( table->searches ) {
+      mem_free( table->searches );
+   }
+   table->searches = searches;
+   table->search_capacity = capacity;
+}
+
+// The first path is already in the query.
+static bool identify_file( struct task* task, struct file_query* query ) {
+   if ( read_fileid( task, query ) ) {
+      return true;
+   }
+   // Only a relative path is searched for in the include directories.
+   if ( c_is_absolute_path( query->given_path ) ) {
+      return false;
+   }
+   return identify_file_relative( task, query );
+}
+
+static bool identify_file_relative( struct task* task,
+   struct file_query* query ) {
    // Try user-specified directories.
    struct list_iter i;
    list_iterate( &task->options->includes, &i );
@@ -595,7 +797,7 @@ static bool identify_file_relative( struct task* task,
       str_append( query->path, include );
       str_append( query->path, OS_PATHSEP );
       str_append( query->path, query->given_path );
-      if ( c_read_fileid( &query->fileid, query->path->value ) ) {
+      if ( read_fileid( task, query ) ) {
          return true;
       }
       list_next( &i );
@@ -605,33 +807,78 @@ static bool identify_file_relative( struct task* task,
    str_append( query->path, task->lib_dir.value );
    str_append( query->path, OS_PATHSEP );
    str_append( query->path, query->given_path );
-   if ( c_read_fileid( &query->fileid, query->path->value ) ) {
+   if ( read_fileid( task, query ) ) {
       return true;
    }
    return false;
 }
 
+static bool read_fileid( struct task* task, struct file_query* query ) {
+   ++task->file_stats.queries;
+   return c_read_fileid( &query->fileid, query->path->value );
+}
+
 static struct file_entry* add_file( struct task* task,
    struct file_query* query ) {
-   struct file_entry* entry = task->file_entries;
-   while ( entry ) {
-      if ( c_same_fileid( &query->fileid, &entry->file_id ) ) {
-         return entry;
+   struct file_table* table = &task->file_table;
+   unsigned int hash = c_hash_fileid( &query->fileid );
+   if ( table->entry_count > 0 ) {
+      struct file_entry* entry =
+         table->entries[ hash & ( table->entry_capacity - 1 ) ];
+      while ( entry ) {
+         if ( c_same_fileid( &query->fileid, &entry->file_id ) ) {
+            return entry;
+         }
+         entry = entry->hash_next;
+      }
+   }
+   if ( table->entry_count >= table->entry_capacity / 2 ) {
+      grow_file_entries( table );
+   }
+   struct file_entry* entry = create_file_entry( task, query );
+   struct file_entry** bucket =
+      &table->entries[ hash & ( table->entry_capacity - 1 ) ];
+   entry->hash_next = *bucket;
+   *bucket = entry;
+   ++table->entry_count;
+   return entry;
+}
+
+static void grow_file_entries( struct file_table* table ) {
+   int capacity = table->entry_capacity > 0 ?
+      table->entry_capacity * 2 : 64;
+   struct file_entry** entries = mem_alloc( sizeof( *entries ) * capacity );
+   memset( entries, 0, sizeof( *entries ) * capacity );
+   for ( int i = 0; i < table->entry_capacity; ++i ) {
+      struct file_entry* entry = table->entries[ i ];
+      while ( entry ) {
+         struct file_entry* next = entry->hash_next;
+         struct file_entry** bucket = &entries[
+            c_hash_fileid( &entry->file_id ) & ( capacity - 1 ) ];
+         entry->hash_next = *bucket;
+         *bucket = entry;
+         entry = next;
       }
-      entry = entry->next;
    }
-   return create_file_entry( task, query );
+   if ( table->entries ) {
+      mem_free( table->entries );
+   }
+   table->entries = entries;
+   table->entry_capacity = capacity;
 }
 
 static struct file_entry* create_file_entry( struct task* task,
    struct file_query* query ) {
    struct file_entry* entry = mem_alloc( sizeof( *entry ) );
    entry->next = NULL;
+   entry->hash_next = NULL;
    entry->file_id = query->fileid;
    str_init( &entry->path );
    str_append( &entry->path, query->path->value );
    str_init( &entry->full_path );
    c_read_full_path( query->path->value, &entry->full_path );
+   entry->guard = NULL;
+   entry->lines = 0;
    entry->id = task->last_id;
    ++task->last_id;
    link_file_entry( task, entry );
@@ -639,16 +886,39 @@ static struct file_entry* create_file_entry( struct task* task,
 }
 
 static void link_file_entry( struct task* task, struct file_entry* entry ) {
-   if ( task->file_entries ) {
-      struct file_entry* prev = task->file_entries;
-      while ( prev->next ) {
-         prev = prev->next;
-      }
+   struct entry_vector* vector = &task->file_entry_vector;
+   if ( vector->size > 0 ) {
+      struct file_entry* prev = vector->entries[ vector->size - 1 ];
       prev->next = entry;
    }
    else {
       task->file_entries = entry;
    }
+   append_vector_entry( vector, entry );
+}
+
+static void init_entry_vector( struct entry_vector* vector ) {
+   vector->entries = NULL;
+   vector->capacity = 0;
+   vector->size = 0;
+}
+
+// The ID of the entry must be the size of the vector.
+static void append_vector_entry( struct entry_vector* vector, void* entry ) {
+   if ( vector->size == vector->capacity ) {
+      vector->capacity = vector->capacity > 0 ? vector->capacity * 2 : 64;
+      vector->entries = mem_realloc( vector->entries,
+         sizeof( *vector->entries ) * vector->capacity );
+   }
+   vector->entries[ vector->size ] = entry;
+   ++vector->size;
+}
+
+static void* get_vector_entry( struct entry_vector* vector, int id ) {
+   if ( id >= 0 && id < vector->size ) {
+      return vector->entries[ id ];
+   }
+   return NULL;
 }
 
 struct library* t_add_library( struct task* task ) {
@@ -696,25 +966,61 @@ char* t_intern_text( struct task* task, const char* value, int length ) {
    return text;
 }
 
+unsigned int t_intern_text_offset( struct task* task, const char* value,
+   int length ) {
+   struct text_buffer* buffer = t_get_text_buffer( task, length + 1 );
+   memcpy( buffer->left, value, length + 1 );
+   unsigned int offset = buffer->offset + ( buffer->left - buffer->start );
+   buffer->left += length + 1;
+   return offset;
+}
+
 struct text_buffer* t_get_text_buffer( struct task* task,
    int min_free_size ) {
    struct text_buffer* buffer = task->text_buffer;
    if ( ! buffer || buffer->end - buffer->left < min_free_size ) {
       buffer = mem_alloc( sizeof( *buffer ) );
       buffer->prev = task->text_buffer;
-      enum { INITIAL_SIZE = 1 << 15 };
-      unsigned int size = INITIAL_SIZE;
+      unsigned int size = TEXT_PAGE_SIZE;
       while ( size < ( unsigned int ) min_free_size ) {
          size <<= 1;
       }
       buffer->start = mem_alloc( sizeof( char ) * size );
       buffer->end = buffer->start + size;
       buffer->left = buffer->start;
+      buffer->offset = ( unsigned int ) task->text_page_count <<
+         TEXT_PAGE_SHIFT;
+      add_text_pages( task, buffer, size >> TEXT_PAGE_SHIFT );
       task->text_buffer = buffer;
    }
    return buffer;
 }
 
+static void add_text_pages( struct task* task, struct text_buffer* buffer,
+   int count ) {
+   // The offsets are 32-bit.
+   enum { MAX_PAGES = 1 << ( 32 - TEXT_PAGE_SHIFT ) };
+   if ( task->text_page_count + count > MAX_PAGES ) {
+      t_diag( task, DIAG_ERR, "too much text (more than 4 GB)" );
+      t_bail( task );
+   }
+   if ( task->text_page_count + count > task->text_page_capacity ) {
+      int capacity = task->text_page_capacity > 0 ?
+         task->text_page_capacity : 64;
+      while ( capacity < task->text_page_count + count ) {
+         capacity *= 2;
+      }
+      task->text_pages = mem_realloc( task->text_pages,
+         sizeof( *task->text_pages ) * capacity );
+      task->text_page_capacity = capacity;
+   }
+   for ( int i = 0; i < count; ++i ) {
+      task->text_pages[ task->text_page_count ] = buffer->start +
+         ( i << TEXT_PAGE_SHIFT );
+      ++task->text_page_count;
+   }
+}
+
 struct indexed_string* t_intern_string( struct task* task,
    const char* value, int length ) {
    return intern_string( task, &task->str_table, value, length, false );
@@ -727,28 +1033,17 @@ struct indexed_string* t_intern_string_copy( struct task* task,
 
 static struct indexed_string* intern_string( struct task* task,
    struct str_table* table, const char* value, int length, bool copy_value ) {
-   // Indexed strings are stored in a binary search tree.
-   struct indexed_string* parent_lchild = NULL;
-   struct indexed_string* parent_rchild = NULL;
-   struct indexed_string* string = table->root;
-   while ( string ) {
-      int result = strcmp( value, string->value );
-      if ( result < 0 ) {
-         parent_lchild = string;
-         parent_rchild = NULL;
-         string = string->left;
-      }
-      else if ( result > 0 ) {
-         parent_lchild = NULL;
-         parent_rchild = string;
-         string = string->right;
-      }
-      else {
-         return string;
-      }
+   // Keep the table at most half full.
+   if ( ( table->size + 1 ) * 2 > table->capacity ) {
+      grow_str_table( table );
+   }
+   unsigned int hash = c_hash_str( value );
+   struct indexed_string** slot = find_string_slot( table, value, hash );
+   if ( *slot ) {
+      return *slot;
    }
    // Allocate a new indexed-string when one isn't interned.
-   string = mem_alloc( sizeof( *string ) );
+   struct indexed_string* string = mem_alloc( sizeof( *string ) );
    if ( copy_value ) {
       string->value = t_intern_text( task, value, length );
    }
@@ -758,9 +1053,8 @@ static struct indexed_string* intern_string( struct task* task,
    string->length = length;
    string->index = table->size;
    string->index_runtime = -1;
+   string->hash = hash;
    string->next = NULL;
-   string->left = NULL;
-   string->right = NULL;
    string->used = false;
    string->in_source_code = false;
    if ( table->head ) {
@@ -770,17 +1064,46 @@ static struct indexed_string* intern_string( struct task* task,
       table->head = string;
    }
    table->tail = string;
-   if ( parent_lchild ) {
-      parent_lchild->left = string;
+   *slot = string;
+   table->strings[ table->size ] = string;
+   ++table->size;
+   return string;
+}
+
+// Returns the slot that holds the string, or the empty slot where the string
+// should be placed. The value is compared up to its null character.
+static struct indexed_string** find_string_slot( struct str_table* table,
+   const char* value, unsigned int hash ) {
+   unsigned int mask = table->capacity - 1;
+   unsigned int i = hash & mask;
+   while ( table->slots[ i ] && ! ( table->slots[ i ]->hash == hash &&
+      strcmp( table->slots[ i ]->value, value ) == 0 ) ) {
+      i = ( i + 1 ) & mask;
    }
-   else if ( parent_rchild ) {
-      parent_rchild->right = string;
+   return &table->slots[ i ];
+}
+
+static void grow_str_table( struct str_table* table ) {
+   enum { INITIAL_CAPACITY = 1024 };
+   struct indexed_string** old_slots = table->slots;
+   int old_capacity = table->capacity;
+   table->capacity = ( old_capacity > 0 ) ? old_capacity * 2 :
+      INITIAL_CAPACITY;
+   table->slots = mem_alloc( sizeof( *table->slots ) * table->capacity );
+   memset( table->slots, 0, sizeof( *table->slots ) * table->capacity );
+   for ( int i = 0; i < old_capacity; ++i ) {
+      struct indexed_string* string = old_slots[ i ];
+      if ( string ) {
+         *find_string_slot( table, string->value, string->hash ) = string;
+      }
    }
-   else {
-      table->root = string;
+   if ( old_slots ) {
+      mem_free( old_slots );
    }
-   ++table->size;
-   return string;
+   // The table is at most half full, so the array needs to hold only half as
+   // many strings as there are slots.
+   table->strings = mem_realloc( table->strings,
+      sizeof( *table->strings ) * ( table->capacity / 2 ) );
 }
 
 struct indexed_string* t_intern_script_name( struct task* task,
@@ -795,18 +1118,29 @@ struct indexed_string* t_intern_script_name( struct task* task,
 }
 
 struct indexed_string* t_lookup_string( struct task* task, int index ) {
-   struct str_table* table = index / STRTABLE_MAXSIZE ==
-      STRTABLE_SCRIPTNAME ? &task->script_name_table : &task->str_table;
-   struct indexed_string* string = table->head;
-   while ( string ) {
-      if ( string->index == index ) {
-         return string;
-      }
-      string = string->next;
+   struct str_table* table = &task->str_table;
+   int position = index;
+   if ( index / STRTABLE_MAXSIZE == STRTABLE_SCRIPTNAME ) {
+      table = &task->script_name_table;
+      position -= STRTABLE_SCRIPTNAME * STRTABLE_MAXSIZE;
+   }
+   if ( position >= 0 && position < table->size &&
+      table->strings[ position ]->index == index ) {
+      return table->strings[ position ];
    }
    return NULL;
 }
 
+// Returns the interned string with the specified value, or NULL if the value
+// is not interned.
+struct indexed_string* t_find_string( struct task* task, const char* value ) {
+   struct str_table* table = &task->str_table;
+   if ( table->capacity == 0 ) {
+      return NULL;
+   }
+   return *find_string_slot( table, value, c_hash_str( value ) );
+}
+
 struct constant* t_alloc_constant( void ) {
    struct constant* constant = mem_slot_alloc( sizeof( *constant ) );
    t_init_object( &constant->object, NODE_CONSTANT );
@@ -1004,6 +1338,7 @@ struct param* t_alloc_param( void ) {
    param->next = NULL;
    param->name = NULL;
    param->default_value = NULL;
+   param->type_node = NULL;
    param->spec = SPEC_NONE;
    param->original_spec = SPEC_NONE;
    param->index = 0;
@@ -1095,6 +1430,7 @@ void t_init_pos_id( struct pos* pos, int id ) {
 static void init_ref( struct ref* ref, int type ) {
    ref->next = NULL;
    ref->type = type;
+   ref->type_node = NULL;
    ref->nullable = false;
    ref->implicit = false;
 }
@@ -13,12 +13,49 @@
 
 struct file_entry {
    struct file_entry* next;
+   struct file_entry* hash_next;
    struct fileid file_id;
    struct str path;
    struct str full_path;
+   // Name of the macro used by the include guard of the file, or NULL if the
+   // file has no include guard.
+   const char* guard;
+   int lines;
    int id;
 };
 
+// The result of searching for a file. The search is identified by the first
+// path tried and by the path given in the search.
+struct file_search {
+   struct file_search* next;
+   struct file_entry* file;
+   struct str path;
+   const char* given_path;
+   unsigned int hash;
+   // Number of file-system queries made by the search.
+   int queries;
+};
+
+// File entries are found by file ID through a hash table. The results of the
+// file searches are kept in another hash table, so searching again for the
+// same file from the same directory does not query the file system.
+struct file_table {
+   struct file_entry** entries;
+   struct file_search** searches;
+   int entry_capacity;
+   int entry_count;
+   int search_capacity;
+   int search_count;
+};
+
+// Pointers to the entries with the IDs 0, 1, 2, and so on, so an entry can be
+// found by its ID directly.
+struct entry_vector {
+   void** entries;
+   int capacity;
+   int size;
+};
+
 struct file_query {
    const char* given_path;
    struct str* path;
@@ -44,11 +81,20 @@ struct include_history_entry {
    bool imported;
 };
 
+// The interned texts can also be found by offset. The offsets are given out in
+// pages, and a buffer takes up a run of whole pages, so the page of an offset
+// leads straight to the buffer.
+enum {
+   TEXT_PAGE_SHIFT = 15,
+   TEXT_PAGE_SIZE = 1 << TEXT_PAGE_SHIFT
+};
+
 struct text_buffer {
    struct text_buffer* prev;
    char* start;
    char* end;
    char* left;
+   unsigned int offset;
 };
 
 struct pos {
@@ -137,12 +183,24 @@ struct object {
    struct object* next_scope;
 };
 
+// A name is a node in a character trie. The children of a node are kept in a
+// list sorted by character. When a node has many children, the children that
+// use the common identifier characters are also placed in a table, so they can
+// be found directly.
+enum { NAME_TABLE_SIZE = 64 };
+
+struct name_table {
+   struct name* children[ NAME_TABLE_SIZE ];
+};
+
 struct name {
    struct name* parent;
    struct name* next;
    struct name* drop;
+   struct name_table* table;
    struct object* object;
    char ch;
+   unsigned char num_children;
 };
 
 struct name_usage {
@@ -245,6 +303,9 @@ struct ref {
       REF_ARRAY,
       REF_FUNCTION
    } type;
+   // Canonical form of the chain starting at this reference. Filled in by the
+   // semantic phase the first time the reference is compared.
+   struct type_node* type_node;
    bool nullable;
    bool implicit;
 };
@@ -789,6 +850,8 @@ struct param {
    struct param* next;
    struct name* name;
    struct expr* default_value;
+   // Canonical form of the parameter list starting at this parameter.
+   struct type_node* type_node;
    int spec;
    int original_spec;
    int index;
@@ -1043,12 +1106,11 @@ struct constant {
 
 struct indexed_string {
    struct indexed_string* next;
-   struct indexed_string* left;
-   struct indexed_string* right;
    const char* value;
    int length;
    int index;
    int index_runtime;
+   unsigned int hash;
    bool used;
    bool in_source_code;
 };
@@ -1058,10 +1120,15 @@ struct indexed_string_usage {
    struct indexed_string* string;
 };
 
+// Strings are found through a hash table that uses open addressing. The
+// strings are also kept in a list, in the order they were interned, and in an
+// array indexed by the position of the string in the table.
 struct str_table {
    struct indexed_string* head;
    struct indexed_string* tail;
-   struct indexed_string* root;
+   struct indexed_string** slots;
+   struct indexed_string** strings;
+   int capacity;
    int size;
 };
 
@@ -1235,12 +1302,55 @@ struct lang_limits {
    int max_id_length;
 };
 
+// Parts of the compilation timed for the -time-report option. Lexing and
+// preprocessing are entered for almost every token, so the CPU clock, which is
+// slow to read, is not read when switching to or from them. Their CPU time is
+// counted in the part that reads the tokens.
+enum timer {
+   TIMER_NONE,
+   TIMER_PARSE,
+   TIMER_LEX,
+   TIMER_PREPROCESS,
+   TIMER_IMPORT,
+   TIMER_CACHE,
+   TIMER_SEMANTIC,
+   TIMER_BIND_NAMES,
+   TIMER_TEST_OBJECTS,
+   TIMER_TEST_BODIES,
+   TIMER_CODEGEN,
+   TIMER_WRITE_CODE,
+   TIMER_FLUSH_PCODE,
+   TIMER_WRITE_CHUNKS,
+   TIMER_TOTAL
+};
+
 struct task {
    struct options* options;
    FILE* err_file;
    jmp_buf* bail;
    struct text_buffer* text_buffer;
+   char** text_pages;
+   int text_page_capacity;
+   int text_page_count;
    struct file_entry* file_entries;
+   struct entry_vector file_entry_vector;
+   struct file_table file_table;
+   struct {
+      int searches;
+      int cached_searches;
+      int queries;
+      int saved_queries;
+   } file_stats;
+   // The time spent in a part of the compilation does not include the time
+   // spent in the parts it switches to.
+   struct {
+      double wall[ TIMER_TOTAL ];
+      double cpu[ TIMER_TOTAL ];
+      double wall_start;
+      double cpu_start;
+      enum timer current;
+      enum timer cpu_timer;
+   } timers;
    struct str_table str_table;
    struct str_table script_name_table;
    struct indexed_string* empty_string;
@@ -1263,6 +1373,7 @@ struct task {
    struct ns* upmost_ns;
    struct str err_file_dir;
    struct list include_history;
+   struct entry_vector include_history_vector;
    struct str* compiler_dir;
    struct str lib_dir;
    // The file printed in the last diagnostic.
@@ -1272,6 +1383,12 @@ struct task {
    struct list structures;
 };
 
+// Returns the interned text at the specified offset.
+inline static char* t_text( struct task* task, unsigned int offset ) {
+   return task->text_pages[ offset >> TEXT_PAGE_SHIFT ] +
+      ( offset & ( TEXT_PAGE_SIZE - 1 ) );
+}
+
 #define DIAG_NONE 0
 #define DIAG_FILE 0x1
 #define DIAG_LINE 0x2
@@ -1294,6 +1411,7 @@ void t_diag_args( struct task* task, int flags, va_list* args );
 void t_bail( struct task* );
 void t_deinit( struct task* task );
 bool t_same_pos( struct pos*, struct pos* );
+enum timer t_switch_timer( struct task* task, enum timer timer );
 void t_decode_pos( struct task* task, struct pos* pos, const char** file,
    int* line, int* column );
 const char* t_decode_pos_file( struct task* task, struct pos* pos );
@@ -1309,6 +1427,7 @@ struct indexed_string* t_intern_string( struct task* task,
 struct indexed_string* t_intern_string_copy( struct task* task,
    const char* value, int length );
 struct indexed_string* t_lookup_string( struct task* task, int index );
+struct indexed_string* t_find_string( struct task* task, const char* value );
 struct ns* t_alloc_ns( struct name* name );
 void t_append_unresolved_namespace_object( struct ns_fragment* fragment,
    struct object* object );
@@ -1343,12 +1462,15 @@ struct ref_func* t_alloc_ref_func( void );
 struct ns_fragment* t_alloc_ns_fragment( void );
 struct type_alias* t_alloc_type_alias( void );
 char* t_intern_text( struct task* task, const char* value, int length );
+unsigned int t_intern_text_offset( struct task* task, const char* value,
+   int length );
 struct text_buffer* t_get_text_buffer( struct task* task, int min_free_size );
 void t_update_err_file_dir( struct task* task, const char* path );
 struct include_history_entry* t_alloc_include_history_entry(
    struct task* task );
 struct include_history_entry* t_decode_include_history_entry(
    struct task* task, int id );
+struct file_entry* t_decode_file_entry( struct task* task, int id );
 struct script* t_alloc_script( void );
 
 #endif